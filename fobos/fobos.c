@@ -17,14 +17,43 @@
 //  2025.01.19 - v.2.3.2 fobos_rx_reset()
 //  2025.08.23 - v.2.4.0 DC filter improved, VGA gain fixed
 //  2025.10.23 - v.2.4.1 new software DC filter
+//  2026.10.16 - v.2.5.0 SIMD sample conversion (SSE2, AVX2, AVX-512, NEON)
+//  2026.10.16 - v.2.5.0 CS16, CS8 output formats
+//  2026.10.16 - v.2.5.0 block dc removal mode, fobos_rx_set_dc_mode()
+//  2026.10.16 - v.2.5.0 multithreaded conversion, fobos_rx_set_convert_threads()
+//  2026.10.16 - v.2.5.0 processing thread, fobos_rx_set_processing_queue(), fobos_rx_get_stats()
+//  2026.10.16 - v.2.5.0 vectorized and deferred iq calibration, fobos_rx_set_calibration()
+//  2026.10.16 - v.2.5.0 conversion kernel table specialized by dc mode, iq swap and format
+//  2026.10.16 - v.2.5.0 ring pull mode (fobos_rx_ring_start, fobos_rx_ring_read, fobos_rx_ring_stop)
+//  2026.10.16 - v.2.5.0 per buffer metadata (fobos_rx_read_async_meta, fobos_rx_get_meta)
+//  2026.10.16 - v.2.5.0 owned event thread (fobos_rx_start_async, fobos_rx_stop_async, fobos_rx_set_event_thread)
+//  2026.10.16 - v.2.5.0 pipelined sync mode (fobos_rx_set_sync_queue, fobos_rx_read_sync_timeout, fobos_rx_read_sync_len)
+//  2026.10.16 - v.2.5.0 automatic transfer count and length (fobos_rx_set_auto_buffers)
+//  2026.10.16 - v.2.5.0 event loop integration (fobos_rx_start_async_polled, fobos_rx_get_pollfds, fobos_rx_handle_events, ...)
+//  2026.10.16 - v.2.5.0 multi-device sessions (fobos_session_create, fobos_session_open, fobos_session_destroy)
+//  2026.10.16 - v.2.5.0 synchronized start and stream alignment (fobos_session_start_async, fobos_rx_get_start_time, fobos_rx_estimate_offset)
+//  2026.10.16 - v.2.5.0 streaming buffer arena (fobos_rx_set_buffer_arena)
+//  2026.10.16 - v.2.5.0 zero-copy raw buffer leases (fobos_rx_set_lease_mode, fobos_rx_release_lease)
+//  2026.10.16 - v.2.5.0 event driven stream stop and device close
+//  2026.10.16 - v.2.5.0 prepared stream with pause and resume (fobos_rx_prepare_async, fobos_rx_pause_async, fobos_rx_resume_async)
+//  2026.10.16 - v.2.5.0 callback framing with overlap (fobos_rx_set_framing)
+//  2026.10.16 - v.2.5.0 stream recovery after a device loss (fobos_rx_set_recovery)
+//  2026.10.16 - v.2.5.0 thread safe tuning and gain changes while streaming (control command queue)
+//  2026.10.16 - v.2.5.0 configuration transactions writing the net register changes (fobos_rx_begin_config, fobos_rx_commit_config)
+//  2026.10.16 - v.2.5.0 precomputed tuning plans (fobos_rx_make_plans, fobos_rx_apply_plan, fobos_rx_save_plans, fobos_rx_load_plans)
+//  2026.10.16 - v.2.5.0 frequency hopping schedule in the streaming path (fobos_rx_set_hop_schedule)
 //==============================================================================
 #ifndef _CRT_SECURE_NO_WARNINGS
 #define _CRT_SECURE_NO_WARNINGS
 #endif//_CRT_SECURE_NO_WARNINGS
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
 #include <stdio.h>
 #include <math.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <libusb.h>
 #include "fobos.h"
 #ifdef _WIN32
@@ -34,14 +63,38 @@
 #define printf_internal _cprintf
 #else
 #include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
 #endif
 #ifndef printf_internal
 #define printf_internal printf
 #endif // !printf_internal
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define FOBOS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define FOBOS_NEON
+#include <arm_neon.h>
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+#define FOBOS_TARGET(x) __attribute__((target(x)))
+#define FOBOS_INLINE inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define FOBOS_TARGET(x)
+#define FOBOS_INLINE __forceinline
+#else
+#define FOBOS_TARGET(x)
+#define FOBOS_INLINE inline
+#endif
 //==============================================================================
 #define FOBOS_PRINT_DEBUG
 //==============================================================================
-#define LIB_VERSION "2.4.1"
+#define LIB_VERSION "2.5.0"
 #define DRV_VERSION "libusb"
 //==============================================================================
 #define FOBOS_VENDOR_ID             0x16d0
@@ -63,11 +116,29 @@
 #define FOBOS_DEV_ADC_SCK           11
 #define FOBOS_DEV_ADC_SDI           12
 #define FOBOS_MAX2830_ANTSEL        13
+// the band switch bits a tune plan may write
+#define FOBOS_PLAN_GPO_MASK         ((1 << FOBOS_DEV_PRESEL_V1) | (1 << FOBOS_DEV_PRESEL_V2) | \
+                                     (1 << FOBOS_DEV_LNA_LP_SHD) | (1 << FOBOS_DEV_LNA_HP_SHD) | \
+                                     (1 << FOBOS_DEV_IF_V1) | (1 << FOBOS_DEV_IF_V2) | (1 << FOBOS_MAX2830_ANTSEL))
 //==============================================================================
 #define bitset(x,nbit)   ((x) |=  (1<<(nbit)))
 #define bitclear(x,nbit) ((x) &= ~(1<<(nbit)))
 #define FOBOS_DEF_BUF_COUNT         16
 #define FOBOS_MAX_BUF_COUNT         64
+#define FOBOS_DEF_SYNC_DEPTH        4
+#define FOBOS_RECOVER_INTERVAL_MS   250
+#define FOBOS_CMD_QUEUE_LEN         64
+#define FOBOS_CMD_TIMEOUT_MS        2000
+#define FOBOS_LEASE_TIMEOUT_MS      2000
+#define FOBOS_MAX2830_REGS_COUNT    16
+#define FOBOS_SI5351C_REGS_COUNT    256
+#define FOBOS_SI5351C_BURST         16
+#define FOBOS_AUTO_STALL_MS         20.0
+#define FOBOS_AUTO_MIN_STALL_MS     5.0
+#define FOBOS_AUTO_MAX_STALL_MS     1000.0
+#define FOBOS_AUTO_MAX_BUF_SIZE     (4 * 1024 * 1024)
+#define FOBOS_MAX_CVT_THREADS       16
+#define FOBOS_MAX_FRAME_LENGTH      (16 * 1024 * 1024)
 #define FOBOS_DEF_BUF_LENGTH        (16 * 32 * 512)
 #define LIBUSB_BULK_TIMEOUT         0
 #define LIBUSB_BULK_IN_ENDPOINT     0x81
@@ -75,12 +146,471 @@
 #define LIBUSB_CALL
 #endif
 //==============================================================================
+// Threads
+//==============================================================================
+#ifdef _WIN32
+typedef HANDLE fobos_thread_t;
+typedef CRITICAL_SECTION fobos_mutex_t;
+typedef CONDITION_VARIABLE fobos_cond_t;
+typedef LPTHREAD_START_ROUTINE fobos_thread_fn_t;
+#define FOBOS_THREAD_PROC(name, arg) static DWORD WINAPI name(LPVOID arg)
+#define FOBOS_THREAD_RETURN return 0
+#else
+typedef pthread_t fobos_thread_t;
+typedef pthread_mutex_t fobos_mutex_t;
+typedef pthread_cond_t fobos_cond_t;
+typedef void *(*fobos_thread_fn_t)(void *);
+#define FOBOS_THREAD_PROC(name, arg) static void * name(void * arg)
+#define FOBOS_THREAD_RETURN return NULL
+#endif // _WIN32
+//==============================================================================
+static int fobos_thread_create(fobos_thread_t * thread, fobos_thread_fn_t fn, void * arg)
+{
+#ifdef _WIN32
+    *thread = CreateThread(NULL, 0, fn, arg, 0, NULL);
+    return (*thread != NULL) ? 0 : -1;
+#else
+    return pthread_create(thread, NULL, fn, arg);
+#endif // _WIN32
+}
+//==============================================================================
+static void fobos_thread_join(fobos_thread_t thread)
+{
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif // _WIN32
+}
+//==============================================================================
+#ifdef _WIN32
+typedef DWORD fobos_thread_id_t;
+#else
+typedef pthread_t fobos_thread_id_t;
+#endif // _WIN32
+//==============================================================================
+static fobos_thread_id_t fobos_thread_self(void)
+{
+#ifdef _WIN32
+    return GetCurrentThreadId();
+#else
+    return pthread_self();
+#endif // _WIN32
+}
+//==============================================================================
+static int fobos_thread_is_self(fobos_thread_id_t id)
+{
+#ifdef _WIN32
+    return id == GetCurrentThreadId();
+#else
+    return pthread_equal(id, pthread_self());
+#endif // _WIN32
+}
+//==============================================================================
+// applies to the calling thread, failures are not fatal
+static void fobos_thread_set_sched(int cpu, int priority)
+{
+#ifdef _WIN32
+    if ((cpu >= 0) && (cpu < (int)(sizeof(DWORD_PTR) * 8)))
+    {
+        if (!SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu))
+        {
+            printf_internal("Failed to set the thread affinity to cpu %d\n", cpu);
+        }
+    }
+    if (priority != FOBOS_PRIORITY_NORMAL)
+    {
+        int level = (priority == FOBOS_PRIORITY_REALTIME) ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_HIGHEST;
+        if (!SetThreadPriority(GetCurrentThread(), level))
+        {
+            printf_internal("Failed to set the thread priority %d\n", priority);
+        }
+    }
+#else
+#ifdef __linux__
+    if (cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        {
+            printf_internal("Failed to set the thread affinity to cpu %d\n", cpu);
+        }
+    }
+#else
+    if (cpu >= 0)
+    {
+        printf_internal("The thread affinity is not supported on this platform\n");
+    }
+#endif // __linux__
+    if (priority != FOBOS_PRIORITY_NORMAL)
+    {
+        int policy = (priority == FOBOS_PRIORITY_REALTIME) ? SCHED_FIFO : SCHED_RR;
+        int min = sched_get_priority_min(policy);
+        int max = sched_get_priority_max(policy);
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = (priority == FOBOS_PRIORITY_REALTIME) ? max - 1 : (min + max) / 2;
+        if (pthread_setschedparam(pthread_self(), policy, &param) != 0)
+        {
+            printf_internal("Failed to set the thread priority %d, insufficient privileges?\n", priority);
+        }
+    }
+#endif // _WIN32
+}
+//==============================================================================
+static void fobos_mutex_init(fobos_mutex_t * mutex)
+{
+#ifdef _WIN32
+    InitializeCriticalSection(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif // _WIN32
+}
+//==============================================================================
+static void fobos_mutex_destroy(fobos_mutex_t * mutex)
+{
+#ifdef _WIN32
+    DeleteCriticalSection(mutex);
+#else
+    pthread_mutex_destroy(mutex);
+#endif // _WIN32
+}
+//==============================================================================
+static void fobos_mutex_lock(fobos_mutex_t * mutex)
+{
+#ifdef _WIN32
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif // _WIN32
+}
+//==============================================================================
+static void fobos_mutex_unlock(fobos_mutex_t * mutex)
+{
+#ifdef _WIN32
+    LeaveCriticalSection(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif // _WIN32
+}
+//==============================================================================
+// the timed waits run on the monotonic clock, a wall clock step does not stretch them
+static void fobos_cond_init(fobos_cond_t * cond)
+{
+#ifdef _WIN32
+    InitializeConditionVariable(cond);
+#elif defined(__APPLE__)
+    pthread_cond_init(cond, NULL);
+#else
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+#endif // _WIN32
+}
+//==============================================================================
+static void fobos_cond_destroy(fobos_cond_t * cond)
+{
+#ifndef _WIN32
+    pthread_cond_destroy(cond);
+#endif // !_WIN32
+}
+//==============================================================================
+static void fobos_cond_wait(fobos_cond_t * cond, fobos_mutex_t * mutex)
+{
+#ifdef _WIN32
+    SleepConditionVariableCS(cond, mutex, INFINITE);
+#else
+    pthread_cond_wait(cond, mutex);
+#endif // _WIN32
+}
+//==============================================================================
+// returns 0 when signaled, -1 on timeout
+static int fobos_cond_timedwait(fobos_cond_t * cond, fobos_mutex_t * mutex, uint32_t timeout_ms)
+{
+#ifdef _WIN32
+    return SleepConditionVariableCS(cond, mutex, timeout_ms) ? 0 : -1;
+#elif defined(__APPLE__)
+    struct timespec ts;
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000l;
+    return (pthread_cond_timedwait_relative_np(cond, mutex, &ts) == 0) ? 0 : -1;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000l;
+    if (ts.tv_nsec >= 1000000000l)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000l;
+    }
+    return (pthread_cond_timedwait(cond, mutex, &ts) == 0) ? 0 : -1;
+#endif // _WIN32
+}
+//==============================================================================
+static void fobos_cond_broadcast(fobos_cond_t * cond)
+{
+#ifdef _WIN32
+    WakeAllConditionVariable(cond);
+#else
+    pthread_cond_broadcast(cond);
+#endif // _WIN32
+}
+//==============================================================================
+// Atomics
+//==============================================================================
+#ifdef _MSC_VER
+typedef volatile LONG fobos_atomic_t;
+typedef volatile LONG64 fobos_atomic64_t;
+#define fobos_atomic_load(p)        InterlockedCompareExchange((p), 0, 0)
+#define fobos_atomic_store(p, v)    InterlockedExchange((p), (v))
+#define fobos_atomic_add(p, v)      InterlockedExchangeAdd((p), (v))
+#define fobos_atomic_load64(p)      InterlockedCompareExchange64((p), 0, 0)
+#define fobos_atomic_store64(p, v)  InterlockedExchange64((p), (v))
+#else
+typedef volatile int32_t fobos_atomic_t;
+typedef volatile int64_t fobos_atomic64_t;
+#define fobos_atomic_load(p)        __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define fobos_atomic_store(p, v)    __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define fobos_atomic_add(p, v)      __atomic_fetch_add((p), (v), __ATOMIC_ACQ_REL)
+#define fobos_atomic_load64(p)      __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define fobos_atomic_store64(p, v)  __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif // _MSC_VER
+//==============================================================================
+static int fobos_atomic_cas(fobos_atomic_t * p, int32_t expected, int32_t desired)
+{
+#ifdef _MSC_VER
+    return InterlockedCompareExchange(p, desired, expected) == expected;
+#else
+    return __atomic_compare_exchange_n(p, &expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif // _MSC_VER
+}
+//==============================================================================
+static int fobos_atomic_cas64(fobos_atomic64_t * p, int64_t expected, int64_t desired)
+{
+#ifdef _MSC_VER
+    return InterlockedCompareExchange64(p, desired, expected) == expected;
+#else
+    return __atomic_compare_exchange_n(p, &expected, desired, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif // _MSC_VER
+}
+//==============================================================================
+static void fobos_atomic_store_float(fobos_atomic_t * p, float value)
+{
+    union { float f; int32_t i; } u;
+    u.f = value;
+    fobos_atomic_store(p, u.i);
+}
+//==============================================================================
+static float fobos_atomic_load_float(fobos_atomic_t * p)
+{
+    union { float f; int32_t i; } u;
+    u.i = (int32_t)fobos_atomic_load(p);
+    return u.f;
+}
+//==============================================================================
+// full barrier, orders a store before a later load of another variable
+static void fobos_atomic_fence(void)
+{
+#ifdef _MSC_VER
+    MemoryBarrier();
+#else
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif // _MSC_VER
+}
+//==============================================================================
+// Statistics counters
+// The rx_stats counters are updated from the libusb event thread, the
+// processing thread and the API calls while fobos_rx_get_stats() may read them
+// from any thread. Every update is a relaxed atomic add, every high watermark
+// has a single writer and is stored atomically.
+//==============================================================================
+static void fobos_stat_add(uint64_t * p, uint64_t v)
+{
+#ifdef _MSC_VER
+    InterlockedExchangeAdd64((volatile LONG64 *)p, (LONG64)v);
+#else
+    __atomic_fetch_add(p, v, __ATOMIC_RELAXED);
+#endif // _MSC_VER
+}
+//==============================================================================
+static uint64_t fobos_stat_load(uint64_t * p)
+{
+#ifdef _MSC_VER
+    return (uint64_t)InterlockedCompareExchange64((volatile LONG64 *)p, 0, 0);
+#else
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+#endif // _MSC_VER
+}
+//==============================================================================
+static void fobos_stat_max64(uint64_t * p, uint64_t v)
+{
+    if (v > fobos_stat_load(p))
+    {
+#ifdef _MSC_VER
+        InterlockedExchange64((volatile LONG64 *)p, (LONG64)v);
+#else
+        __atomic_store_n(p, v, __ATOMIC_RELAXED);
+#endif // _MSC_VER
+    }
+}
+//==============================================================================
+static void fobos_stat_max32(uint32_t * p, uint32_t v)
+{
+    if (v > (uint32_t)fobos_atomic_load((fobos_atomic_t *)p))
+    {
+        fobos_atomic_store((fobos_atomic_t *)p, (int32_t)v);
+    }
+}
+//==============================================================================
+// Monotonic time
+//==============================================================================
+static uint64_t fobos_time_ns(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER freq;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    uint64_t f = (uint64_t)freq.QuadPart;
+    uint64_t c = (uint64_t)counter.QuadPart;
+    return (c / f) * 1000000000ull + ((c % f) * 1000000000ull) / f;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif // _WIN32
+}
+//==============================================================================
+// Lock-free single producer / single consumer queue of pointers
+//==============================================================================
+typedef struct fobos_spsc_t
+{
+    void ** items;
+    uint32_t mask;
+    fobos_atomic_t head;    // written by the producer only
+    fobos_atomic_t tail;    // written by the consumer only
+} fobos_spsc_t;
+//==============================================================================
+static int fobos_spsc_init(fobos_spsc_t * q, uint32_t capacity)
+{
+    uint32_t size = 1;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+    q->items = (void **)calloc(size, sizeof(void *));
+    q->mask = size - 1;
+    q->head = 0;
+    q->tail = 0;
+    return q->items ? 0 : -1;
+}
+//==============================================================================
+static void fobos_spsc_free(fobos_spsc_t * q)
+{
+    free(q->items);
+    q->items = NULL;
+}
+//==============================================================================
+static int fobos_spsc_push(fobos_spsc_t * q, void * item)
+{
+    uint32_t head = (uint32_t)q->head;
+    uint32_t tail = (uint32_t)fobos_atomic_load(&q->tail);
+    if (head - tail > q->mask)
+    {
+        return -1;
+    }
+    q->items[head & q->mask] = item;
+    fobos_atomic_store(&q->head, (int32_t)(head + 1));
+    return 0;
+}
+//==============================================================================
+static void * fobos_spsc_pop(fobos_spsc_t * q)
+{
+    uint32_t tail = (uint32_t)q->tail;
+    uint32_t head = (uint32_t)fobos_atomic_load(&q->head);
+    if (head == tail)
+    {
+        return NULL;
+    }
+    void * item = q->items[tail & q->mask];
+    fobos_atomic_store(&q->tail, (int32_t)(tail + 1));
+    return item;
+}
+//==============================================================================
+// pop that may race with another consumer, the producer side stays single
+static void * fobos_spsc_pop_shared(fobos_spsc_t * q)
+{
+    while (1)
+    {
+        uint32_t tail = (uint32_t)fobos_atomic_load(&q->tail);
+        uint32_t head = (uint32_t)fobos_atomic_load(&q->head);
+        if (head == tail)
+        {
+            return NULL;
+        }
+        void * item = q->items[tail & q->mask];
+        if (fobos_atomic_cas(&q->tail, (int32_t)tail, (int32_t)(tail + 1)))
+        {
+            return item;
+        }
+    }
+}
+//==============================================================================
+static uint32_t fobos_spsc_count(fobos_spsc_t * q)
+{
+    return (uint32_t)fobos_atomic_load(&q->head) - (uint32_t)fobos_atomic_load(&q->tail);
+}
+//==============================================================================
 enum fobos_async_status
 {
     FOBOS_IDDLE = 0,
     FOBOS_STARTING,
     FOBOS_RUNNING,
-    FOBOS_CANCELING
+    FOBOS_CANCELING,
+    FOBOS_PAUSED,                       // prepared stream, transfers not submitted
+    FOBOS_RECOVERING                    // device lost, looked up again
+};
+//==============================================================================
+struct fobos_cvt_state_t;
+struct fobos_dev_t;
+// converter settings, selected by the streaming thread and stamped on every
+// buffer, the buffer is converted with the settings it was captured with
+struct fobos_rx_cvt_sel_t
+{
+    int dc_mode;
+    int swap_iq;                        // the hardware iq order included
+    int calibrate;
+};
+// raw buffer with the metadata of the transfer that filled it
+struct fobos_rx_buf_t
+{
+    unsigned char * data;
+    struct fobos_rx_meta_t meta;
+    struct fobos_rx_cvt_sel_t cvt;
+    struct fobos_rx_lease_t lease;
+    int leased;
+    uint32_t skip;                      // samples to drop from the start, hop schedule
+};
+// transfer context: the owner and the raw buffer currently submitted
+struct fobos_rx_xfer_t
+{
+    struct fobos_dev_t * dev;
+    struct fobos_rx_buf_t * buf;
+    int done;                           // sync mode: completed, not yet resubmitted
+};
+// configuration change queued for the streaming thread
+struct fobos_cmd_t
+{
+    fobos_atomic_t seq;                 // slot sequence: free at pos, filled at pos + 1
+    int code;                           // FOBOS_CMD_*
+    double value;
+    struct fobos_rx_tune_plan_t plan;   // FOBOS_CMD_TUNE_PLAN
 };
 //==============================================================================
 struct fobos_dev_t
@@ -92,11 +622,58 @@ struct fobos_dev_t
     uint32_t transfer_buf_size;
     struct libusb_transfer **transfer;
     unsigned char **transfer_buf;
+    uint32_t transfer_spare_count;
+    struct fobos_rx_buf_t * rx_bufs;
+    struct fobos_rx_xfer_t * rx_xfers;
     int transfer_errors;
     int dev_lost;
     int use_zerocopy;
+    uint32_t xfer_active;               // async transfers submitted and not reaped yet
+    int xfer_idle;                      // set when the last transfer is reaped
+    fobos_mutex_t state_lock;
+    fobos_cond_t state_cond;            // signaled when the async streaming has ended
+    //=== recovery =============================================================
+    int recover_enabled;
+    uint32_t recover_timeout_ms;        // 0 - until the stream is stopped
+    int recover_abort;                  // the application has cancelled the stream
+    //=== prepared stream ======================================================
+    int prep_active;
+    int prep_quit;
+    fobos_thread_t prep_thread;
+    //=== control command queue ================================================
+    struct fobos_cmd_t cmd_slots[FOBOS_CMD_QUEUE_LEN];
+    fobos_atomic_t cmd_head;            // next slot to fill, claimed by the posting threads
+    uint32_t cmd_tail;                  // next slot to apply, owned by the draining thread
+    fobos_atomic_t cmd_applied;         // id of the last applied command
+    fobos_atomic_t cmd_draining;
+    int cmd_result[FOBOS_CMD_QUEUE_LEN];
+    double cmd_actual[FOBOS_CMD_QUEUE_LEN];
+    fobos_thread_id_t cmd_tid;          // thread handling the stream events
+    fobos_atomic_t cmd_tid_valid;
+    int cmd_in_events;                  // the stream callbacks may run right now
+    uint32_t cfg_id;                    // configuration changes applied
+    int cfg_pending;                    // the next clean buffer is not tagged yet
+    uint64_t cfg_index;                 // first sample index captured after the change
+    //=== configuration transaction ============================================
+    fobos_atomic_t cfg_txn;             // fobos_rx_begin_config() .. fobos_rx_commit_config()
+    int cfg_defer;                      // the register writes of a setter are deferred
+    uint32_t cfg_txn_codes;             // FOBOS_CMD_* bits applied in the transaction
+    uint16_t gpo_remote;                // last dev_gpo written
+    int gpo_known;
+    int gpo_dirty;
+    uint16_t max2830_local[FOBOS_MAX2830_REGS_COUNT];
+    uint16_t max2830_remote[FOBOS_MAX2830_REGS_COUNT];
+    uint32_t max2830_known;             // bit per register
+    uint32_t max2830_dirty;
+    uint8_t max2830_order[FOBOS_MAX2830_REGS_COUNT];    // dirty registers by the first write
+    uint32_t max2830_dirty_count;
+    uint8_t si5351c_local[FOBOS_SI5351C_REGS_COUNT];
+    uint8_t si5351c_remote[FOBOS_SI5351C_REGS_COUNT];
+    uint32_t si5351c_known[FOBOS_SI5351C_REGS_COUNT / 32];
+    uint32_t si5351c_dirty[FOBOS_SI5351C_REGS_COUNT / 32];
     //=== common ===============================================================
-    uint16_t user_gpo;
+    uint16_t user_gpo;                  // replayed by the recovery once set
+    int user_gpo_known;
     uint16_t dev_gpo;
     char hw_revision[FOBOS_INFO_LEN];
     char fw_version[FOBOS_INFO_LEN];
@@ -106,6 +683,7 @@ struct fobos_dev_t
     char serial[FOBOS_INFO_LEN];
     //=== rx stuff =============================================================
     double rx_frequency;
+    double rx_frequency_req;            // requested, replayed by the recovery
     uint32_t rx_frequency_band;
     double rx_samplerate;
     double rx_bandwidth;
@@ -116,28 +694,189 @@ struct fobos_dev_t
     uint32_t rx_bw_adj;
     uint32_t rx_direct_sampling;
     fobos_rx_cb_t rx_cb;
+    fobos_rx_fmt_cb_t rx_fmt_cb;
+    fobos_rx_meta_cb_t rx_meta_cb;
     void *rx_cb_ctx;
-    enum fobos_async_status rx_async_status;
+    int rx_format;
+    fobos_atomic_t rx_async_status;     // enum fobos_async_status
     int rx_async_cancel;
     uint32_t rx_failures;
     uint32_t rx_buff_counter;
     int rx_swap_iq;
+    int rx_dc_mode;
+    struct fobos_rx_cvt_sel_t rx_cvt_sel;   // of the buffers captured from now on
     float rx_dc_re;
     float rx_dc_im;
-    float rx_avg_re;
-    float rx_avg_im;
+    fobos_atomic64_t rx_avg;        // fobos_cal_avg_t, updated as a pair by the calibration
     float rx_scale_re;
-    float rx_scale_im;
-    float * rx_buff;
+    fobos_atomic_t rx_scale_im;     // float, published by the calibration
+    void * rx_buff;
     double max2830_clock;
     uint64_t rffc507x_clock;
     uint16_t rffc507x_registers_local[31];
     uint16_t rffc500x_registers_remote[31];
     int rx_sync_started;
     unsigned char * rx_sync_buf;
+    uint32_t sync_depth;                // transfers in flight, 0 - blocking transfer per read
+    uint32_t sync_next;                 // transfer to complete next
+    uint32_t sync_offset;               // samples of rx_buff already returned
+    uint32_t sync_length;               // samples converted into rx_buff
+    int sync_completed;
     int do_reset;
+    //=== conversion worker pool ===============================================
+    uint32_t cvt_threads_count;
+    struct fobos_cvt_pool_t * cvt_pool;
+    //=== processing thread ====================================================
+    uint32_t proc_queue_depth;
+    int proc_running;
+    int proc_quit;
+    fobos_thread_t proc_thread;
+    fobos_mutex_t proc_lock;
+    fobos_cond_t proc_cond;
+    fobos_atomic_t proc_sleeping;
+    fobos_spsc_t proc_filled;
+    fobos_spsc_t proc_free;
+    struct fobos_rx_stats_t rx_stats;
+    //=== ring pull mode =======================================================
+    struct fobos_rx_ring_t * rx_ring;
+    //=== automatic buffers ====================================================
+    double auto_latency_ms;             // 0 - disabled
+    double auto_stall_ms;               // host stall the transfers in flight have to cover
+    //=== owned event thread ===================================================
+    int evt_cpu;
+    int evt_priority;
+    int evt_running;
+    int evt_finished;
+    int evt_result;
+    fobos_thread_t evt_thread;
+    fobos_mutex_t evt_lock;
+    fobos_cond_t evt_cond;
+    fobos_rx_fmt_cb_t evt_cb;
+    void * evt_ctx;
+    uint32_t evt_buf_count;
+    uint32_t evt_buf_length;
+    int evt_format;
+    int evt_polled;                     // the application runs the events
+    fobos_pollfd_added_cb_t pollfd_added;
+    fobos_pollfd_removed_cb_t pollfd_removed;
+    void * pollfd_ctx;
+    //=== session ==============================================================
+    struct fobos_session_t * session;   // NULL - the device owns its libusb context
+    int evt_session;                    // streamed by the session event thread
+    int start_deferred;                 // fobos_rx_async_begin() leaves the data flow stopped
+    uint64_t start_ns;                  // data flow start time
+    //=== zero-copy leases =====================================================
+    fobos_rx_lease_cb_t rx_lease_cb;    // NULL - disabled
+    uint32_t lease_spare_count;
+    int lease_running;
+    int lease_waiting;                  // the stop waits for the leases out
+    fobos_mutex_t lease_lock;           // kept from the open to the close
+    fobos_cond_t lease_cond;
+    struct fobos_rx_buf_t * lease_free[FOBOS_MAX_BUF_COUNT];
+    uint32_t lease_free_count;
+    uint32_t lease_held;
+    //=== callback framing =====================================================
+    uint32_t frame_length;              // complex samples, 0 - one callback per transfer
+    uint32_t frame_hop;
+    uint32_t frame_capacity;            // samples the frame store (rx_buff) holds, 0 - framing off
+    uint32_t frame_start;               // next frame start in the store
+    uint32_t frame_end;                 // samples converted into the store
+    uint32_t frame_skip;                // samples to drop before the next frame (hop > frame length)
+    uint64_t frame_index;               // sample index of the store start
+    uint32_t frame_flags;               // flags pending for the next frame
+    uint64_t frame_lost;                // lost samples pending for the next frame
+    //=== frequency hopping ====================================================
+    struct fobos_rx_tune_plan_t * hop_plans;    // NULL - no hop schedule
+    uint32_t * hop_dwells;              // complex samples
+    uint32_t hop_count;
+    uint32_t hop_settle;                // complex samples dropped after a retune
+    uint32_t hop_pos;                   // schedule entry of the current segment
+    uint64_t hop_start;                 // first sample index of the current segment
+    uint64_t hop_captured;              // samples of the current segment so far
+    int hop_closed;                     // the dwell is reached, retune between the buffers
+    int hop_failing;                    // the last retune failed, reported once until one succeeds
+    uint32_t hop_flags;                 // flags of the dropped buffers pending for the next segment
+    uint64_t hop_lost;                  // lost samples of the dropped buffers pending
+    //=== buffer arena =========================================================
+    unsigned int arena_flags;           // FOBOS_ARENA_* for the next allocation
+    unsigned int arena_used_flags;      // FOBOS_ARENA_* the arena was made with
+    uint8_t * arena;
+    size_t arena_size;
+    //=== buffer metadata ======================================================
+    struct fobos_rx_meta_t rx_meta;     // last delivered buffer
+    uint64_t meta_index;                // next sample index at the usb side
+    uint64_t meta_lost;                 // lost samples pending for the next buffer
+    uint32_t meta_flags;                // flags pending for the next buffer
+    uint64_t meta_next;                 // next sample index expected at the delivery side
+    uint64_t meta_t0;
+    uint64_t meta_last_ns;              // last completion
+    uint32_t meta_config_id;            // configuration reported by the metadata
+    double meta_frequency;
+    double meta_samplerate;
+    uint32_t meta_lna_gain;
+    uint32_t meta_vga_gain;
+    uint32_t meta_count;
+    uint32_t meta_window;
+    uint32_t meta_win_count;
+    double meta_base;
+    double meta_win_min;
+    //=== iq calibration =======================================================
+    int cal_mode;
+    uint32_t cal_interval;
+    uint32_t cal_interval_ms;
+    uint32_t cal_elapsed;
+    uint32_t cal_count;
+    uint64_t cal_last_ns;
+    int cal_running;
+    int cal_quit;
+    fobos_atomic_t cal_busy;
+    fobos_thread_t cal_thread;
+    fobos_mutex_t cal_lock;
+    fobos_cond_t cal_cond;
+    int16_t * cal_buf;
+    size_t cal_buf_size;
+    size_t cal_buf_length;
+    uint32_t cal_buf_elapsed;
+};
+//==============================================================================
+#define FOBOS_SESSION_MAX_DEVICES 32
+struct fobos_session_t
+{
+    libusb_context * libusb_ctx;
+    fobos_thread_t thread;
+    fobos_mutex_t lock;
+    fobos_cond_t cond;
+    int quit;
+    uint32_t dev_count;
+    struct fobos_dev_t * devs[FOBOS_SESSION_MAX_DEVICES];
 };
 //==============================================================================
+void fobos_cvt_init(void);
+static void fobos_rx_cvt_select(struct fobos_dev_t * dev);
+static void fobos_session_remove(struct fobos_dev_t * dev);
+static void fobos_arena_release(struct fobos_dev_t * dev);
+static void fobos_session_wake(struct fobos_session_t * session);
+static void fobos_rx_hop_retune(struct fobos_dev_t * dev);
+int fobos_free_buffers(struct fobos_dev_t *dev);
+//==============================================================================
+// the async status is written by the streaming thread and the control calls
+static enum fobos_async_status fobos_rx_status(struct fobos_dev_t * dev)
+{
+    return (enum fobos_async_status)fobos_atomic_load(&dev->rx_async_status);
+}
+//==============================================================================
+static void fobos_rx_set_status(struct fobos_dev_t * dev, enum fobos_async_status status)
+{
+    fobos_atomic_store(&dev->rx_async_status, (int32_t)status);
+}
+//==============================================================================
+// starting or running -> canceling, returns 0 when the stream was in another state
+static int fobos_rx_status_cancel(struct fobos_dev_t * dev)
+{
+    return fobos_atomic_cas(&dev->rx_async_status, FOBOS_RUNNING, FOBOS_CANCELING) ||
+        fobos_atomic_cas(&dev->rx_async_status, FOBOS_STARTING, FOBOS_CANCELING);
+}
+//==============================================================================
 char * to_bin(uint16_t s16, char * str)
 {
     for (uint16_t i = 0; i < 16; i++)
@@ -297,7 +1036,7 @@ int fobos_check(struct fobos_dev_t * dev)
 #define CTRLO       (LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_ENDPOINT_OUT)
 #define CTRL_TIMEOUT    300
 //==============================================================================
-void fobos_i2c_write(struct fobos_dev_t * dev, uint8_t address, uint8_t* data, uint16_t size)
+int fobos_i2c_write(struct fobos_dev_t * dev, uint8_t address, uint8_t* data, uint16_t size)
 {
     uint8_t req_code = 0xE7;
     int result = fobos_check(dev);
@@ -317,6 +1056,7 @@ void fobos_i2c_write(struct fobos_dev_t * dev, uint8_t address, uint8_t* data, u
     {
         printf_internal("fobos_i2c_write() err %d\n", result);
     }
+    return result;
 }
 //==============================================================================
 void fobos_i2c_read(struct fobos_dev_t * dev, uint8_t address, uint8_t* data, uint16_t size)
@@ -341,12 +1081,25 @@ void fobos_i2c_read(struct fobos_dev_t * dev, uint8_t address, uint8_t* data, ui
     }
 }
 //==============================================================================
-void fobos_max2830_write_reg(struct fobos_dev_t * dev, uint8_t addr, uint16_t data)
+int fobos_max2830_write_reg(struct fobos_dev_t * dev, uint8_t addr, uint16_t data)
 {
     uint8_t req_code = 0xE5;
     int result = fobos_check(dev);
     uint8_t tx[3];
     uint16_t xsize;
+    if ((result == 0) && (addr < FOBOS_MAX2830_REGS_COUNT))
+    {
+        dev->max2830_local[addr] = data;
+        if (dev->cfg_defer)
+        {
+            if (!(dev->max2830_dirty & (1u << addr)))
+            {
+                dev->max2830_dirty |= 1u << addr;
+                dev->max2830_order[dev->max2830_dirty_count++] = addr;
+            }
+            return FOBOS_ERR_OK;
+        }
+    }
     tx[0] = addr;
     tx[1] = data & 0xFF;
     tx[2] = (data >> 8) & 0xFF;
@@ -362,6 +1115,12 @@ void fobos_max2830_write_reg(struct fobos_dev_t * dev, uint8_t addr, uint16_t da
     {
         printf_internal("fobos_max2830_write_reg() err %d\n", result);
     }
+    else if (addr < FOBOS_MAX2830_REGS_COUNT)
+    {
+        dev->max2830_remote[addr] = data;
+        dev->max2830_known |= 1u << addr;
+    }
+    return result;
 }
 //==============================================================================
 int fobos_max2830_init(struct fobos_dev_t * dev)
@@ -385,31 +1144,42 @@ int fobos_max2830_init(struct fobos_dev_t * dev)
     return 0;
 }
 //==============================================================================
-int fobos_max2830_set_frequency(struct fobos_dev_t * dev, double value, double * actual)
+// registers 5, 3, 4 of the frequency, returns the actual frequency
+static double fobos_max2830_calc(struct fobos_dev_t * dev, double value, uint16_t * regs)
 {
-#ifdef FOBOS_PRINT_DEBUG
-    printf_internal("%s(%f);\n", __FUNCTION__, value);
-#endif // FOBOS_PRINT_DEBUG
     double fcomp = dev->max2830_clock;
     if (fcomp > 26000000.0)
     {
         fcomp /= 2.0;
-        fobos_max2830_write_reg(dev, 5, 0x00A4); // Reference Frequency Divider = 2
+        regs[0] = 0x00A4; // Reference Frequency Divider = 2
     }
     else
     {
-        fobos_max2830_write_reg(dev, 5, 0x00A0); // Reference Frequency Divider = 1
+        regs[0] = 0x00A0; // Reference Frequency Divider = 1
     }
     double div = value / fcomp;
     uint32_t div_int = (uint32_t)(div) & 0x000000FF;
     uint32_t div_frac = (uint32_t)((div - div_int) * 1048575.0 + 0.5);
+    regs[1] = ((div_frac << 8) | div_int) & 0x3FFF;
+    regs[2] = (div_frac >> 6) & 0x3FFF;
+    div = (double)(div_int) + (double)(div_frac) / 1048575.0;
+    return div * fcomp;
+}
+//==============================================================================
+int fobos_max2830_set_frequency(struct fobos_dev_t * dev, double value, double * actual)
+{
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%f);\n", __FUNCTION__, value);
+#endif // FOBOS_PRINT_DEBUG
+    uint16_t regs[3];
+    double freq = fobos_max2830_calc(dev, value, regs);
     if (actual)
     {
-        div = (double)(div_int) + (double)(div_frac) / 1048575.0;
-        *actual = div * fcomp;
+        *actual = freq;
     }
-    fobos_max2830_write_reg(dev, 3, ((div_frac << 8) | div_int) & 0x3FFF);
-    fobos_max2830_write_reg(dev, 4, (div_frac >> 6) & 0x3FFF);
+    fobos_max2830_write_reg(dev, 5, regs[0]);
+    fobos_max2830_write_reg(dev, 3, regs[1]);
+    fobos_max2830_write_reg(dev, 4, regs[2]);
     return 0;
 }
 //==============================================================================
@@ -491,6 +1261,10 @@ int fobos_rffc507x_commit(struct fobos_dev_t * dev, int force)
 {
     if (fobos_check(dev) == 0)
     {
+        if (dev->cfg_defer)
+        {
+            return FOBOS_ERR_OK;
+        }
         for (int i = 0; i < RFFC507X_REGS_COUNT; i++)
         {
             uint16_t local = dev->rffc507x_registers_local[i];
@@ -542,7 +1316,20 @@ int fobos_rffc507x_init(struct fobos_dev_t * dev)
     return FOBOS_ERR_NO_DEV;
 }
 //==============================================================================
-int fobos_rffc507x_set_lo_frequency_hz(struct fobos_dev_t * dev, uint64_t lo_freq_hz, uint64_t * tune_freq_hz)
+#define FOBOS_RFFC507X_PLL_REGS     7
+static const uint8_t fobos_rffc507x_pll_regs[FOBOS_RFFC507X_PLL_REGS] = { 0x00, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11 };
+// the bits of the pll fields, a tune plan may write no others
+static const uint16_t fobos_rffc507x_pll_masks[FOBOS_RFFC507X_PLL_REGS] = { 0x0007, 0xFFFC, 0xFFFF, 0xFF00, 0xFFFC, 0xFFFF, 0xFF00 };
+//==============================================================================
+static void fobos_rffc507x_field(uint16_t * reg, uint16_t * mask, uint8_t bit_to, uint8_t bit_from, uint16_t value)
+{
+    fobos_rffc507x_register_modify(reg, bit_to, bit_from, value);
+    fobos_rffc507x_register_modify(mask, bit_to, bit_from, 0xFFFF);
+}
+//==============================================================================
+// pll fields of the lo frequency in the registers fobos_rffc507x_pll_regs[]
+// with the masks of the bits they own, returns the actual lo frequency
+static uint64_t fobos_rffc507x_calc(struct fobos_dev_t * dev, uint64_t lo_freq_hz, uint16_t * regs, uint16_t * masks)
 {
     uint64_t lodiv;
     uint64_t fvco;
@@ -573,34 +1360,54 @@ int fobos_rffc507x_set_lo_frequency_hz(struct fobos_dev_t * dev, uint64_t lo_fre
         pllcpl = 3;
     }
 
-    fobos_rffc507x_register_modify(&dev->rffc507x_registers_local[0x15], 14, 14, 0); // enbl = 0
-    fobos_rffc507x_commit(dev, 0);
-
-    fobos_rffc507x_register_modify(&dev->rffc507x_registers_local[0x00], 2, 0, pllcpl);
-
     uint64_t tmp_n = (fvco << 29ULL) / (fbkdiv * fref);
     n = (uint16_t)(tmp_n >> 29ULL);
 
     p1nmsb = (tmp_n >> 13ULL) & 0xffff;
     p1nlsb = (tmp_n >> 5ULL) & 0xff;
     uint64_t freq_hz = (fref * (tmp_n >> 5ULL) * fbkdiv) / (lodiv * (1 << 24ULL));
+    memset(regs, 0, FOBOS_RFFC507X_PLL_REGS * sizeof(uint16_t));
+    memset(masks, 0, FOBOS_RFFC507X_PLL_REGS * sizeof(uint16_t));
+    fobos_rffc507x_field(&regs[0], &masks[0], 2,  0, pllcpl);      // 0x00 pllcpl
+    // Path 1
+    fobos_rffc507x_field(&regs[1], &masks[1], 6,  4, n_lo);        // 0x0C p1lodiv
+    fobos_rffc507x_field(&regs[1], &masks[1], 15, 7, n);           // 0x0C p1n
+    fobos_rffc507x_field(&regs[1], &masks[1], 3,  2, fbkdiv >> 1); // 0x0C p1presc
+    fobos_rffc507x_field(&regs[2], &masks[2], 15, 0, p1nmsb);      // 0x0D p1nmsb
+    fobos_rffc507x_field(&regs[3], &masks[3], 15, 8, p1nlsb);      // 0x0E p1nlsb
+    // Path 2
+    fobos_rffc507x_field(&regs[4], &masks[4], 6,  4, n_lo);        // 0x0F p2lodiv
+    fobos_rffc507x_field(&regs[4], &masks[4], 15, 7, n);           // 0x0F p2n
+    fobos_rffc507x_field(&regs[4], &masks[4], 3,  2, fbkdiv >> 1); // 0x0F p2presc
+    fobos_rffc507x_field(&regs[5], &masks[5], 15, 0, p1nmsb);      // 0x10 p2nmsb
+    fobos_rffc507x_field(&regs[6], &masks[6], 15, 8, p1nlsb);      // 0x11 p2nlsb
+    return freq_hz;
+}
+//==============================================================================
+static void fobos_rffc507x_pll_load(struct fobos_dev_t * dev, const uint16_t * regs, const uint16_t * masks)
+{
+    for (int i = 0; i < FOBOS_RFFC507X_PLL_REGS; i++)
+    {
+        uint16_t * local = &dev->rffc507x_registers_local[fobos_rffc507x_pll_regs[i]];
+        uint16_t mask = masks[i] & fobos_rffc507x_pll_masks[i];
+        *local = (*local & ~mask) | (regs[i] & mask);
+    }
+}
+//==============================================================================
+int fobos_rffc507x_set_lo_frequency_hz(struct fobos_dev_t * dev, uint64_t lo_freq_hz, uint64_t * tune_freq_hz)
+{
+    uint16_t regs[FOBOS_RFFC507X_PLL_REGS];
+    uint16_t masks[FOBOS_RFFC507X_PLL_REGS];
+    uint64_t freq_hz = fobos_rffc507x_calc(dev, lo_freq_hz, regs, masks);
     if (tune_freq_hz)
     {
         *tune_freq_hz = freq_hz;
     }
-    // Path 1
-    fobos_rffc507x_register_modify(&dev->rffc507x_registers_local[0x0C], 6,  4, n_lo);        // p1lodiv
-    fobos_rffc507x_register_modify(&dev->rffc507x_registers_local[0x0C], 15, 7, n);           // p1n
-    fobos_rffc507x_register_modify(&dev->rffc507x_registers_local[0x0C], 3,  2, fbkdiv >> 1); // p1presc
-    fobos_rffc507x_register_modify(&dev->rffc507x_registers_local[0x0D], 15, 0, p1nmsb);      // p1nmsb
-    fobos_rffc507x_register_modify(&dev->rffc507x_registers_local[0x0E], 15, 8, p1nlsb);      // p1nlsb
-                                                                                              // Path 2
-    fobos_rffc507x_register_modify(&dev->rffc507x_registers_local[0x0F], 6,  4, n_lo);        // p2lodiv
-    fobos_rffc507x_register_modify(&dev->rffc507x_registers_local[0x0F], 15, 7, n);           // p1n
-    fobos_rffc507x_register_modify(&dev->rffc507x_registers_local[0x0F], 3,  2, fbkdiv >> 1); // p1presc
-    fobos_rffc507x_register_modify(&dev->rffc507x_registers_local[0x10], 15, 0, p1nmsb);      // p1nmsb
-    fobos_rffc507x_register_modify(&dev->rffc507x_registers_local[0x11], 15, 8, p1nlsb);      // p1nlsb
 
+    fobos_rffc507x_register_modify(&dev->rffc507x_registers_local[0x15], 14, 14, 0); // enbl = 0
+    fobos_rffc507x_commit(dev, 0);
+
+    fobos_rffc507x_pll_load(dev, regs, masks);
     fobos_rffc507x_commit(dev, 0);
 
     fobos_rffc507x_register_modify(&dev->rffc507x_registers_local[0x15], 14, 14, 1); // enbl = 1
@@ -613,12 +1420,6 @@ int fobos_rffc507x_set_lo_frequency_hz(struct fobos_dev_t * dev, uint64_t lo_fre
 }
 //==============================================================================
 #define SI5351C_ADDRESS 0x60
-void fobos_si5351c_write_reg(struct fobos_dev_t * dev, uint8_t reg, uint8_t val)
-{
-    uint8_t data[] = {reg, val};
-    fobos_i2c_write(dev, SI5351C_ADDRESS, data, sizeof(data));
-}
-//==============================================================================
 uint8_t fobos_si5351c_read_reg(struct fobos_dev_t * dev, uint8_t reg)
 {
     uint8_t data = 0x00;
@@ -627,9 +1428,37 @@ uint8_t fobos_si5351c_read_reg(struct fobos_dev_t * dev, uint8_t reg)
     return data;
 }
 //==============================================================================
-void fobos_si5351c_write(struct fobos_dev_t * dev, uint8_t* data, uint16_t size)
+// data[0] - first register, the registers written are tracked for the configuration transactions
+int fobos_si5351c_write(struct fobos_dev_t * dev, uint8_t* data, uint16_t size)
 {
-    fobos_i2c_write(dev, SI5351C_ADDRESS, data, size);
+    if ((fobos_check(dev) == 0) && dev->cfg_defer)
+    {
+        for (uint32_t i = 1; (i < size) && (data[0] + i - 1 < FOBOS_SI5351C_REGS_COUNT); i++)
+        {
+            uint32_t reg = data[0] + i - 1;
+            dev->si5351c_local[reg] = data[i];
+            dev->si5351c_dirty[reg >> 5] |= 1u << (reg & 31);
+        }
+        return FOBOS_ERR_OK;
+    }
+    int result = fobos_i2c_write(dev, SI5351C_ADDRESS, data, size);
+    if (result == 0)
+    {
+        for (uint32_t i = 1; (i < size) && (data[0] + i - 1 < FOBOS_SI5351C_REGS_COUNT); i++)
+        {
+            uint32_t reg = data[0] + i - 1;
+            dev->si5351c_local[reg] = data[i];
+            dev->si5351c_remote[reg] = data[i];
+            dev->si5351c_known[reg >> 5] |= 1u << (reg & 31);
+        }
+    }
+    return result;
+}
+//==============================================================================
+void fobos_si5351c_write_reg(struct fobos_dev_t * dev, uint8_t reg, uint8_t val)
+{
+    uint8_t data[] = {reg, val};
+    fobos_si5351c_write(dev, data, sizeof(data));
 }
 //==============================================================================
 void fobos_si5351c_read(struct fobos_dev_t * dev, uint8_t* data, uint16_t size)
@@ -761,12 +1590,18 @@ int fobos_fx3_command(struct fobos_dev_t * dev, uint8_t code, uint16_t value, ui
     return result;
 }
 //==============================================================================
-int fobos_rx_set_user_gpo(struct fobos_dev_t * dev, uint8_t value)
+static int fobos_rx_apply_user_gpo(struct fobos_dev_t * dev, uint8_t value)
 {
 #ifdef FOBOS_PRINT_DEBUG
     printf_internal("%s(0x%04x);\n", __FUNCTION__, value);
 #endif // FOBOS_PRINT_DEBUG
-    return fobos_fx3_command(dev, 0xE3, value, 0);
+    int result = fobos_fx3_command(dev, 0xE3, value, 0);
+    if (result == 0)
+    {
+        dev->user_gpo = value;
+        dev->user_gpo_known = 1;
+    }
+    return result;
 }
 //==============================================================================
 int fobos_rx_set_dev_gpo(struct fobos_dev_t * dev, uint16_t value)
@@ -774,10 +1609,173 @@ int fobos_rx_set_dev_gpo(struct fobos_dev_t * dev, uint16_t value)
 #ifdef FOBOS_PRINT_DEBUG
     printf_internal("%s(0x%04x);\n", __FUNCTION__, value);
 #endif // FOBOS_PRINT_DEBUG
-    return fobos_fx3_command(dev, 0xE4, value, 0);
+    if ((fobos_check(dev) == 0) && dev->cfg_defer)
+    {
+        // the setters pass dev_gpo, the commit writes its final value
+        dev->gpo_dirty = 1;
+        return FOBOS_ERR_OK;
+    }
+    int result = fobos_fx3_command(dev, 0xE4, value, 0);
+    if (result == 0)
+    {
+        dev->gpo_remote = value;
+        dev->gpo_known = 1;
+    }
+    return result;
 }
 //==============================================================================
-int fobos_rx_open(struct fobos_dev_t ** out_dev, uint32_t index)
+// Configuration transactions
+// Between fobos_rx_begin_config() and fobos_rx_commit_config() the setters
+// only update the cached register images: the gpo, the si5351c registers, the
+// max2830 registers and the rffc507x local registers. The commit compares them
+// with the values last written to the device and writes each changed register
+// once: the gpo, the si5351c registers in bursts of consecutive registers, the
+// max2830 registers in the order they were first set, then the rffc507x with a
+// single enable toggle around its pll registers. The writes issued outside the
+// setters (stream start and stop, the explicit chip calls) are not deferred.
+//==============================================================================
+static void fobos_rx_config_reset(struct fobos_dev_t * dev)
+{
+    fobos_atomic_store(&dev->cfg_txn, 0);
+    dev->cfg_defer = 0;
+    dev->cfg_txn_codes = 0;
+    dev->gpo_known = 0;
+    dev->gpo_dirty = 0;
+    dev->max2830_known = 0;
+    dev->max2830_dirty = 0;
+    dev->max2830_dirty_count = 0;
+    memset(dev->si5351c_known, 0, sizeof(dev->si5351c_known));
+    memset(dev->si5351c_dirty, 0, sizeof(dev->si5351c_dirty));
+}
+//==============================================================================
+static int fobos_rx_apply_begin_config(struct fobos_dev_t * dev)
+{
+    if (!fobos_atomic_load(&dev->cfg_txn))
+    {
+        fobos_atomic_store(&dev->cfg_txn, 1);
+        dev->cfg_txn_codes = 0;
+    }
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+static int fobos_si5351c_changed(struct fobos_dev_t * dev, uint32_t reg)
+{
+    uint32_t bit = 1u << (reg & 31);
+    if (!(dev->si5351c_dirty[reg >> 5] & bit))
+    {
+        return 0;
+    }
+    return !(dev->si5351c_known[reg >> 5] & bit) || (dev->si5351c_local[reg] != dev->si5351c_remote[reg]);
+}
+//==============================================================================
+static int fobos_rx_apply_commit_config(struct fobos_dev_t * dev)
+{
+    int result = FOBOS_ERR_OK;
+    int err = 0;
+    if (!fobos_atomic_load(&dev->cfg_txn))
+    {
+        return result;
+    }
+    fobos_atomic_store(&dev->cfg_txn, 0);
+    dev->cfg_defer = 0;
+    if (dev->gpo_dirty)
+    {
+        dev->gpo_dirty = 0;
+        if (!dev->gpo_known || (dev->gpo_remote != dev->dev_gpo))
+        {
+            err = fobos_rx_set_dev_gpo(dev, dev->dev_gpo);
+            result = (result < 0) ? result : err;
+        }
+    }
+    uint8_t data[1 + FOBOS_SI5351C_BURST];
+    uint32_t reg = 0;
+    while (reg < FOBOS_SI5351C_REGS_COUNT)
+    {
+        if (!fobos_si5351c_changed(dev, reg))
+        {
+            reg++;
+            continue;
+        }
+        uint16_t size = 1;
+        data[0] = (uint8_t)reg;
+        while ((reg < FOBOS_SI5351C_REGS_COUNT) && (size <= FOBOS_SI5351C_BURST) && fobos_si5351c_changed(dev, reg))
+        {
+            data[size++] = dev->si5351c_local[reg++];
+        }
+        err = fobos_si5351c_write(dev, data, size);
+        result = (result < 0) ? result : err;
+    }
+    memset(dev->si5351c_dirty, 0, sizeof(dev->si5351c_dirty));
+    for (uint32_t i = 0; i < dev->max2830_dirty_count; i++)
+    {
+        uint8_t addr = dev->max2830_order[i];
+        if (!(dev->max2830_known & (1u << addr)) || (dev->max2830_local[addr] != dev->max2830_remote[addr]))
+        {
+            err = fobos_max2830_write_reg(dev, addr, dev->max2830_local[addr]);
+            result = (result < 0) ? result : err;
+        }
+    }
+    dev->max2830_dirty = 0;
+    dev->max2830_dirty_count = 0;
+    // the pll registers are written with the synthesizer disabled
+    uint16_t enbl = 1 << 14;
+    int pll_changed = 0;
+    for (int i = 0; i < RFFC507X_REGS_COUNT; i++)
+    {
+        if ((i != 0x15) && (dev->rffc507x_registers_local[i] != dev->rffc500x_registers_remote[i]))
+        {
+            pll_changed = 1;
+        }
+    }
+    if (pll_changed && (dev->rffc500x_registers_remote[0x15] & enbl))
+    {
+        uint16_t value = dev->rffc500x_registers_remote[0x15] & ~enbl;
+        err = fobos_rffc507x_write_reg(dev, 0x15, value);
+        result = (result < 0) ? result : err;
+        dev->rffc500x_registers_remote[0x15] = value;
+    }
+    for (int i = 0; i < RFFC507X_REGS_COUNT; i++)
+    {
+        if ((i != 0x15) && (dev->rffc507x_registers_local[i] != dev->rffc500x_registers_remote[i]))
+        {
+            err = fobos_rffc507x_write_reg(dev, i, dev->rffc507x_registers_local[i]);
+            result = (result < 0) ? result : err;
+            dev->rffc500x_registers_remote[i] = dev->rffc507x_registers_local[i];
+        }
+    }
+    if (dev->rffc507x_registers_local[0x15] != dev->rffc500x_registers_remote[0x15])
+    {
+        err = fobos_rffc507x_write_reg(dev, 0x15, dev->rffc507x_registers_local[0x15]);
+        result = (result < 0) ? result : err;
+        dev->rffc500x_registers_remote[0x15] = dev->rffc507x_registers_local[0x15];
+    }
+    return (result < 0) ? FOBOS_ERR_CONTROL : FOBOS_ERR_OK;
+}
+//==============================================================================
+// power on state of the gpo, clock generator and synthesizers
+static int fobos_rx_hw_init(struct fobos_dev_t * dev)
+{
+    fobos_rx_config_reset(dev);
+    dev->dev_gpo = 0;
+    bitset(dev->dev_gpo, FOBOS_DEV_CLKSEL);
+    bitset(dev->dev_gpo, FOBOS_DEV_LNA_LP_SHD);
+    bitset(dev->dev_gpo, FOBOS_DEV_LNA_HP_SHD);
+    bitset(dev->dev_gpo, FOBOS_DEV_ADC_NCS);
+    bitset(dev->dev_gpo, FOBOS_DEV_ADC_SCK);
+    bitset(dev->dev_gpo, FOBOS_DEV_ADC_SDI);
+    bitset(dev->dev_gpo, FOBOS_DEV_NENBL_HF);
+    int result = fobos_rx_set_dev_gpo(dev, dev->dev_gpo);
+    if (result < 0)
+    {
+        return result;
+    }
+    fobos_si5351c_init(dev);
+    fobos_max2830_init(dev);
+    fobos_rffc507x_init(dev);
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+static int fobos_rx_open_ex(struct fobos_dev_t ** out_dev, uint32_t index, struct fobos_session_t * session)
 {
     int result = 0;
     int i = 0;
@@ -787,17 +1785,34 @@ int fobos_rx_open(struct fobos_dev_t ** out_dev, uint32_t index)
     ssize_t cnt;
     uint32_t device_count = 0;
     struct libusb_device_descriptor dd;
+    fobos_cvt_init();
     dev = (struct fobos_dev_t*)malloc(sizeof(struct fobos_dev_t));
     if (NULL == dev)
     {
         return FOBOS_ERR_NO_MEM;
     }
     memset(dev, 0, sizeof(struct fobos_dev_t));
-    result = libusb_init(&dev->libusb_ctx);
-    if (result < 0)
+    fobos_mutex_init(&dev->state_lock);
+    fobos_cond_init(&dev->state_cond);
+    fobos_mutex_init(&dev->lease_lock);
+    fobos_cond_init(&dev->lease_cond);
+    for (i = 0; i < FOBOS_CMD_QUEUE_LEN; i++)
     {
-        free(dev);
-        return result;
+        dev->cmd_slots[i].seq = i;
+    }
+    if (session)
+    {
+        dev->session = session;
+        dev->libusb_ctx = session->libusb_ctx;
+    }
+    else
+    {
+        result = libusb_init(&dev->libusb_ctx);
+        if (result < 0)
+        {
+            free(dev);
+            return result;
+        }
     }
     cnt = libusb_get_device_list(dev->libusb_ctx, &dev_list);
     for (i = 0; i < cnt; i++)
@@ -845,26 +1860,19 @@ int fobos_rx_open(struct fobos_dev_t ** out_dev, uint32_t index)
                 }
                 //======================================================================
                 dev->rx_frequency_band = 0xFFFFFFFF;
-                dev->dev_gpo = 0;
                 dev->rx_scale_re = 1.0f / 32768.0f;
-                dev->rx_scale_im = 1.0f / 32768.0f;
+                fobos_atomic_store_float(&dev->rx_scale_im, 1.0f / 32768.0f);
+                dev->cal_mode = FOBOS_CAL_INLINE;
+                dev->cal_interval = 1;
+                dev->evt_cpu = -1;
+                dev->sync_depth = FOBOS_DEF_SYNC_DEPTH;
+                dev->auto_stall_ms = FOBOS_AUTO_STALL_MS;
                 dev->rx_dc_re = 8192.0f;
                 dev->rx_dc_im = 8192.0f;
-                dev->rx_avg_re = 0.0f;
-                dev->rx_avg_im = 0.0f;
+                fobos_atomic_store64(&dev->rx_avg, 0);
                 if (fobos_check(dev) == 0)
                 {
-                    bitset(dev->dev_gpo, FOBOS_DEV_CLKSEL);
-                    bitset(dev->dev_gpo, FOBOS_DEV_LNA_LP_SHD);
-                    bitset(dev->dev_gpo, FOBOS_DEV_LNA_HP_SHD);
-                    bitset(dev->dev_gpo, FOBOS_DEV_ADC_NCS);
-                    bitset(dev->dev_gpo, FOBOS_DEV_ADC_SCK);
-                    bitset(dev->dev_gpo, FOBOS_DEV_ADC_SDI);
-                    bitset(dev->dev_gpo, FOBOS_DEV_NENBL_HF);
-                    fobos_rx_set_dev_gpo(dev, dev->dev_gpo);
-                    fobos_si5351c_init(dev);
-                    fobos_max2830_init(dev);
-                    fobos_rffc507x_init(dev);
+                    fobos_rx_hw_init(dev);
                     fobos_rx_set_frequency(dev, 100E6, 0);
                     fobos_rx_set_samplerate(dev, 25000000.0, 0);
                     libusb_free_device_list(dev_list, 1);
@@ -892,14 +1900,23 @@ int fobos_rx_open(struct fobos_dev_t ** out_dev, uint32_t index)
     {
         libusb_close(dev->libusb_devh);
     }
-    if (dev->libusb_ctx)
+    if (dev->libusb_ctx && !dev->session)
     {
         libusb_exit(dev->libusb_ctx);
     }
+    fobos_cond_destroy(&dev->lease_cond);
+    fobos_mutex_destroy(&dev->lease_lock);
+    fobos_cond_destroy(&dev->state_cond);
+    fobos_mutex_destroy(&dev->state_lock);
     free(dev);
     return FOBOS_ERR_NO_DEV;
 }
 //==============================================================================
+int fobos_rx_open(struct fobos_dev_t ** out_dev, uint32_t index)
+{
+    return fobos_rx_open_ex(out_dev, index, NULL);
+}
+//==============================================================================
 int fobos_rx_close(struct fobos_dev_t * dev)
 {
     int result = fobos_check(dev);
@@ -910,19 +1927,18 @@ int fobos_rx_close(struct fobos_dev_t * dev)
     {
         return result;
     }
+    fobos_rx_stop_async(dev);
+    fobos_rx_ring_stop(dev);
     fobos_rx_cancel_async(dev);
     fobos_rx_stop_sync(dev);
-    while (FOBOS_IDDLE != dev->rx_async_status)
+    // a fobos_rx_read_async() of another thread ends
+    fobos_mutex_lock(&dev->state_lock);
+    while (FOBOS_IDDLE != fobos_rx_status(dev))
     {
-#ifdef FOBOS_PRINT_DEBUG
-        printf_internal("s");
-#endif
-#ifdef _WIN32
-        Sleep(1);
-#else
-        sleep(1);
-#endif
+        fobos_rx_cancel_async(dev);
+        fobos_cond_timedwait(&dev->state_cond, &dev->state_lock, 100);
     }
+    fobos_mutex_unlock(&dev->state_lock);
     fobos_fx3_command(dev, 0xE1, 0, 0);       // stop fx
     bitset(dev->dev_gpo, FOBOS_DEV_ADC_SDI);
     bitclear(dev->dev_gpo, FOBOS_DEV_LPF_A0);
@@ -940,7 +1956,21 @@ int fobos_rx_close(struct fobos_dev_t * dev)
         libusb_control_transfer(dev->libusb_devh, CTRLO, 0xE0, 0, 0, 0, 0, CTRL_TIMEOUT);
     }
     libusb_close(dev->libusb_devh);
-    libusb_exit(dev->libusb_ctx);
+    fobos_arena_release(dev);
+    free(dev->hop_plans);
+    free(dev->hop_dwells);
+    if (dev->session)
+    {
+        fobos_session_remove(dev);
+    }
+    else
+    {
+        libusb_exit(dev->libusb_ctx);
+    }
+    fobos_cond_destroy(&dev->lease_cond);
+    fobos_mutex_destroy(&dev->lease_lock);
+    fobos_cond_destroy(&dev->state_cond);
+    fobos_mutex_destroy(&dev->state_lock);
     free(dev);
     return result;
 }
@@ -1148,162 +2178,310 @@ const fobos_rx_band_param_t fobos_rx_bands[] =
     },
 };
 //==============================================================================
-int fobos_rx_set_frequency(struct fobos_dev_t * dev, double value, double * actual)
+// Tuning plans
+// A plan holds everything a frequency needs: the band, the preselector and if
+// filter bits of the gpo, the max2830 divider registers, the rffc507x pll
+// fields and the resulting actual frequency and iq swap. fobos_rx_make_plans()
+// computes them once, loading a plan sets the register images and writes
+// only the registers that differ from the device state, the way a
+// configuration transaction commits. fobos_rx_set_frequency() tunes through a
+// plan made on the fly. The plans depend on the reference clocks only, so a
+// hop set can be saved in a portable little endian form and loaded at startup.
+//==============================================================================
+#define FOBOS_PLAN_MAGIC            0x4C505446  // "FTPL"
+#define FOBOS_PLAN_VERSION          1
+#define FOBOS_PLAN_HEADER_SIZE      16
+#define FOBOS_PLAN_RECORD_SIZE      74
+//==============================================================================
+// the preselector and if filter bits of the gpo for a band
+static uint16_t fobos_rx_band_gpo(uint32_t idx)
 {
-    int result = fobos_check(dev);
-#ifdef FOBOS_PRINT_DEBUG
-    printf_internal("%s(%f);\n", __FUNCTION__, value);
-#endif // FOBOS_PRINT_DEBUG    
-    if (result != FOBOS_ERR_OK)
+    uint16_t gpo = 0;
+    switch (fobos_rx_bands[idx].preselect)
     {
-        return result;
+        case FOBOS_PRESELECT_BYPASS:
+        {
+            bitclear(gpo, FOBOS_DEV_PRESEL_V1);
+            bitclear(gpo, FOBOS_DEV_PRESEL_V2);
+            bitclear(gpo, FOBOS_DEV_LNA_LP_SHD); // shut down both lnas
+            bitclear(gpo, FOBOS_DEV_LNA_HP_SHD); // shut down both lnas
+            break;
+        }
+        case FOBOS_PRESELECT_LOWPASS:
+        {
+            bitset(gpo, FOBOS_DEV_PRESEL_V1);
+            bitclear(gpo, FOBOS_DEV_PRESEL_V2);
+            bitclear(gpo, FOBOS_DEV_LNA_LP_SHD); // enable lowpass lna
+            bitset(gpo, FOBOS_DEV_LNA_HP_SHD);   // shut down highpass lna
+            break;
+        }
+        case FOBOS_PRESELECT_HIGHPASS:
+        {
+            bitclear(gpo, FOBOS_DEV_PRESEL_V1);
+            bitset(gpo, FOBOS_DEV_PRESEL_V2);
+            bitset(gpo, FOBOS_DEV_LNA_LP_SHD);   // shut down lowpass lna
+            bitclear(gpo, FOBOS_DEV_LNA_HP_SHD); // enable highpass lna
+            break;
+        }
     }
-    if (dev->rx_frequency != value)
+    switch (fobos_rx_bands[idx].if_filter)
     {
-        uint32_t count = (uint32_t)(sizeof(fobos_rx_bands) / sizeof(fobos_rx_bands[0]));
-        uint32_t freq_mhz = (uint32_t)(value / 1E6 + 0.5);
-        uint32_t idx = count;
-        for (uint32_t i = 0; i < count; i++)
+        case FOBOS_IF_FILTER_NONE:
         {
-            if ((freq_mhz >= fobos_rx_bands[i].freq_mhz_min) && (freq_mhz <= fobos_rx_bands[i].freq_mhz_max))
-            {
-                idx = i;
-                break;
-            }
+            bitclear(gpo, FOBOS_DEV_IF_V1);
+            bitclear(gpo, FOBOS_DEV_IF_V2);
+            bitset(gpo, FOBOS_MAX2830_ANTSEL);
+            break;
         }
-        if (idx == count)
+        case FOBOS_IF_FILTER_LOW:
         {
-            return FOBOS_ERR_UNSUPPORTED;
+            bitset(gpo, FOBOS_DEV_IF_V1);
+            bitclear(gpo, FOBOS_DEV_IF_V2);
+            bitclear(gpo, FOBOS_MAX2830_ANTSEL);
+            break;
         }
-        if (dev->rx_frequency_band != idx)
+        case FOBOS_IF_FILTER_HIGH:
         {
-            switch (fobos_rx_bands[idx].preselect)
-            {
-                case FOBOS_PRESELECT_BYPASS:
-                {
-                    bitclear(dev->dev_gpo, FOBOS_DEV_PRESEL_V1);
-                    bitclear(dev->dev_gpo, FOBOS_DEV_PRESEL_V2);
-                    bitclear(dev->dev_gpo, FOBOS_DEV_LNA_LP_SHD); // shut down both lnas
-                    bitclear(dev->dev_gpo, FOBOS_DEV_LNA_HP_SHD); // shut down both lnas
-                    break;
-                }
-                case FOBOS_PRESELECT_LOWPASS:
-                {
-                    bitset(dev->dev_gpo, FOBOS_DEV_PRESEL_V1);
-                    bitclear(dev->dev_gpo, FOBOS_DEV_PRESEL_V2);
-                    bitclear(dev->dev_gpo, FOBOS_DEV_LNA_LP_SHD); // enable lowpass lna
-                    bitset(dev->dev_gpo, FOBOS_DEV_LNA_HP_SHD);   // shut down highpass lna
-                    break;
-                }
-                case FOBOS_PRESELECT_HIGHPASS:
-                {
-                    bitclear(dev->dev_gpo, FOBOS_DEV_PRESEL_V1);
-                    bitset(dev->dev_gpo, FOBOS_DEV_PRESEL_V2);
-                    bitset(dev->dev_gpo, FOBOS_DEV_LNA_LP_SHD);   // shut down lowpass lna
-                    bitclear(dev->dev_gpo, FOBOS_DEV_LNA_HP_SHD); // enable highpass lna
-                    break;
-                }
-            }
-            switch (fobos_rx_bands[idx].if_filter)
-            {
-                case FOBOS_IF_FILTER_NONE:
-                {
-                    bitclear(dev->dev_gpo, FOBOS_DEV_IF_V1);
-                    bitclear(dev->dev_gpo, FOBOS_DEV_IF_V2);
-                    bitset(dev->dev_gpo, FOBOS_MAX2830_ANTSEL);
-                    break;
-                }
-                case FOBOS_IF_FILTER_LOW:
-                {
-                    bitset(dev->dev_gpo, FOBOS_DEV_IF_V1);
-                    bitclear(dev->dev_gpo, FOBOS_DEV_IF_V2);
-                    bitclear(dev->dev_gpo, FOBOS_MAX2830_ANTSEL);
-                    break;
-                }
-                case FOBOS_IF_FILTER_HIGH:
-                {
-                    bitclear(dev->dev_gpo, FOBOS_DEV_IF_V1);
-                    bitset(dev->dev_gpo, FOBOS_DEV_IF_V2);
-                    bitclear(dev->dev_gpo, FOBOS_MAX2830_ANTSEL);
-                    break;
-                }
-            }
-            fobos_rx_set_dev_gpo(dev, dev->dev_gpo);   // commit dev_gpo value
-            fobos_rffc507x_clock(dev, fobos_rx_bands[idx].rffc507x_enabled);
-            fobos_rffc507x_register_modify(&dev->rffc507x_registers_local[0x15], 14, 14, fobos_rx_bands[idx].rffc507x_enabled);
-            fobos_rffc507x_commit(dev, 0);
-            dev->rx_frequency_band = idx;
+            bitclear(gpo, FOBOS_DEV_IF_V1);
+            bitset(gpo, FOBOS_DEV_IF_V2);
+            bitclear(gpo, FOBOS_MAX2830_ANTSEL);
+            break;
+        }
+    }
+    return gpo;
+}
+//==============================================================================
+static int fobos_rx_plan_compute(struct fobos_dev_t * dev, double value, struct fobos_rx_tune_plan_t * plan)
+{
+    uint32_t count = (uint32_t)(sizeof(fobos_rx_bands) / sizeof(fobos_rx_bands[0]));
+    uint32_t freq_mhz = (uint32_t)(value / 1E6 + 0.5);
+    uint32_t idx = count;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if ((freq_mhz >= fobos_rx_bands[i].freq_mhz_min) && (freq_mhz <= fobos_rx_bands[i].freq_mhz_max))
+        {
+            idx = i;
+            break;
         }
-        dev->rx_swap_iq = fobos_rx_bands[idx].swap_iq;
+    }
+    if (idx == count)
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    memset(plan, 0, sizeof(*plan));
+    plan->frequency = value;
+    plan->max2830_clock = (uint32_t)dev->max2830_clock;
+    plan->rffc507x_clock = (uint32_t)dev->rffc507x_clock;
+    plan->band = idx;
+    plan->swap_iq = fobos_rx_bands[idx].swap_iq;
+    plan->rffc507x_enabled = fobos_rx_bands[idx].rffc507x_enabled;
+    plan->gpo_value = fobos_rx_band_gpo(idx);
+    plan->gpo_mask = FOBOS_PLAN_GPO_MASK;
 
-        double max2830_freq = 0.0;
-        double max2830_freq_actual = 0.0;
-        uint64_t RFFC5071_freq;
-        uint64_t RFFC5071_freq_hz_actual;
-        double rx_frequency = 0.0;
-        switch (fobos_rx_bands[idx].rffc507x_inject)
-        {
-            case FOBOS_INJECT_NONE:
-            {
-                max2830_freq = value;
-                fobos_max2830_set_frequency(dev, max2830_freq, &max2830_freq_actual);
-                rx_frequency = max2830_freq_actual;
-                result = FOBOS_ERR_OK;
-                break;
-            }
-            case FOBOS_INJECT_LOW:
-            {
-                max2830_freq = fobos_rx_bands[idx].if_freq_mhz * 1E6;
-                fobos_max2830_set_frequency(dev, max2830_freq, &max2830_freq_actual);
-                RFFC5071_freq = (uint64_t)max2830_freq_actual + (uint64_t)value;
-                fobos_rffc507x_set_lo_frequency_hz(dev, RFFC5071_freq, &RFFC5071_freq_hz_actual);
-                rx_frequency = RFFC5071_freq_hz_actual - max2830_freq_actual;
-                result = FOBOS_ERR_OK;
-                break;
-            }
-            case FOBOS_INJECT_HIGH:
-            {
-                max2830_freq = fobos_rx_bands[idx].if_freq_mhz * 1E6;
-                fobos_max2830_set_frequency(dev, max2830_freq, &max2830_freq_actual);
-                RFFC5071_freq = (uint64_t)value - (uint64_t)max2830_freq_actual;
-                fobos_rffc507x_set_lo_frequency_hz(dev, RFFC5071_freq, &RFFC5071_freq_hz_actual);
-                rx_frequency = RFFC5071_freq_hz_actual + max2830_freq_actual;
-                result = FOBOS_ERR_OK;
-                break;
-            }
+    double max2830_freq = 0.0;
+    double max2830_freq_actual = 0.0;
+    uint64_t RFFC5071_freq;
+    uint64_t RFFC5071_freq_hz_actual;
+    switch (fobos_rx_bands[idx].rffc507x_inject)
+    {
+        case FOBOS_INJECT_NONE:
+        {
+            max2830_freq = value;
+            max2830_freq_actual = fobos_max2830_calc(dev, max2830_freq, plan->max2830_regs);
+            plan->actual = max2830_freq_actual;
+            break;
         }
-        if (result == FOBOS_ERR_OK)
+        case FOBOS_INJECT_LOW:
         {
-            dev->rx_frequency = rx_frequency;
-            if (actual)
-            {
-                *actual = rx_frequency;
-            }
+            max2830_freq = fobos_rx_bands[idx].if_freq_mhz * 1E6;
+            max2830_freq_actual = fobos_max2830_calc(dev, max2830_freq, plan->max2830_regs);
+            RFFC5071_freq = (uint64_t)max2830_freq_actual + (uint64_t)value;
+            RFFC5071_freq_hz_actual = fobos_rffc507x_calc(dev, RFFC5071_freq, plan->rffc507x_regs, plan->rffc507x_masks);
+            plan->actual = RFFC5071_freq_hz_actual - max2830_freq_actual;
+            break;
+        }
+        case FOBOS_INJECT_HIGH:
+        {
+            max2830_freq = fobos_rx_bands[idx].if_freq_mhz * 1E6;
+            max2830_freq_actual = fobos_max2830_calc(dev, max2830_freq, plan->max2830_regs);
+            RFFC5071_freq = (uint64_t)value - (uint64_t)max2830_freq_actual;
+            RFFC5071_freq_hz_actual = fobos_rffc507x_calc(dev, RFFC5071_freq, plan->rffc507x_regs, plan->rffc507x_masks);
+            plan->actual = RFFC5071_freq_hz_actual + max2830_freq_actual;
+            break;
+        }
+    }
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+// a plan writes only the band switch bits and the pll fields, its band
+// settings are the ones of its band and its max2830 registers are in range
+static int fobos_rx_plan_fields_ok(const struct fobos_rx_tune_plan_t * plan)
+{
+    uint32_t count = (uint32_t)(sizeof(fobos_rx_bands) / sizeof(fobos_rx_bands[0]));
+    if ((plan->band >= count) ||
+        (plan->swap_iq != fobos_rx_bands[plan->band].swap_iq) ||
+        (plan->rffc507x_enabled != fobos_rx_bands[plan->band].rffc507x_enabled) ||
+        (plan->gpo_mask & ~FOBOS_PLAN_GPO_MASK) ||
+        ((plan->gpo_value ^ fobos_rx_band_gpo(plan->band)) & plan->gpo_mask))
+    {
+        return 0;
+    }
+    // reference divider 1 or 2, the 14 bit divider fields
+    if (((plan->max2830_regs[0] != 0x00A0) && (plan->max2830_regs[0] != 0x00A4)) ||
+        (plan->max2830_regs[1] & ~0x3FFF) || (plan->max2830_regs[2] & ~0x3FFF))
+    {
+        return 0;
+    }
+    for (int k = 0; k < FOBOS_RFFC507X_PLL_REGS; k++)
+    {
+        if (plan->rffc507x_masks[k] & ~fobos_rffc507x_pll_masks[k])
+        {
+            return 0;
         }
     }
+    return 1;
+}
+//==============================================================================
+// a plan is loaded only as fobos_rx_make_plans() makes it for its frequency
+// and the reference clocks of the device, a foreign or corrupt one is not
+static int fobos_rx_plan_check(struct fobos_dev_t * dev, const struct fobos_rx_tune_plan_t * plan)
+{
+    struct fobos_rx_tune_plan_t ref;
+    if (fobos_rx_plan_compute(dev, plan->frequency, &ref) != FOBOS_ERR_OK)
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    if ((plan->actual != ref.actual) ||
+        (plan->max2830_clock != ref.max2830_clock) ||
+        (plan->rffc507x_clock != ref.rffc507x_clock) ||
+        (plan->band != ref.band) ||
+        (plan->swap_iq != ref.swap_iq) ||
+        (plan->rffc507x_enabled != ref.rffc507x_enabled) ||
+        (plan->gpo_value != ref.gpo_value) ||
+        (plan->gpo_mask != ref.gpo_mask) ||
+        memcmp(plan->max2830_regs, ref.max2830_regs, sizeof(ref.max2830_regs)) ||
+        memcmp(plan->rffc507x_regs, ref.rffc507x_regs, sizeof(ref.rffc507x_regs)) ||
+        memcmp(plan->rffc507x_masks, ref.rffc507x_masks, sizeof(ref.rffc507x_masks)))
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+// the band switch is written only when the band changes, the lo is enabled by every injecting plan
+static int fobos_rx_plan_load(struct fobos_dev_t * dev, const struct fobos_rx_tune_plan_t * plan)
+{
+    int result = fobos_rx_plan_check(dev, plan);
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    int own = !fobos_atomic_load(&dev->cfg_txn);
+    int defer = dev->cfg_defer;
+    fobos_atomic_store(&dev->cfg_txn, 1);
+    dev->cfg_defer = 1;
+    if (dev->rx_frequency_band != plan->band)
+    {
+        uint16_t gpo_mask = plan->gpo_mask & FOBOS_PLAN_GPO_MASK;
+        dev->dev_gpo = (dev->dev_gpo & ~gpo_mask) | (plan->gpo_value & gpo_mask);
+        fobos_rx_set_dev_gpo(dev, dev->dev_gpo);
+        fobos_rffc507x_clock(dev, plan->rffc507x_enabled);
+        fobos_rffc507x_register_modify(&dev->rffc507x_registers_local[0x15], 14, 14, plan->rffc507x_enabled);
+    }
+    fobos_max2830_write_reg(dev, 5, plan->max2830_regs[0]);
+    fobos_max2830_write_reg(dev, 3, plan->max2830_regs[1]);
+    fobos_max2830_write_reg(dev, 4, plan->max2830_regs[2]);
+    if (fobos_rx_bands[plan->band].rffc507x_inject != FOBOS_INJECT_NONE)
+    {
+        fobos_rffc507x_pll_load(dev, plan->rffc507x_regs, plan->rffc507x_masks);
+        fobos_rffc507x_register_modify(&dev->rffc507x_registers_local[0x15], 14, 14, 1); // enbl = 1
+    }
+    if (own)
+    {
+        result = fobos_rx_apply_commit_config(dev);
+    }
+    else
+    {
+        dev->cfg_defer = defer;
+    }
+    if (result != FOBOS_ERR_OK)
+    {
+        // the band switch state is not known, the next load writes it again
+        dev->rx_frequency_band = 0xFFFFFFFF;
+        return result;
+    }
+    dev->rx_frequency_band = plan->band;
+    dev->rx_swap_iq = plan->swap_iq;
+    fobos_rx_cvt_select(dev);
+    dev->rx_frequency = plan->actual;
+    dev->rx_frequency_req = plan->frequency;
     return result;
 }
 //==============================================================================
-int fobos_rx_set_direct_sampling(struct fobos_dev_t * dev, unsigned int enabled)
+static int fobos_rx_apply_frequency(struct fobos_dev_t * dev, double value, double * actual)
 {
-#ifdef FOBOS_PRINT_DEBUG
-    printf_internal("%s(%d);\n", __FUNCTION__, enabled);
-#endif // FOBOS_PRINT_DEBUG
     int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%f);\n", __FUNCTION__, value);
+#endif // FOBOS_PRINT_DEBUG    
     if (result != FOBOS_ERR_OK)
     {
         return result;
     }
-    if (dev->rx_direct_sampling != enabled)
+    if (dev->rx_frequency != value)
     {
-        if (enabled)
+        struct fobos_rx_tune_plan_t plan;
+        result = fobos_rx_plan_compute(dev, value, &plan);
+        if (result == FOBOS_ERR_OK)
         {
-            if (dev->hw_revision[0] == '2')
+            result = fobos_rx_plan_load(dev, &plan);
+            if (actual)
             {
-                bitset(dev->dev_gpo, FOBOS_DEV_LPF_A0);
-                bitset(dev->dev_gpo, FOBOS_DEV_LPF_A1);
+                *actual = dev->rx_frequency;
             }
-            else
+        }
+    }
+    return result;
+}
+//==============================================================================
+static int fobos_rx_apply_tune_plan(struct fobos_dev_t * dev, const struct fobos_rx_tune_plan_t * plan, double * actual)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%f);\n", __FUNCTION__, plan->frequency);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    result = fobos_rx_plan_load(dev, plan);
+    if (actual)
+    {
+        *actual = dev->rx_frequency;
+    }
+    return result;
+}
+//==============================================================================
+static int fobos_rx_apply_direct_sampling(struct fobos_dev_t * dev, unsigned int enabled)
+{
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%d);\n", __FUNCTION__, enabled);
+#endif // FOBOS_PRINT_DEBUG
+    int result = fobos_check(dev);
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (dev->rx_direct_sampling != enabled)
+    {
+        if (enabled)
+        {
+            if (dev->hw_revision[0] == '2')
+            {
+                bitset(dev->dev_gpo, FOBOS_DEV_LPF_A0);
+                bitset(dev->dev_gpo, FOBOS_DEV_LPF_A1);
+            }
+            else
             {
                 bitclear(dev->dev_gpo, FOBOS_DEV_LPF_A0);
                 bitclear(dev->dev_gpo, FOBOS_DEV_LPF_A1);
@@ -1351,11 +2529,12 @@ int fobos_rx_set_direct_sampling(struct fobos_dev_t * dev, unsigned int enabled)
             fobos_rffc507x_commit(dev, 0);
         }
         dev->rx_direct_sampling = enabled;
+        fobos_rx_cvt_select(dev);
     }
     return result;
 }
 //==============================================================================
-int fobos_rx_set_lna_gain(struct fobos_dev_t * dev, unsigned int value)
+static int fobos_rx_apply_lna_gain(struct fobos_dev_t * dev, unsigned int value)
 {
 #ifdef FOBOS_PRINT_DEBUG
     printf_internal("%s(%d)\n", __FUNCTION__, value);
@@ -1376,7 +2555,7 @@ int fobos_rx_set_lna_gain(struct fobos_dev_t * dev, unsigned int value)
     return result;
 }
 //==============================================================================
-int fobos_rx_set_vga_gain(struct fobos_dev_t * dev, unsigned int value)
+static int fobos_rx_apply_vga_gain(struct fobos_dev_t * dev, unsigned int value)
 {
 #ifdef FOBOS_PRINT_DEBUG
     printf_internal("%s(%d)\n", __FUNCTION__, value);
@@ -1398,7 +2577,7 @@ int fobos_rx_set_vga_gain(struct fobos_dev_t * dev, unsigned int value)
     return result;
 }
 //==============================================================================
-int fobos_rx_set_lpf(struct fobos_dev_t * dev, double bandwidth)
+static int fobos_rx_apply_lpf(struct fobos_dev_t * dev, double bandwidth)
 {
     int result = fobos_check(dev);
 #ifdef FOBOS_PRINT_DEBUG
@@ -1458,7 +2637,21 @@ const double fobos_max2830_adj[] =
     0.90, 0.95, 1.00, 1.05, 1.10
 };
 //==============================================================================
-int fobos_rx_set_bandwidth(struct fobos_dev_t * dev, double value, double * actual)
+static void fobos_max2830_set_bw(struct fobos_dev_t * dev, uint32_t idx, uint32_t adj)
+{
+    if (dev->rx_bw_idx != idx)
+    {
+        dev->rx_bw_idx = idx;
+        fobos_max2830_write_reg(dev, 8, (uint16_t)(idx | 0x3020));
+    }
+    if (dev->rx_bw_adj != adj)
+    {
+        dev->rx_bw_adj = adj;
+        fobos_max2830_write_reg(dev, 7, (uint16_t)(adj | 0x1020));
+    }
+}
+//==============================================================================
+static int fobos_rx_apply_bandwidth(struct fobos_dev_t * dev, double value, double * actual)
 {
     int result = fobos_check(dev);
 #ifdef FOBOS_PRINT_DEBUG
@@ -1499,16 +2692,7 @@ int fobos_rx_set_bandwidth(struct fobos_dev_t * dev, double value, double * actu
     {
         *actual = fobos_max2830_bws[idx] * fobos_max2830_adj[adj];
     }
-    if (dev->rx_bw_idx != idx)
-    {
-        dev->rx_bw_idx = idx;
-        fobos_max2830_write_reg(dev, 8, (uint16_t)(idx | 0x3020)); 
-    }
-    if (dev->rx_bw_adj != adj)
-    {
-        dev->rx_bw_adj = adj;
-        fobos_max2830_write_reg(dev, 7, (uint16_t)(adj | 0x1020));
-    }
+    fobos_max2830_set_bw(dev, idx, adj);
     //printf("idx = %d, adj = %d\n", idx, adj);
     return result;
 }
@@ -1552,7 +2736,7 @@ const uint32_t fobos_p1s[] =
     16, 20, 25, 32, 40, 50, 64, 80, 100
 };
 //==============================================================================
-int fobos_rx_set_samplerate(struct fobos_dev_t * dev, double value, double * actual)
+static int fobos_rx_apply_samplerate(struct fobos_dev_t * dev, double value, double * actual)
 {
     int result = fobos_check(dev);
 #ifdef FOBOS_PRINT_DEBUG
@@ -1583,8 +2767,8 @@ int fobos_rx_set_samplerate(struct fobos_dev_t * dev, double value, double * act
     if (result == 0)
     {
         double bandwidth = value * 0.8;
-        fobos_rx_set_lpf(dev, bandwidth);
-        fobos_rx_set_bandwidth(dev, bandwidth, 0);
+        fobos_rx_apply_lpf(dev, bandwidth);
+        fobos_rx_apply_bandwidth(dev, bandwidth, 0);
         dev->rx_samplerate = value;
         if (actual)
         {
@@ -1594,7 +2778,7 @@ int fobos_rx_set_samplerate(struct fobos_dev_t * dev, double value, double * act
     return result;
 }
 //==============================================================================
-int fobos_rx_set_clk_source(struct fobos_dev_t * dev, int value)
+static int fobos_rx_apply_clk_source(struct fobos_dev_t * dev, int value)
 {
     int result = fobos_check(dev);
 #ifdef FOBOS_PRINT_DEBUG
@@ -1616,494 +2800,5230 @@ int fobos_rx_set_clk_source(struct fobos_dev_t * dev, int value)
     return result;
 }
 //==============================================================================
-void fobos_rx_calibrate(struct fobos_dev_t * dev, void * data, size_t size)
+static int fobos_rx_apply_dc_mode(struct fobos_dev_t * dev, int mode)
 {
-    size_t complex_samples_count = size / 4;
-    int16_t * psample = (int16_t *)data;
-    int64_t summ_re = 0ll;
-    int64_t summ_im = 0ll;
-    size_t chunks_count = complex_samples_count / 4;
-    for (size_t i = 0; i < chunks_count; i++)
-    {
-        summ_re += psample[0];
-        summ_im += psample[1];
-        summ_re += psample[2];
-        summ_im += psample[3];
-        summ_re += psample[4];
-        summ_im += psample[5];
-        summ_re += psample[6];
-        summ_im += psample[7];
-        psample += 8;
-    }
-    summ_re /= complex_samples_count;
-    summ_im /= complex_samples_count;
-    int16_t avg_re = (int16_t)summ_re;
-    int16_t avg_im = (int16_t)summ_im;
-    psample = (int16_t *)data;
-    for (size_t i = 0; i < chunks_count; i++)
-    {
-        summ_re += abs(psample[0] - avg_re);
-        summ_im += abs(psample[1] - avg_im);
-        summ_re += abs(psample[2] - avg_re);
-        summ_im += abs(psample[3] - avg_im);
-        summ_re += abs(psample[4] - avg_re);
-        summ_im += abs(psample[5] - avg_im);
-        summ_re += abs(psample[6] - avg_re);
-        summ_im += abs(psample[7] - avg_im);
-        psample += 8;
-    }
-    dev->rx_avg_re += 0.001f* ((float)summ_re - dev->rx_avg_re);
-    dev->rx_avg_im += 0.001f* ((float)summ_im - dev->rx_avg_im);
-    if ((dev->rx_avg_re > 0.0f) && (dev->rx_avg_im > 0.0f) && !dev->rx_direct_sampling)
-    {
-        float ratio = dev->rx_avg_re / dev->rx_avg_im;
+    int result = fobos_check(dev);
 #ifdef FOBOS_PRINT_DEBUG
-        if (dev->rx_buff_counter % 128 == 0)
-        {
-            printf_internal("re/im scale = %f\n", ratio);
-        }
+    printf_internal("%s(%d)\n", __FUNCTION__, mode);
 #endif // FOBOS_PRINT_DEBUG
-        if ((ratio < 1.6f) && (ratio > 0.625f))
-        {
-            dev->rx_scale_im = dev->rx_scale_re * ratio;
-        }
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
     }
+    dev->rx_dc_mode = mode;
+    fobos_rx_cvt_select(dev);
+    return result;
 }
 //==============================================================================
-#define FOBOS_SWAP_IQ_HW 1
-void fobos_rx_convert_samples(struct fobos_dev_t * dev, void * data, size_t size, float * dst_samples)
+// Control command queue
+// The libusb control transfers cannot be issued from the stream callbacks and
+// neither the tuning state nor the converter is to be touched by two threads
+// at once, so while a stream is up (starting, running, paused, recovering or
+// ending) every setter writing the device registers or selecting the converter
+// is queued. A change made while the device is recovering is applied once it
+// is back, after the replay of the configuration, the setter returns
+// FOBOS_ERR_PENDING without waiting for it. The queue is a bounded lock-free multi producer ring, the thread
+// handling the stream events applies it in order between the event handling
+// passes, that is between buffers. A control thread posts, interrupts the
+// event handling and waits for its result, a stream callback posts and returns
+// FOBOS_ERR_PENDING, its change is applied right after the callback. The converter settings are
+// stamped on every buffer as it completes, so the buffers still waiting in the
+// processing queue are converted with the settings they were captured with.
+// The first buffer captured entirely after a change (one transfer length past
+// the sample index the usb side has reached) is flagged FOBOS_META_CONFIG and
+// its metadata carries the new settings and configuration id.
+//==============================================================================
+#define FOBOS_CMD_FREQUENCY         1
+#define FOBOS_CMD_DIRECT_SAMPLING   2
+#define FOBOS_CMD_LNA_GAIN          3
+#define FOBOS_CMD_VGA_GAIN          4
+#define FOBOS_CMD_SAMPLERATE        5
+#define FOBOS_CMD_CLK_SOURCE        6
+#define FOBOS_CMD_BEGIN_CONFIG      7
+#define FOBOS_CMD_COMMIT_CONFIG     8
+#define FOBOS_CMD_TUNE_PLAN         9
+#define FOBOS_CMD_BANDWIDTH         10
+#define FOBOS_CMD_LPF               11
+#define FOBOS_CMD_USER_GPO          12
+#define FOBOS_CMD_DC_MODE           13
+//==============================================================================
+static void fobos_rx_cfg_mark(struct fobos_dev_t * dev, int code)
 {
-    size_t complex_samples_count = size / 4;
-    size_t chunks_count = complex_samples_count / 4;
-    int16_t * src = (int16_t *)data;
-    float * dst = dst_samples;
-    int rx_swap_iq = dev->rx_swap_iq ^ FOBOS_SWAP_IQ_HW;
-    float re = 0.0f;
-    float im = 0.0f;
-    float scale_re = 1.0f / 32768.0f;
-    float scale_im = 1.0f / 32768.0f;
-    if (dev->rx_direct_sampling)
-    {
-        rx_swap_iq = FOBOS_SWAP_IQ_HW;
+    dev->cfg_id++;
+    dev->cfg_pending = 1;
+    dev->cfg_index = dev->meta_index + dev->transfer_buf_size / 4;
+    fobos_stat_add(&dev->rx_stats.config_changes, 1);
+    if (code == FOBOS_CMD_SAMPLERATE)
+    {
+        // the completion timing restarts from the new rate
+        dev->meta_count = 0;
+        dev->meta_win_count = 0;
     }
-    else
-    {
-        fobos_rx_calibrate(dev, data, size / 16);
-        scale_re = dev->rx_scale_re;
-        scale_im = dev->rx_scale_im;
+}
+//==============================================================================
+static int fobos_rx_cmd_apply(struct fobos_dev_t * dev, int code, double value, const struct fobos_rx_tune_plan_t * plan, double * actual)
+{
+    int result = FOBOS_ERR_UNSUPPORTED;
+    dev->cfg_defer = fobos_atomic_load(&dev->cfg_txn);
+    switch (code)
+    {
+    case FOBOS_CMD_FREQUENCY:
+        result = fobos_rx_apply_frequency(dev, value, actual);
+        break;
+    case FOBOS_CMD_DIRECT_SAMPLING:
+        result = fobos_rx_apply_direct_sampling(dev, (unsigned int)value);
+        break;
+    case FOBOS_CMD_LNA_GAIN:
+        result = fobos_rx_apply_lna_gain(dev, (unsigned int)value);
+        break;
+    case FOBOS_CMD_VGA_GAIN:
+        result = fobos_rx_apply_vga_gain(dev, (unsigned int)value);
+        break;
+    case FOBOS_CMD_SAMPLERATE:
+        result = fobos_rx_apply_samplerate(dev, value, actual);
+        break;
+    case FOBOS_CMD_CLK_SOURCE:
+        result = fobos_rx_apply_clk_source(dev, (int)value);
+        break;
+    case FOBOS_CMD_TUNE_PLAN:
+        result = fobos_rx_apply_tune_plan(dev, plan, actual);
+        break;
+    case FOBOS_CMD_BANDWIDTH:
+        result = fobos_rx_apply_bandwidth(dev, value, actual);
+        break;
+    case FOBOS_CMD_LPF:
+        result = fobos_rx_apply_lpf(dev, value);
+        break;
+    case FOBOS_CMD_USER_GPO:
+        result = fobos_rx_apply_user_gpo(dev, (uint8_t)value);
+        break;
+    case FOBOS_CMD_DC_MODE:
+        result = fobos_rx_apply_dc_mode(dev, (int)value);
+        break;
+    case FOBOS_CMD_BEGIN_CONFIG:
+        result = fobos_rx_apply_begin_config(dev);
+        break;
+    case FOBOS_CMD_COMMIT_CONFIG:
+    {
+        uint32_t codes = dev->cfg_txn_codes;
+        dev->cfg_txn_codes = 0;
+        result = fobos_rx_apply_commit_config(dev);
+        // the changes of the transaction are reported once committed
+        code = (codes & (1u << FOBOS_CMD_SAMPLERATE)) ? FOBOS_CMD_SAMPLERATE : code;
+        if (!codes)
+        {
+            return result;
+        }
+        break;
     }
-#ifdef FOBOS_PRINT_DEBUG
-    if (dev->rx_buff_counter % 256 == 0)
+    }
+    dev->cfg_defer = 0;
+    // the replay of the recovery is not a change
+    if ((result != FOBOS_ERR_OK) || (FOBOS_RECOVERING == fobos_rx_status(dev)) || (code == FOBOS_CMD_BEGIN_CONFIG))
     {
-        print_buff(data, 64);
+        return result;
     }
-#endif // FOBOS_PRINT_DEBUG
-    float k = 0.0004f; // ~ play around
-    float dc_re = dev->rx_dc_re;
-    float dc_im = dev->rx_dc_im;
-    if (rx_swap_iq)
-    {
-        for (size_t i = 0; i < chunks_count; i++)
-        {
-            // 0
-            re = (float)(src[1] & 0x3FFF);
-            im = (float)(src[0] & 0x3FFF);
-            dc_re += k * (re - dc_re);
-            dc_im += k * (im - dc_im);
-            dst[0] = (re - dc_re) * scale_re;
-            dst[1] = (im - dc_im) * scale_im;
-            // 1
-            re = (float)(src[3] & 0x3FFF);
-            im = (float)(src[2] & 0x3FFF);
-            dc_re += k * (re - dc_re);
-            dc_im += k * (im - dc_im);
-            dst[2] = (re - dc_re) * scale_re;
-            dst[3] = (im - dc_im) * scale_im;
-            // 2
-            re = (float)(src[5] & 0x3FFF);
-            im = (float)(src[4] & 0x3FFF);
-            dc_re += k * (re - dc_re);
-            dc_im += k * (im - dc_im);
-            dst[4] = (re - dc_re) * scale_re;
-            dst[5] = (im - dc_im) * scale_im;
-            // 3
-            re = (float)(src[7] & 0x3FFF);
-            im = (float)(src[6] & 0x3FFF);
-            dc_re += k * (re - dc_re);
-            dc_im += k * (im - dc_im);
-            dst[6] = (re - dc_re) * scale_re;
-            dst[7] = (im - dc_im) * scale_im;
-            //
-            src += 8;
-            dst += 8;
-        }
+    if (fobos_atomic_load(&dev->cfg_txn))
+    {
+        dev->cfg_txn_codes |= 1u << code;
     }
     else
     {
-        for (size_t i = 0; i < chunks_count; i++)
-        {
-            // 0
-            re = (float)(src[0] & 0x3FFF);
-            im = (float)(src[1] & 0x3FFF);
-            dc_re += k * (re - dc_re);
-            dc_im += k * (im - dc_im);
-            dst[0] = (re - dc_re) * scale_re;
-            dst[1] = (im - dc_im) * scale_im;
-            // 1
-            re = (float)(src[2] & 0x3FFF);
-            im = (float)(src[3] & 0x3FFF);
-            dc_re += k * (re - dc_re);
-            dc_im += k * (im - dc_im);
-            dst[2] = (re - dc_re) * scale_re;
-            dst[3] = (im - dc_im) * scale_im;
-            // 2
-            re = (float)(src[4] & 0x3FFF);
-            im = (float)(src[5] & 0x3FFF);
-            dc_re += k * (re - dc_re);
-            dc_im += k * (im - dc_im);
-            dst[4] = (re - dc_re) * scale_re;
-            dst[5] = (im - dc_im) * scale_im;
-            // 3
-            re = (float)(src[6] & 0x3FFF);
-            im = (float)(src[7] & 0x3FFF);
-            dc_re += k * (re - dc_re);
-            dc_im += k * (im - dc_im);
-            dst[6] = (re - dc_re) * scale_re;
-            dst[7] = (im - dc_im) * scale_im;
-            //
-            src += 8;
-            dst += 8;
-        }
+        fobos_rx_cfg_mark(dev, code);
     }
-    dev->rx_dc_re = dc_re;
-    dev->rx_dc_im = dc_im;
+    return result;
 }
 //==============================================================================
-int fobos_alloc_buffers(struct fobos_dev_t *dev)
+// claims a free slot, ids start from 1
+static int fobos_rx_cmd_post(struct fobos_dev_t * dev, int code, double value, const struct fobos_rx_tune_plan_t * plan, uint32_t * id)
 {
-    int result = fobos_check(dev);
-    if (result != FOBOS_ERR_OK)
-    {
-        return result;
-    }
-    if (!dev->transfer)
+    while (1)
     {
-        dev->transfer = (struct libusb_transfer **)malloc(dev->transfer_buf_count * sizeof(struct libusb_transfer *));
-        if (dev->transfer)
+        uint32_t pos = (uint32_t)fobos_atomic_load(&dev->cmd_head);
+        struct fobos_cmd_t * cmd = &dev->cmd_slots[pos & (FOBOS_CMD_QUEUE_LEN - 1)];
+        int32_t diff = (int32_t)((uint32_t)fobos_atomic_load(&cmd->seq) - pos);
+        if (diff < 0)
         {
-            for (size_t i = 0; i < dev->transfer_buf_count; i++)
+            return FOBOS_ERR_NO_MEM;
+        }
+        if ((diff == 0) && fobos_atomic_cas(&dev->cmd_head, (int32_t)pos, (int32_t)(pos + 1)))
+        {
+            cmd->code = code;
+            cmd->value = value;
+            if (plan)
             {
-                dev->transfer[i] = libusb_alloc_transfer(0);
+                cmd->plan = *plan;
             }
+            fobos_atomic_store(&cmd->seq, (int32_t)(pos + 1));
+            *id = pos + 1;
+            return FOBOS_ERR_OK;
         }
     }
-    if (dev->transfer_buf)
-    {
-        return FOBOS_ERR_NO_MEM;
-    }
-    dev->transfer_buf = (unsigned char **)malloc(dev->transfer_buf_count * sizeof(unsigned char *));
-    if (dev->transfer_buf)
+}
+//==============================================================================
+// applies the queued commands, one thread at a time
+static void fobos_rx_cmd_drain(struct fobos_dev_t * dev)
+{
+    if (!fobos_atomic_cas(&dev->cmd_draining, 0, 1))
     {
-        memset(dev->transfer_buf, 0, dev->transfer_buf_count * sizeof(unsigned char*));
+        return;
     }
-#if defined(ENABLE_ZEROCOPY) && defined (__linux__) && LIBUSB_API_VERSION >= 0x01000105
-    printf_internal("Allocating %d zero-copy buffers\n", dev->transfer_buf_count);
-    dev->use_zerocopy = 1;
-    for (size_t i = 0; i < dev->transfer_buf_count; ++i)
+    int applied = 0;
+    while (1)
     {
-        dev->transfer_buf[i] = libusb_dev_mem_alloc(dev->libusb_devh, dev->transfer_buf_size);
-        if (dev->transfer_buf[i])
-        {
-            if (dev->transfer_buf[i][0] || memcmp(dev->transfer_buf[i],
-                dev->transfer_buf[i] + 1,
-                dev->transfer_buf_size - 1))
-            {
-                printf_internal("Kernel usbfs mmap() bug, falling back to buffers\n");
-                dev->use_zerocopy = 0;
-                break;
-            }
-        }
-        else
+        uint32_t pos = dev->cmd_tail;
+        uint32_t idx = pos & (FOBOS_CMD_QUEUE_LEN - 1);
+        struct fobos_cmd_t * cmd = &dev->cmd_slots[idx];
+        if ((uint32_t)fobos_atomic_load(&cmd->seq) != pos + 1)
         {
-            printf_internal("Failed to allocate zero-copy buffer for transfer %d\n", i);
-            dev->use_zerocopy = 0;
             break;
         }
+        double actual = cmd->value;
+        dev->cmd_result[idx] = fobos_rx_cmd_apply(dev, cmd->code, cmd->value, &cmd->plan, &actual);
+        dev->cmd_actual[idx] = actual;
+        dev->cmd_tail = pos + 1;
+        fobos_atomic_store(&cmd->seq, (int32_t)(pos + FOBOS_CMD_QUEUE_LEN));
+        fobos_atomic_store(&dev->cmd_applied, (int32_t)(pos + 1));
+        applied = 1;
     }
-    if (!dev->use_zerocopy)
+    fobos_atomic_store(&dev->cmd_draining, 0);
+    if (applied)
     {
-        for (size_t i = 0; i < dev->transfer_buf_count; ++i)
-        {
-            if (dev->transfer_buf[i])
-            {
-                libusb_dev_mem_free(dev->libusb_devh, dev->transfer_buf[i], dev->transfer_buf_size);
-            }
-        }
+        fobos_mutex_lock(&dev->state_lock);
+        fobos_cond_broadcast(&dev->state_cond);
+        fobos_mutex_unlock(&dev->state_lock);
     }
-#endif
-    if (!dev->use_zerocopy)
+}
+//==============================================================================
+// the streaming thread is about to handle the events, the callbacks may run
+static void fobos_rx_cmd_enter(struct fobos_dev_t * dev)
+{
+    if (!fobos_atomic_load(&dev->cmd_tid_valid))
     {
-        for (size_t i = 0; i < dev->transfer_buf_count; ++i)
-        {
-            dev->transfer_buf[i] = (unsigned char *)malloc(dev->transfer_buf_size);
-
-            if (!dev->transfer_buf[i])
-            {
-                return FOBOS_ERR_NO_MEM;
-            }
-        }
+        dev->cmd_tid = fobos_thread_self();
+        fobos_atomic_store(&dev->cmd_tid_valid, 1);
     }
-    return FOBOS_ERR_OK;
+    dev->cmd_in_events = 1;
 }
 //==============================================================================
-int fobos_free_buffers(struct fobos_dev_t *dev)
+// between the event handling passes: apply the queued changes, the session
+// thread retunes the hops itself once it has released the session lock
+static void fobos_rx_cmd_leave(struct fobos_dev_t * dev, int retune)
 {
-    int result = fobos_check(dev);
-    if (result != 0)
+    dev->cmd_in_events = 0;
+    fobos_rx_cmd_drain(dev);
+    if (retune && dev->hop_closed)
     {
-        return result;
+        fobos_rx_hop_retune(dev);
     }
-    if (dev->transfer)
-    {
-        for (size_t i = 0; i < dev->transfer_buf_count; ++i)
+}
+//==============================================================================
+// posts from a thread other than the streaming one and waits for the result
+static int fobos_rx_cmd_call(struct fobos_dev_t * dev, int code, double value, const struct fobos_rx_tune_plan_t * plan, double * actual)
+{
+    uint32_t id = 0;
+    uint64_t deadline = fobos_time_ns() + FOBOS_CMD_TIMEOUT_MS * 1000000ull;
+    int result = fobos_rx_cmd_post(dev, code, value, plan, &id);
+    while (result == FOBOS_ERR_NO_MEM)
+    {
+        // full, let the streaming thread catch up
+        fobos_mutex_lock(&dev->state_lock);
+        fobos_cond_timedwait(&dev->state_cond, &dev->state_lock, 10);
+        fobos_mutex_unlock(&dev->state_lock);
+        if (fobos_time_ns() > deadline)
         {
-            if (dev->transfer[i])
-            {
-                libusb_free_transfer(dev->transfer[i]);
-            }
+            return FOBOS_ERR_TIMEOUT;
         }
-        free(dev->transfer);
-        dev->transfer = NULL;
+        result = fobos_rx_cmd_post(dev, code, value, plan, &id);
     }
-    if (dev->transfer_buf)
+#if LIBUSB_API_VERSION >= 0x01000105
+    libusb_interrupt_event_handler(dev->libusb_ctx);
+#endif
+    fobos_mutex_lock(&dev->state_lock);
+    while ((int32_t)((uint32_t)fobos_atomic_load(&dev->cmd_applied) - id) < 0)
     {
-        for (size_t i = 0; i < dev->transfer_buf_count; ++i)
+        enum fobos_async_status status = fobos_rx_status(dev);
+        if (FOBOS_RECOVERING == status)
         {
-            if (dev->transfer_buf[i])
-            {
-                if (dev->use_zerocopy)
-                {
-#if defined (__linux__) && LIBUSB_API_VERSION >= 0x01000105
-                    libusb_dev_mem_free(dev->libusb_devh, dev->transfer_buf[i], dev->transfer_buf_size);
-#endif
-                }
-                else
-                {
-                    free(dev->transfer_buf[i]);
-                }
-            }
+            // applied once the device is back
+            fobos_mutex_unlock(&dev->state_lock);
+            return FOBOS_ERR_PENDING;
         }
-        free(dev->transfer_buf);
-        dev->transfer_buf = NULL;
-    }
-    return FOBOS_ERR_OK;
-}
-//==============================================================================
-static void LIBUSB_CALL _libusb_callback(struct libusb_transfer *transfer)
-{
-    struct fobos_dev_t *dev = (struct fobos_dev_t *)transfer->user_data;
-    if (LIBUSB_TRANSFER_COMPLETED == transfer->status)
-    {
-        if (transfer->actual_length == (int)dev->transfer_buf_size)
+        if (FOBOS_IDDLE == status)
         {
-            //printf_internal(".");
-            dev->rx_buff_counter++;
-            fobos_rx_convert_samples(dev, transfer->buffer, transfer->actual_length, dev->rx_buff);
-            uint32_t complex_samples_count = transfer->actual_length / 4;
-            if (dev->rx_cb)
+            // the stream has ended meanwhile, nobody else drains
+            fobos_mutex_unlock(&dev->state_lock);
+            fobos_rx_cmd_drain(dev);
+            fobos_mutex_lock(&dev->state_lock);
+            if ((int32_t)((uint32_t)fobos_atomic_load(&dev->cmd_applied) - id) >= 0)
             {
-                dev->rx_cb(dev->rx_buff, complex_samples_count, dev->rx_cb_ctx);
+                break;
             }
         }
-        else
-        {
-            printf_internal("E");
-            dev->rx_failures++;
-        }
-        libusb_submit_transfer(transfer);
-        dev->transfer_errors = 0;
-    }
-    else if (LIBUSB_TRANSFER_CANCELLED != transfer->status)
-    {
-        printf_internal("transfer->status = %d\n", transfer->status);
-#ifndef _WIN32
-        if (LIBUSB_TRANSFER_ERROR == transfer->status)
-        {
-            dev->transfer_errors++;
-        }
-        if (dev->transfer_errors >= (int)dev->transfer_buf_count || LIBUSB_TRANSFER_NO_DEVICE == transfer->status)
+        fobos_cond_timedwait(&dev->state_cond, &dev->state_lock, 10);
+        if (fobos_time_ns() > deadline)
         {
-            dev->dev_lost = 1;
-            fobos_rx_cancel_async(dev);
+            fobos_mutex_unlock(&dev->state_lock);
+            return FOBOS_ERR_TIMEOUT;
         }
-#else
-        dev->dev_lost = 1;
-        fobos_rx_cancel_async(dev);
-#endif
     }
+    fobos_mutex_unlock(&dev->state_lock);
+    uint32_t idx = (id - 1) & (FOBOS_CMD_QUEUE_LEN - 1);
+    *actual = dev->cmd_actual[idx];
+    return dev->cmd_result[idx];
 }
 //==============================================================================
-int fobos_rx_read_async(struct fobos_dev_t * dev, fobos_rx_cb_t cb, void *ctx, uint32_t buf_count, uint32_t buf_length)
+// applies right away when not streaming or on the streaming thread between
+// buffers, queues otherwise
+static int fobos_rx_cmd_route(struct fobos_dev_t * dev, int code, double value, const struct fobos_rx_tune_plan_t * plan, double * actual)
 {
     int result = fobos_check(dev);
-#ifdef FOBOS_PRINT_DEBUG
-    printf_internal("%s(%p, %p, %p, %d, %d)\n", __FUNCTION__, (void*)dev, (void*)cb, (void*)ctx, buf_count, buf_length);
-#endif // FOBOS_PRINT_DEBUG
     if (result != FOBOS_ERR_OK)
     {
         return result;
     }
-    if (FOBOS_IDDLE != dev->rx_async_status)
+    double value_actual = value;
+    if (FOBOS_IDDLE == fobos_rx_status(dev))
     {
-        return FOBOS_ERR_ASYNC_IN_SYNC;
+        result = fobos_rx_cmd_apply(dev, code, value, plan, &value_actual);
     }
-    result = FOBOS_ERR_OK;
-    struct timeval tv0 = { 0, 0 };
-    struct timeval tv1 = { 1, 0 };
-    struct timeval tvx = { 0, 10000 };
-    dev->rx_async_status = FOBOS_STARTING;
-    dev->rx_async_cancel = 0;
-    dev->rx_buff_counter = 0;
-    dev->rx_cb = cb;
-    dev->rx_cb_ctx = ctx;
-    dev->rx_avg_re = 0.0f;
-    dev->rx_avg_im = 0.0f;
-    if (buf_count == 0)
+    else if (fobos_atomic_load(&dev->cmd_tid_valid) && fobos_thread_is_self(dev->cmd_tid))
     {
-        buf_count = FOBOS_DEF_BUF_COUNT;
+        if (dev->cmd_in_events)
+        {
+            // a stream callback, applied once it returns
+            uint32_t id = 0;
+            result = fobos_rx_cmd_post(dev, code, value, plan, &id);
+            result = (result == FOBOS_ERR_OK) ? FOBOS_ERR_PENDING : result;
+        }
+        else
+        {
+            result = fobos_rx_cmd_apply(dev, code, value, plan, &value_actual);
+        }
     }
-    if (buf_count > FOBOS_MAX_BUF_COUNT)
+    else
     {
-        buf_count = FOBOS_MAX_BUF_COUNT;
+        result = fobos_rx_cmd_call(dev, code, value, plan, &value_actual);
     }
-    dev->transfer_buf_count = buf_count;
-
+    // a pending change has no actual value yet
+    if (actual && (result == FOBOS_ERR_OK))
+    {
+        *actual = value_actual;
+    }
+    return result;
+}
+//==============================================================================
+int fobos_rx_set_frequency(struct fobos_dev_t * dev, double value, double * actual)
+{
+    return fobos_rx_cmd_route(dev, FOBOS_CMD_FREQUENCY, value, NULL, actual);
+}
+//==============================================================================
+int fobos_rx_set_direct_sampling(struct fobos_dev_t * dev, unsigned int enabled)
+{
+    return fobos_rx_cmd_route(dev, FOBOS_CMD_DIRECT_SAMPLING, enabled, NULL, NULL);
+}
+//==============================================================================
+int fobos_rx_set_lna_gain(struct fobos_dev_t * dev, unsigned int value)
+{
+    return fobos_rx_cmd_route(dev, FOBOS_CMD_LNA_GAIN, value, NULL, NULL);
+}
+//==============================================================================
+int fobos_rx_set_vga_gain(struct fobos_dev_t * dev, unsigned int value)
+{
+    return fobos_rx_cmd_route(dev, FOBOS_CMD_VGA_GAIN, value, NULL, NULL);
+}
+//==============================================================================
+int fobos_rx_set_samplerate(struct fobos_dev_t * dev, double value, double * actual)
+{
+    return fobos_rx_cmd_route(dev, FOBOS_CMD_SAMPLERATE, value, NULL, actual);
+}
+//==============================================================================
+int fobos_rx_set_clk_source(struct fobos_dev_t * dev, int value)
+{
+    return fobos_rx_cmd_route(dev, FOBOS_CMD_CLK_SOURCE, value, NULL, NULL);
+}
+//==============================================================================
+int fobos_rx_set_bandwidth(struct fobos_dev_t * dev, double value, double * actual)
+{
+    return fobos_rx_cmd_route(dev, FOBOS_CMD_BANDWIDTH, value, NULL, actual);
+}
+//==============================================================================
+int fobos_rx_set_lpf(struct fobos_dev_t * dev, double bandwidth)
+{
+    return fobos_rx_cmd_route(dev, FOBOS_CMD_LPF, bandwidth, NULL, NULL);
+}
+//==============================================================================
+int fobos_rx_set_user_gpo(struct fobos_dev_t * dev, uint8_t value)
+{
+    return fobos_rx_cmd_route(dev, FOBOS_CMD_USER_GPO, value, NULL, NULL);
+}
+//==============================================================================
+int fobos_rx_begin_config(struct fobos_dev_t * dev)
+{
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s()\n", __FUNCTION__);
+#endif // FOBOS_PRINT_DEBUG
+    return fobos_rx_cmd_route(dev, FOBOS_CMD_BEGIN_CONFIG, 0.0, NULL, NULL);
+}
+//==============================================================================
+int fobos_rx_commit_config(struct fobos_dev_t * dev)
+{
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s()\n", __FUNCTION__);
+#endif // FOBOS_PRINT_DEBUG
+    return fobos_rx_cmd_route(dev, FOBOS_CMD_COMMIT_CONFIG, 0.0, NULL, NULL);
+}
+//==============================================================================
+int fobos_rx_make_plans(struct fobos_dev_t * dev, const double * frequencies, unsigned int count, struct fobos_rx_tune_plan_t * plans)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%p, %d, %p)\n", __FUNCTION__, (void*)frequencies, count, (void*)plans);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if ((count > 0) && (!frequencies || !plans))
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    for (unsigned int i = 0; i < count; i++)
+    {
+        result = fobos_rx_plan_compute(dev, frequencies[i], &plans[i]);
+        if (result != FOBOS_ERR_OK)
+        {
+            return result;
+        }
+    }
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+int fobos_rx_apply_plan(struct fobos_dev_t * dev, const struct fobos_rx_tune_plan_t * plan, double * actual)
+{
+    if (!plan)
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    return fobos_rx_cmd_route(dev, FOBOS_CMD_TUNE_PLAN, plan->frequency, plan, actual);
+}
+//==============================================================================
+static uint8_t * fobos_put_u16(uint8_t * p, uint16_t value)
+{
+    p[0] = (uint8_t)value;
+    p[1] = (uint8_t)(value >> 8);
+    return p + 2;
+}
+//==============================================================================
+static uint8_t * fobos_put_u32(uint8_t * p, uint32_t value)
+{
+    p = fobos_put_u16(p, (uint16_t)value);
+    return fobos_put_u16(p, (uint16_t)(value >> 16));
+}
+//==============================================================================
+static uint8_t * fobos_put_f64(uint8_t * p, double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    p = fobos_put_u32(p, (uint32_t)bits);
+    return fobos_put_u32(p, (uint32_t)(bits >> 32));
+}
+//==============================================================================
+static const uint8_t * fobos_get_u16(const uint8_t * p, uint16_t * value)
+{
+    *value = (uint16_t)(p[0] | (p[1] << 8));
+    return p + 2;
+}
+//==============================================================================
+static const uint8_t * fobos_get_u32(const uint8_t * p, uint32_t * value)
+{
+    uint16_t lo;
+    uint16_t hi;
+    p = fobos_get_u16(p, &lo);
+    p = fobos_get_u16(p, &hi);
+    *value = lo | ((uint32_t)hi << 16);
+    return p;
+}
+//==============================================================================
+static const uint8_t * fobos_get_f64(const uint8_t * p, double * value)
+{
+    uint32_t lo;
+    uint32_t hi;
+    p = fobos_get_u32(p, &lo);
+    p = fobos_get_u32(p, &hi);
+    uint64_t bits = lo | ((uint64_t)hi << 32);
+    memcpy(value, &bits, sizeof(bits));
+    return p;
+}
+//==============================================================================
+int fobos_rx_save_plans(const struct fobos_rx_tune_plan_t * plans, unsigned int count, void * buf, unsigned int * size)
+{
+    if (!size || ((count > 0) && !plans))
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    unsigned int required = FOBOS_PLAN_HEADER_SIZE + count * FOBOS_PLAN_RECORD_SIZE;
+    unsigned int capacity = *size;
+    *size = required;
+    if (!buf)
+    {
+        return FOBOS_ERR_OK;
+    }
+    if (capacity < required)
+    {
+        return FOBOS_ERR_NO_MEM;
+    }
+    uint8_t * p = (uint8_t *)buf;
+    p = fobos_put_u32(p, FOBOS_PLAN_MAGIC);
+    p = fobos_put_u32(p, FOBOS_PLAN_VERSION);
+    p = fobos_put_u32(p, count);
+    p = fobos_put_u32(p, FOBOS_PLAN_RECORD_SIZE);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        const struct fobos_rx_tune_plan_t * plan = &plans[i];
+        p = fobos_put_f64(p, plan->frequency);
+        p = fobos_put_f64(p, plan->actual);
+        p = fobos_put_u32(p, plan->max2830_clock);
+        p = fobos_put_u32(p, plan->rffc507x_clock);
+        p = fobos_put_u32(p, plan->band);
+        p = fobos_put_u32(p, plan->swap_iq);
+        p = fobos_put_u32(p, plan->rffc507x_enabled);
+        p = fobos_put_u16(p, plan->gpo_value);
+        p = fobos_put_u16(p, plan->gpo_mask);
+        for (int k = 0; k < 3; k++)
+        {
+            p = fobos_put_u16(p, plan->max2830_regs[k]);
+        }
+        for (int k = 0; k < FOBOS_RFFC507X_PLL_REGS; k++)
+        {
+            p = fobos_put_u16(p, plan->rffc507x_regs[k]);
+            p = fobos_put_u16(p, plan->rffc507x_masks[k]);
+        }
+    }
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+static const uint8_t * fobos_get_plan(const uint8_t * p, struct fobos_rx_tune_plan_t * plan)
+{
+    memset(plan, 0, sizeof(*plan));
+    p = fobos_get_f64(p, &plan->frequency);
+    p = fobos_get_f64(p, &plan->actual);
+    p = fobos_get_u32(p, &plan->max2830_clock);
+    p = fobos_get_u32(p, &plan->rffc507x_clock);
+    p = fobos_get_u32(p, &plan->band);
+    p = fobos_get_u32(p, &plan->swap_iq);
+    p = fobos_get_u32(p, &plan->rffc507x_enabled);
+    p = fobos_get_u16(p, &plan->gpo_value);
+    p = fobos_get_u16(p, &plan->gpo_mask);
+    for (int k = 0; k < 3; k++)
+    {
+        p = fobos_get_u16(p, &plan->max2830_regs[k]);
+    }
+    for (int k = 0; k < FOBOS_RFFC507X_PLL_REGS; k++)
+    {
+        p = fobos_get_u16(p, &plan->rffc507x_regs[k]);
+        p = fobos_get_u16(p, &plan->rffc507x_masks[k]);
+    }
+    return p;
+}
+//==============================================================================
+int fobos_rx_load_plans(const void * buf, unsigned int size, struct fobos_rx_tune_plan_t * plans, unsigned int * count)
+{
+    if (!buf || !count || (size < FOBOS_PLAN_HEADER_SIZE))
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    const uint8_t * p = (const uint8_t *)buf;
+    uint32_t magic;
+    uint32_t version;
+    uint32_t stored;
+    uint32_t record_size;
+    p = fobos_get_u32(p, &magic);
+    p = fobos_get_u32(p, &version);
+    p = fobos_get_u32(p, &stored);
+    p = fobos_get_u32(p, &record_size);
+    if ((magic != FOBOS_PLAN_MAGIC) || (version != FOBOS_PLAN_VERSION) || (record_size != FOBOS_PLAN_RECORD_SIZE) ||
+        (stored > (size - FOBOS_PLAN_HEADER_SIZE) / FOBOS_PLAN_RECORD_SIZE))
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    // every record is checked before anything is returned
+    const uint8_t * records = p;
+    for (uint32_t i = 0; i < stored; i++)
+    {
+        struct fobos_rx_tune_plan_t plan;
+        p = fobos_get_plan(p, &plan);
+        if (!fobos_rx_plan_fields_ok(&plan))
+        {
+            return FOBOS_ERR_UNSUPPORTED;
+        }
+    }
+    unsigned int capacity = *count;
+    *count = stored;
+    if (!plans)
+    {
+        return FOBOS_ERR_OK;
+    }
+    if (capacity < stored)
+    {
+        return FOBOS_ERR_NO_MEM;
+    }
+    p = records;
+    for (uint32_t i = 0; i < stored; i++)
+    {
+        p = fobos_get_plan(p, &plans[i]);
+    }
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+int fobos_rx_set_dc_mode(struct fobos_dev_t * dev, int mode)
+{
+    int result = fobos_check(dev);
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if ((mode != FOBOS_DC_IIR) && (mode != FOBOS_DC_BLOCK))
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    return fobos_rx_cmd_route(dev, FOBOS_CMD_DC_MODE, mode, NULL, NULL);
+}
+//==============================================================================
+int fobos_rx_set_convert_threads(struct fobos_dev_t * dev, unsigned int count)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%d)\n", __FUNCTION__, count);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (dev->rx_sync_started || (fobos_rx_status(dev) != FOBOS_IDDLE))
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    if (count > FOBOS_MAX_CVT_THREADS)
+    {
+        count = FOBOS_MAX_CVT_THREADS;
+    }
+    dev->cvt_threads_count = count;
+    return result;
+}
+//==============================================================================
+int fobos_rx_set_processing_queue(struct fobos_dev_t * dev, unsigned int depth)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%d)\n", __FUNCTION__, depth);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (fobos_rx_status(dev) != FOBOS_IDDLE)
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    if (depth > FOBOS_MAX_BUF_COUNT)
+    {
+        depth = FOBOS_MAX_BUF_COUNT;
+    }
+    dev->proc_queue_depth = depth;
+    return result;
+}
+//==============================================================================
+int fobos_rx_set_lease_mode(struct fobos_dev_t * dev, fobos_rx_lease_cb_t cb, unsigned int spare_count)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%p, %d)\n", __FUNCTION__, (void*)cb, spare_count);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (fobos_rx_status(dev) != FOBOS_IDDLE)
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    if (cb && (spare_count == 0))
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    if (spare_count > FOBOS_MAX_BUF_COUNT)
+    {
+        spare_count = FOBOS_MAX_BUF_COUNT;
+    }
+    dev->rx_lease_cb = cb;
+    dev->lease_spare_count = cb ? spare_count : 0;
+    return result;
+}
+//==============================================================================
+int fobos_rx_set_framing(struct fobos_dev_t * dev, unsigned int frame_length, unsigned int hop)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%d, %d)\n", __FUNCTION__, frame_length, hop);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (fobos_rx_status(dev) != FOBOS_IDDLE)
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    if (frame_length > FOBOS_MAX_FRAME_LENGTH)
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    if (hop == 0)
+    {
+        hop = frame_length;
+    }
+    dev->frame_length = frame_length;
+    dev->frame_hop = frame_length ? hop : 0;
+    return result;
+}
+//==============================================================================
+int fobos_rx_set_hop_schedule(struct fobos_dev_t * dev, const struct fobos_rx_tune_plan_t * plans, const uint32_t * dwells, unsigned int count, uint32_t settle)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%p, %p, %d, %d)\n", __FUNCTION__, (void*)plans, (void*)dwells, count, settle);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (fobos_rx_status(dev) != FOBOS_IDDLE)
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    if ((count > 0) && (!plans || !dwells))
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if ((dwells[i] == 0) || (fobos_rx_plan_check(dev, &plans[i]) != FOBOS_ERR_OK))
+        {
+            return FOBOS_ERR_UNSUPPORTED;
+        }
+    }
+    struct fobos_rx_tune_plan_t * hop_plans = NULL;
+    uint32_t * hop_dwells = NULL;
+    if (count > 0)
+    {
+        hop_plans = (struct fobos_rx_tune_plan_t *)malloc(count * sizeof(hop_plans[0]));
+        hop_dwells = (uint32_t *)malloc(count * sizeof(hop_dwells[0]));
+        if (!hop_plans || !hop_dwells)
+        {
+            free(hop_plans);
+            free(hop_dwells);
+            return FOBOS_ERR_NO_MEM;
+        }
+        memcpy(hop_plans, plans, count * sizeof(hop_plans[0]));
+        memcpy(hop_dwells, dwells, count * sizeof(hop_dwells[0]));
+    }
+    free(dev->hop_plans);
+    free(dev->hop_dwells);
+    dev->hop_plans = hop_plans;
+    dev->hop_dwells = hop_dwells;
+    dev->hop_count = count;
+    dev->hop_settle = settle;
+    return result;
+}
+//==============================================================================
+int fobos_rx_set_recovery(struct fobos_dev_t * dev, int enabled, unsigned int timeout_ms)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%d, %d)\n", __FUNCTION__, enabled, timeout_ms);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    dev->recover_enabled = enabled;
+    dev->recover_timeout_ms = timeout_ms;
+    return result;
+}
+//==============================================================================
+int fobos_rx_set_sync_queue(struct fobos_dev_t * dev, unsigned int depth)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%d)\n", __FUNCTION__, depth);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (dev->rx_sync_started)
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    if (depth > FOBOS_MAX_BUF_COUNT)
+    {
+        depth = FOBOS_MAX_BUF_COUNT;
+    }
+    dev->sync_depth = depth;
+    return result;
+}
+//==============================================================================
+int fobos_rx_set_auto_buffers(struct fobos_dev_t * dev, double latency_ms)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%f)\n", __FUNCTION__, latency_ms);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (latency_ms < 0.0)
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    dev->auto_latency_ms = latency_ms;
+    return result;
+}
+//==============================================================================
+int fobos_rx_set_event_thread(struct fobos_dev_t * dev, int cpu, int priority)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%d, %d)\n", __FUNCTION__, cpu, priority);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if ((priority < FOBOS_PRIORITY_NORMAL) || (priority > FOBOS_PRIORITY_REALTIME))
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    dev->evt_cpu = (cpu < 0) ? -1 : cpu;
+    dev->evt_priority = priority;
+    return result;
+}
+//==============================================================================
+int fobos_rx_set_buffer_arena(struct fobos_dev_t * dev, unsigned int flags)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(0x%02x)\n", __FUNCTION__, flags);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (flags & ~(FOBOS_ARENA_HUGE_THP | FOBOS_ARENA_HUGE_TLB | FOBOS_ARENA_MLOCK | FOBOS_ARENA_PREFAULT))
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    dev->arena_flags = flags;
+    return result;
+}
+//==============================================================================
+#define FOBOS_STAT_COPY64(name) stats->name = fobos_stat_load(&dev->rx_stats.name)
+#define FOBOS_STAT_COPY32(name) stats->name = (uint32_t)fobos_atomic_load((fobos_atomic_t *)&dev->rx_stats.name)
+static void fobos_rx_stats_copy(struct fobos_dev_t * dev, struct fobos_rx_stats_t * stats)
+{
+    FOBOS_STAT_COPY64(buffers);
+    FOBOS_STAT_COPY64(queue_overflows);
+    FOBOS_STAT_COPY32(queue_depth);
+    FOBOS_STAT_COPY32(queue_max_fill);
+    FOBOS_STAT_COPY64(ring_dropped);
+    FOBOS_STAT_COPY64(gaps);
+    FOBOS_STAT_COPY64(lost_samples);
+    FOBOS_STAT_COPY32(buf_count);
+    FOBOS_STAT_COPY32(buf_length);
+    FOBOS_STAT_COPY32(max_jitter_us);
+    FOBOS_STAT_COPY64(leases);
+    FOBOS_STAT_COPY64(lease_returns);
+    FOBOS_STAT_COPY64(lease_denied);
+    FOBOS_STAT_COPY32(leases_held_max);
+    FOBOS_STAT_COPY64(frames);
+    FOBOS_STAT_COPY64(frame_carried);
+    FOBOS_STAT_COPY64(recoveries);
+    FOBOS_STAT_COPY64(recovery_lost_samples);
+    FOBOS_STAT_COPY64(config_changes);
+    FOBOS_STAT_COPY64(hops);
+    FOBOS_STAT_COPY64(hop_dwell_requested);
+    FOBOS_STAT_COPY64(hop_dwell_achieved);
+    FOBOS_STAT_COPY64(hop_dead_samples);
+    FOBOS_STAT_COPY64(hop_retune_ns);
+    FOBOS_STAT_COPY64(hop_retune_max_ns);
+    FOBOS_STAT_COPY64(hop_errors);
+}
+//==============================================================================
+int fobos_rx_get_stats(struct fobos_dev_t * dev, struct fobos_rx_stats_t * stats)
+{
+    int result = fobos_check(dev);
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (stats)
+    {
+        fobos_rx_stats_copy(dev, stats);
+    }
+    return result;
+}
+//==============================================================================
+int fobos_rx_set_calibration(struct fobos_dev_t * dev, int mode, unsigned int interval, unsigned int interval_ms)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%d, %d, %d)\n", __FUNCTION__, mode, interval, interval_ms);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if ((mode < FOBOS_CAL_OFF) || (mode > FOBOS_CAL_BACKGROUND))
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    dev->cal_mode = mode;
+    dev->cal_interval = interval;
+    dev->cal_interval_ms = interval_ms;
+    return result;
+}
+//==============================================================================
+// Sample conversion kernels
+// All of them mask the 14-bit ADC codes, run the DC filter dc += k * (x - dc)
+// and scale the result to interleaved float32. The scalar kernel is the
+// reference. The SIMD kernels evaluate the same filter as a block prefix scan,
+// dc[j] = p[j] + a^(j+1) * dc[-1], a = 1 - k, so the only loop-carried work is
+// one multiply-add per block. They run the filter relative to mid-scale so the
+// rounding of the a^j coefficients does not bias the DC estimate. Their outputs
+// match the reference within FOBOS_CVT_TOLERANCE (absolute, the output full
+// scale is +/-0.25), checked by test/fobos_cvt_test.c.
+//==============================================================================
+#define FOBOS_CVT_TOLERANCE (4.0f / 32768.0f)
+#define FOBOS_CVT_MID_SCALE 8192.0f
+#define FOBOS_SIMD_NONE     0
+#define FOBOS_SIMD_SSE2     1
+#define FOBOS_SIMD_AVX2     2
+#define FOBOS_SIMD_AVX512   3
+#define FOBOS_SIMD_NEON     4
+//==============================================================================
+typedef struct fobos_cvt_state_t
+{
+    float k;
+    float dc_re;
+    float dc_im;
+    float scale_re;
+    float scale_im;
+} fobos_cvt_state_t;
+typedef void(*fobos_cvt_f32_fn_t)(fobos_cvt_state_t * st, const int16_t * src, float * dst, size_t count);
+//==============================================================================
+// Every kernel is written once as an inline body taking swap_iq as a constant
+// and instantiated for both values, name##_n (as is) and name##_s (swapped).
+//==============================================================================
+#define FOBOS_CVT_SWAP_VARIANTS(name, target) \
+target static void name##_n(fobos_cvt_state_t * st, const int16_t * src, float * dst, size_t count) \
+{ \
+    name##_body(st, src, dst, count, 0); \
+} \
+target static void name##_s(fobos_cvt_state_t * st, const int16_t * src, float * dst, size_t count) \
+{ \
+    name##_body(st, src, dst, count, 1); \
+}
+//==============================================================================
+static FOBOS_INLINE void fobos_cvt_f32_scalar_body(fobos_cvt_state_t * st, const int16_t * src, float * dst, size_t count, const int swap_iq)
+{
+    const int i_re = swap_iq;
+    const int i_im = swap_iq ^ 1;
+    size_t chunks_count = count / 4;
+    float k = st->k;
+    float dc_re = st->dc_re;
+    float dc_im = st->dc_im;
+    float scale_re = st->scale_re;
+    float scale_im = st->scale_im;
+    float re = 0.0f;
+    float im = 0.0f;
+    for (size_t i = 0; i < chunks_count; i++)
+    {
+        // 0
+        re = (float)(src[0 + i_re] & 0x3FFF);
+        im = (float)(src[0 + i_im] & 0x3FFF);
+        dc_re += k * (re - dc_re);
+        dc_im += k * (im - dc_im);
+        dst[0] = (re - dc_re) * scale_re;
+        dst[1] = (im - dc_im) * scale_im;
+        // 1
+        re = (float)(src[2 + i_re] & 0x3FFF);
+        im = (float)(src[2 + i_im] & 0x3FFF);
+        dc_re += k * (re - dc_re);
+        dc_im += k * (im - dc_im);
+        dst[2] = (re - dc_re) * scale_re;
+        dst[3] = (im - dc_im) * scale_im;
+        // 2
+        re = (float)(src[4 + i_re] & 0x3FFF);
+        im = (float)(src[4 + i_im] & 0x3FFF);
+        dc_re += k * (re - dc_re);
+        dc_im += k * (im - dc_im);
+        dst[4] = (re - dc_re) * scale_re;
+        dst[5] = (im - dc_im) * scale_im;
+        // 3
+        re = (float)(src[6 + i_re] & 0x3FFF);
+        im = (float)(src[6 + i_im] & 0x3FFF);
+        dc_re += k * (re - dc_re);
+        dc_im += k * (im - dc_im);
+        dst[6] = (re - dc_re) * scale_re;
+        dst[7] = (im - dc_im) * scale_im;
+        //
+        src += 8;
+        dst += 8;
+    }
+    // tail, less than 4 complex samples
+    for (size_t i = chunks_count * 4; i < count; i++)
+    {
+        re = (float)(src[i_re] & 0x3FFF);
+        im = (float)(src[i_im] & 0x3FFF);
+        dc_re += k * (re - dc_re);
+        dc_im += k * (im - dc_im);
+        dst[0] = (re - dc_re) * scale_re;
+        dst[1] = (im - dc_im) * scale_im;
+        src += 2;
+        dst += 2;
+    }
+    st->dc_re = dc_re;
+    st->dc_im = dc_im;
+}
+FOBOS_CVT_SWAP_VARIANTS(fobos_cvt_f32_scalar, )
+//==============================================================================
+#ifdef FOBOS_X86
+FOBOS_TARGET("sse2")
+static FOBOS_INLINE void fobos_cvt_f32_sse2_body(fobos_cvt_state_t * st, const int16_t * src, float * dst, size_t count, const int swap_iq)
+{
+    size_t chunks_count = count / 4;
+    float a = 1.0f - st->k;
+    float a2 = a * a;
+    float a3 = a2 * a;
+    float a4 = a2 * a2;
+    const __m128i mask = _mm_set1_epi16(0x3FFF);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 k = _mm_set1_ps(st->k);
+    const __m128 c1 = _mm_set1_ps(a);
+    const __m128 c12 = _mm_setr_ps(a, a, a2, a2);
+    const __m128 c34 = _mm_setr_ps(a3, a3, a4, a4);
+    const __m128 mid = _mm_set1_ps(FOBOS_CVT_MID_SCALE);
+    const __m128 scale = _mm_setr_ps(st->scale_re, st->scale_im, st->scale_re, st->scale_im);
+    __m128 dc = _mm_sub_ps(_mm_setr_ps(st->dc_re, st->dc_im, st->dc_re, st->dc_im), mid);
+    for (size_t i = 0; i < chunks_count; i++)
+    {
+        __m128i raw = _mm_and_si128(_mm_loadu_si128((const __m128i *)src), mask);
+        if (swap_iq)
+        {
+            raw = _mm_shufflelo_epi16(raw, _MM_SHUFFLE(2, 3, 0, 1));
+            raw = _mm_shufflehi_epi16(raw, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+        __m128 x0 = _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(raw, zero)), mid); // samples 0, 1
+        __m128 x1 = _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(raw, zero)), mid); // samples 2, 3
+        __m128 s0 = _mm_mul_ps(x0, k);
+        __m128 s1 = _mm_mul_ps(x1, k);
+        s0 = _mm_add_ps(s0, _mm_mul_ps(c1, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(s0), 8))));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(c1, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(s1), 8))));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(c12, _mm_shuffle_ps(s0, s0, _MM_SHUFFLE(3, 2, 3, 2))));
+        __m128 dc0 = _mm_add_ps(s0, _mm_mul_ps(c12, dc));
+        __m128 dc1 = _mm_add_ps(s1, _mm_mul_ps(c34, dc));
+        _mm_storeu_ps(dst + 0, _mm_mul_ps(_mm_sub_ps(x0, dc0), scale));
+        _mm_storeu_ps(dst + 4, _mm_mul_ps(_mm_sub_ps(x1, dc1), scale));
+        dc = _mm_shuffle_ps(dc1, dc1, _MM_SHUFFLE(3, 2, 3, 2));
+        src += 8;
+        dst += 8;
+    }
+    float dc_out[4];
+    _mm_storeu_ps(dc_out, _mm_add_ps(dc, mid));
+    st->dc_re = dc_out[0];
+    st->dc_im = dc_out[1];
+    fobos_cvt_f32_scalar_body(st, src, dst, count - chunks_count * 4, swap_iq);
+}
+FOBOS_CVT_SWAP_VARIANTS(fobos_cvt_f32_sse2, FOBOS_TARGET("sse2"))
+//==============================================================================
+FOBOS_TARGET("avx2")
+static FOBOS_INLINE void fobos_cvt_f32_avx2_body(fobos_cvt_state_t * st, const int16_t * src, float * dst, size_t count, const int swap_iq)
+{
+    size_t chunks_count = count / 8;
+    float c[9];
+    c[0] = 1.0f;
+    for (int i = 1; i < 9; i++)
+    {
+        c[i] = c[i - 1] * (1.0f - st->k);
+    }
+    const __m256i mask = _mm256_set1_epi16(0x3FFF);
+    const __m256 k = _mm256_set1_ps(st->k);
+    const __m256 c1 = _mm256_set1_ps(c[1]);
+    const __m256 c12 = _mm256_setr_ps(c[1], c[1], c[2], c[2], c[1], c[1], c[2], c[2]);
+    const __m256 c14 = _mm256_setr_ps(c[1], c[1], c[2], c[2], c[3], c[3], c[4], c[4]);
+    const __m256 c58 = _mm256_setr_ps(c[5], c[5], c[6], c[6], c[7], c[7], c[8], c[8]);
+    const __m256 mid = _mm256_set1_ps(FOBOS_CVT_MID_SCALE);
+    const __m256 scale = _mm256_setr_ps(st->scale_re, st->scale_im, st->scale_re, st->scale_im,
+                                        st->scale_re, st->scale_im, st->scale_re, st->scale_im);
+    __m256 dc = _mm256_sub_ps(_mm256_setr_ps(st->dc_re, st->dc_im, st->dc_re, st->dc_im,
+                                             st->dc_re, st->dc_im, st->dc_re, st->dc_im), mid);
+    for (size_t i = 0; i < chunks_count; i++)
+    {
+        __m256i raw = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)src), mask);
+        __m256 x0 = _mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(raw))), mid);      // samples 0..3
+        __m256 x1 = _mm256_sub_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(raw, 1))), mid); // samples 4..7
+        if (swap_iq)
+        {
+            x0 = _mm256_permute_ps(x0, _MM_SHUFFLE(2, 3, 0, 1));
+            x1 = _mm256_permute_ps(x1, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+        __m256 s0 = _mm256_mul_ps(x0, k);
+        __m256 s1 = _mm256_mul_ps(x1, k);
+        // scan inside 128-bit lanes
+        s0 = _mm256_add_ps(s0, _mm256_mul_ps(c1, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(s0), 8))));
+        s1 = _mm256_add_ps(s1, _mm256_mul_ps(c1, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(s1), 8))));
+        // carry the last sample of the lower lane to the upper lane
+        __m256 t0 = _mm256_permute_ps(s0, _MM_SHUFFLE(3, 2, 3, 2));
+        __m256 t1 = _mm256_permute_ps(s1, _MM_SHUFFLE(3, 2, 3, 2));
+        s0 = _mm256_add_ps(s0, _mm256_mul_ps(c12, _mm256_permute2f128_ps(t0, t0, 0x08)));
+        s1 = _mm256_add_ps(s1, _mm256_mul_ps(c12, _mm256_permute2f128_ps(t1, t1, 0x08)));
+        // carry the last sample of s0 to s1
+        t0 = _mm256_permute_ps(_mm256_permute2f128_ps(s0, s0, 0x11), _MM_SHUFFLE(3, 2, 3, 2));
+        s1 = _mm256_add_ps(s1, _mm256_mul_ps(c14, t0));
+        __m256 dc0 = _mm256_add_ps(s0, _mm256_mul_ps(c14, dc));
+        __m256 dc1 = _mm256_add_ps(s1, _mm256_mul_ps(c58, dc));
+        _mm256_storeu_ps(dst + 0, _mm256_mul_ps(_mm256_sub_ps(x0, dc0), scale));
+        _mm256_storeu_ps(dst + 8, _mm256_mul_ps(_mm256_sub_ps(x1, dc1), scale));
+        dc = _mm256_permute_ps(_mm256_permute2f128_ps(dc1, dc1, 0x11), _MM_SHUFFLE(3, 2, 3, 2));
+        src += 16;
+        dst += 16;
+    }
+    float dc_out[8];
+    _mm256_storeu_ps(dc_out, _mm256_add_ps(dc, mid));
+    st->dc_re = dc_out[0];
+    st->dc_im = dc_out[1];
+    fobos_cvt_f32_scalar_body(st, src, dst, count - chunks_count * 8, swap_iq);
+}
+FOBOS_CVT_SWAP_VARIANTS(fobos_cvt_f32_avx2, FOBOS_TARGET("avx2"))
+//==============================================================================
+FOBOS_TARGET("avx512f")
+static FOBOS_INLINE void fobos_cvt_f32_avx512_body(fobos_cvt_state_t * st, const int16_t * src, float * dst, size_t count, const int swap_iq)
+{
+    size_t chunks_count = count / 16;
+    float c[17];
+    c[0] = 1.0f;
+    for (int i = 1; i < 17; i++)
+    {
+        c[i] = c[i - 1] * (1.0f - st->k);
+    }
+    const __m512i mask = _mm512_set1_epi32(0x3FFF3FFF);
+    const __m512 k = _mm512_set1_ps(st->k);
+    const __m512 c1 = _mm512_set1_ps(c[1]);
+    const __m512 c2 = _mm512_set1_ps(c[2]);
+    const __m512 c4 = _mm512_set1_ps(c[4]);
+    const __m512 c18 = _mm512_setr_ps(c[1], c[1], c[2], c[2], c[3], c[3], c[4], c[4],
+                                      c[5], c[5], c[6], c[6], c[7], c[7], c[8], c[8]);
+    const __m512 c916 = _mm512_setr_ps(c[9], c[9], c[10], c[10], c[11], c[11], c[12], c[12],
+                                       c[13], c[13], c[14], c[14], c[15], c[15], c[16], c[16]);
+    // shift by 1, 2 and 4 complex samples towards the end, zero filled
+    const __m512i shift1 = _mm512_setr_epi32(0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13);
+    const __m512i shift2 = _mm512_setr_epi32(0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11);
+    const __m512i shift4 = _mm512_setr_epi32(0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7);
+    const __m512i last = _mm512_setr_epi32(14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15, 14, 15);
+    const __mmask16 mask1 = (__mmask16)0xFFFC;
+    const __mmask16 mask2 = (__mmask16)0xFFF0;
+    const __mmask16 mask4 = (__mmask16)0xFF00;
+    const __m512 mid = _mm512_set1_ps(FOBOS_CVT_MID_SCALE);
+    const __m512 scale = _mm512_setr_ps(st->scale_re, st->scale_im, st->scale_re, st->scale_im,
+                                        st->scale_re, st->scale_im, st->scale_re, st->scale_im,
+                                        st->scale_re, st->scale_im, st->scale_re, st->scale_im,
+                                        st->scale_re, st->scale_im, st->scale_re, st->scale_im);
+    __m512 dc = _mm512_sub_ps(_mm512_setr_ps(st->dc_re, st->dc_im, st->dc_re, st->dc_im,
+                                             st->dc_re, st->dc_im, st->dc_re, st->dc_im,
+                                             st->dc_re, st->dc_im, st->dc_re, st->dc_im,
+                                             st->dc_re, st->dc_im, st->dc_re, st->dc_im), mid);
+    for (size_t i = 0; i < chunks_count; i++)
+    {
+        __m512i raw = _mm512_and_si512(_mm512_loadu_si512((const void *)src), mask);
+        __m512 x0 = _mm512_sub_ps(_mm512_cvtepi32_ps(_mm512_cvtepu16_epi32(_mm512_castsi512_si256(raw))), mid);       // samples 0..7
+        __m512 x1 = _mm512_sub_ps(_mm512_cvtepi32_ps(_mm512_cvtepu16_epi32(_mm512_extracti64x4_epi64(raw, 1))), mid); // samples 8..15
+        if (swap_iq)
+        {
+            x0 = _mm512_permute_ps(x0, _MM_SHUFFLE(2, 3, 0, 1));
+            x1 = _mm512_permute_ps(x1, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+        __m512 s0 = _mm512_mul_ps(x0, k);
+        __m512 s1 = _mm512_mul_ps(x1, k);
+        s0 = _mm512_add_ps(s0, _mm512_mul_ps(c1, _mm512_maskz_permutexvar_ps(mask1, shift1, s0)));
+        s1 = _mm512_add_ps(s1, _mm512_mul_ps(c1, _mm512_maskz_permutexvar_ps(mask1, shift1, s1)));
+        s0 = _mm512_add_ps(s0, _mm512_mul_ps(c2, _mm512_maskz_permutexvar_ps(mask2, shift2, s0)));
+        s1 = _mm512_add_ps(s1, _mm512_mul_ps(c2, _mm512_maskz_permutexvar_ps(mask2, shift2, s1)));
+        s0 = _mm512_add_ps(s0, _mm512_mul_ps(c4, _mm512_maskz_permutexvar_ps(mask4, shift4, s0)));
+        s1 = _mm512_add_ps(s1, _mm512_mul_ps(c4, _mm512_maskz_permutexvar_ps(mask4, shift4, s1)));
+        s1 = _mm512_add_ps(s1, _mm512_mul_ps(c18, _mm512_permutexvar_ps(last, s0)));
+        __m512 dc0 = _mm512_add_ps(s0, _mm512_mul_ps(c18, dc));
+        __m512 dc1 = _mm512_add_ps(s1, _mm512_mul_ps(c916, dc));
+        _mm512_storeu_ps(dst + 0, _mm512_mul_ps(_mm512_sub_ps(x0, dc0), scale));
+        _mm512_storeu_ps(dst + 16, _mm512_mul_ps(_mm512_sub_ps(x1, dc1), scale));
+        dc = _mm512_permutexvar_ps(last, dc1);
+        src += 32;
+        dst += 32;
+    }
+    float dc_out[16];
+    _mm512_storeu_ps(dc_out, _mm512_add_ps(dc, mid));
+    st->dc_re = dc_out[0];
+    st->dc_im = dc_out[1];
+    fobos_cvt_f32_scalar_body(st, src, dst, count - chunks_count * 16, swap_iq);
+}
+FOBOS_CVT_SWAP_VARIANTS(fobos_cvt_f32_avx512, FOBOS_TARGET("avx512f"))
+#endif // FOBOS_X86
+//==============================================================================
+#ifdef FOBOS_NEON
+static FOBOS_INLINE void fobos_cvt_f32_neon_body(fobos_cvt_state_t * st, const int16_t * src, float * dst, size_t count, const int swap_iq)
+{
+    size_t chunks_count = count / 4;
+    float a = 1.0f - st->k;
+    float a2 = a * a;
+    float c12_data[4] = { a, a, a2, a2 };
+    float c34_data[4] = { a2 * a, a2 * a, a2 * a2, a2 * a2 };
+    float scale_data[4] = { st->scale_re, st->scale_im, st->scale_re, st->scale_im };
+    float dc_data[4] = { st->dc_re - FOBOS_CVT_MID_SCALE, st->dc_im - FOBOS_CVT_MID_SCALE, st->dc_re - FOBOS_CVT_MID_SCALE, st->dc_im - FOBOS_CVT_MID_SCALE };
+    const int16x8_t mask = vdupq_n_s16(0x3FFF);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t mid = vdupq_n_f32(FOBOS_CVT_MID_SCALE);
+    const float32x4_t c12 = vld1q_f32(c12_data);
+    const float32x4_t c34 = vld1q_f32(c34_data);
+    const float32x4_t scale = vld1q_f32(scale_data);
+    float32x4_t dc = vld1q_f32(dc_data);
+    for (size_t i = 0; i < chunks_count; i++)
+    {
+        int16x8_t raw = vandq_s16(vld1q_s16(src), mask);
+        if (swap_iq)
+        {
+            raw = vrev32q_s16(raw);
+        }
+        uint16x8_t u = vreinterpretq_u16_s16(raw);
+        float32x4_t x0 = vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(u))), mid);  // samples 0, 1
+        float32x4_t x1 = vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(u))), mid); // samples 2, 3
+        float32x4_t s0 = vmulq_n_f32(x0, st->k);
+        float32x4_t s1 = vmulq_n_f32(x1, st->k);
+        s0 = vmlaq_n_f32(s0, vextq_f32(zero, s0, 2), a);
+        s1 = vmlaq_n_f32(s1, vextq_f32(zero, s1, 2), a);
+        s1 = vmlaq_f32(s1, c12, vcombine_f32(vget_high_f32(s0), vget_high_f32(s0)));
+        float32x4_t dc0 = vmlaq_f32(s0, c12, dc);
+        float32x4_t dc1 = vmlaq_f32(s1, c34, dc);
+        vst1q_f32(dst + 0, vmulq_f32(vsubq_f32(x0, dc0), scale));
+        vst1q_f32(dst + 4, vmulq_f32(vsubq_f32(x1, dc1), scale));
+        dc = vcombine_f32(vget_high_f32(dc1), vget_high_f32(dc1));
+        src += 8;
+        dst += 8;
+    }
+    st->dc_re = vgetq_lane_f32(dc, 0) + FOBOS_CVT_MID_SCALE;
+    st->dc_im = vgetq_lane_f32(dc, 1) + FOBOS_CVT_MID_SCALE;
+    fobos_cvt_f32_scalar_body(st, src, dst, count - chunks_count * 4, swap_iq);
+}
+FOBOS_CVT_SWAP_VARIANTS(fobos_cvt_f32_neon, )
+#endif // FOBOS_NEON
+//==============================================================================
+// Block DC removal, FOBOS_DC_BLOCK
+// The offset is estimated once per sub-block from the sub-block mean, smoothed
+// with the same time constant as the IIR filter, alpha = 1 - (1 - k)^n, and
+// subtracted as a linear ramp from the previous estimate to the new one. Both
+// passes have no loop-carried dependency besides the sums and vectorize.
+//==============================================================================
+#define FOBOS_DC_SUBBLOCK 1024
+static FOBOS_INLINE void fobos_dc_block_apply(const int16_t * src, float * dst, int n, int swap_iq,
+                                        float dc_re, float step_re, float scale_re,
+                                        float dc_im, float step_im, float scale_im)
+{
+    if (swap_iq)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            float t = (float)(i + 1);
+            dst[2 * i + 0] = ((float)(src[2 * i + 1] & 0x3FFF) - (dc_re + step_re * t)) * scale_re;
+            dst[2 * i + 1] = ((float)(src[2 * i + 0] & 0x3FFF) - (dc_im + step_im * t)) * scale_im;
+        }
+    }
+    else
+    {
+        for (int i = 0; i < n; i++)
+        {
+            float t = (float)(i + 1);
+            dst[2 * i + 0] = ((float)(src[2 * i + 0] & 0x3FFF) - (dc_re + step_re * t)) * scale_re;
+            dst[2 * i + 1] = ((float)(src[2 * i + 1] & 0x3FFF) - (dc_im + step_im * t)) * scale_im;
+        }
+    }
+}
+//==============================================================================
+static FOBOS_INLINE void fobos_cvt_f32_block_body(fobos_cvt_state_t * st, const int16_t * src, float * dst, size_t count, const int swap_iq)
+{
+    float alpha_full = 1.0f - powf(1.0f - st->k, (float)FOBOS_DC_SUBBLOCK);
+    while (count)
+    {
+        size_t n = (count < FOBOS_DC_SUBBLOCK) ? count : FOBOS_DC_SUBBLOCK;
+        float alpha = (n == FOBOS_DC_SUBBLOCK) ? alpha_full : 1.0f - powf(1.0f - st->k, (float)n);
+        int32_t summ_0 = 0;
+        int32_t summ_1 = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            summ_0 += src[2 * i + 0] & 0x3FFF;
+            summ_1 += src[2 * i + 1] & 0x3FFF;
+        }
+        float avg_re = (float)(swap_iq ? summ_1 : summ_0) / (float)n;
+        float avg_im = (float)(swap_iq ? summ_0 : summ_1) / (float)n;
+        float dc_re = st->dc_re + alpha * (avg_re - st->dc_re);
+        float dc_im = st->dc_im + alpha * (avg_im - st->dc_im);
+        float step_re = (dc_re - st->dc_re) / (float)n;
+        float step_im = (dc_im - st->dc_im) / (float)n;
+        fobos_dc_block_apply(src, dst, (int)n, swap_iq,
+                             st->dc_re, step_re, st->scale_re,
+                             st->dc_im, step_im, st->scale_im);
+        st->dc_re = dc_re;
+        st->dc_im = dc_im;
+        src += 2 * n;
+        dst += 2 * n;
+        count -= n;
+    }
+}
+FOBOS_CVT_SWAP_VARIANTS(fobos_cvt_f32_block, )
+//==============================================================================
+// IQ amplitude calibration kernels
+// fobos_cal_sum adds the raw I and Q codes, fobos_cal_absdev adds the absolute
+// deviations from the given averages. The SIMD versions keep 32-bit lane sums
+// and fold them into the 64-bit totals every FOBOS_CAL_FOLD iterations.
+//==============================================================================
+#define FOBOS_CAL_FOLD 16384
+typedef void(*fobos_cal_sum_fn_t)(const int16_t * src, size_t count, int64_t * sum_re, int64_t * sum_im);
+typedef void(*fobos_cal_absdev_fn_t)(const int16_t * src, size_t count, int16_t avg_re, int16_t avg_im, int64_t * sum_re, int64_t * sum_im);
+//==============================================================================
+static void fobos_cal_sum_scalar(const int16_t * src, size_t count, int64_t * sum_re, int64_t * sum_im)
+{
+    int64_t summ_re = 0ll;
+    int64_t summ_im = 0ll;
+    for (size_t i = 0; i < count; i++)
+    {
+        summ_re += src[0];
+        summ_im += src[1];
+        src += 2;
+    }
+    *sum_re += summ_re;
+    *sum_im += summ_im;
+}
+//==============================================================================
+static void fobos_cal_absdev_scalar(const int16_t * src, size_t count, int16_t avg_re, int16_t avg_im, int64_t * sum_re, int64_t * sum_im)
+{
+    int64_t summ_re = 0ll;
+    int64_t summ_im = 0ll;
+    for (size_t i = 0; i < count; i++)
+    {
+        summ_re += abs(src[0] - avg_re);
+        summ_im += abs(src[1] - avg_im);
+        src += 2;
+    }
+    *sum_re += summ_re;
+    *sum_im += summ_im;
+}
+//==============================================================================
+#ifdef FOBOS_X86
+FOBOS_TARGET("sse2")
+static void fobos_cal_sum_sse2(const int16_t * src, size_t count, int64_t * sum_re, int64_t * sum_im)
+{
+    size_t n4 = count / 4;
+    while (n4)
+    {
+        size_t n = (n4 < FOBOS_CAL_FOLD) ? n4 : FOBOS_CAL_FOLD;
+        __m128i acc = _mm_setzero_si128();
+        for (size_t i = 0; i < n; i++)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *)src);
+            __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+            __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+            acc = _mm_add_epi32(acc, _mm_add_epi32(lo, hi));
+            src += 8;
+        }
+        int32_t lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, acc);
+        *sum_re += (int64_t)lanes[0] + lanes[2];
+        *sum_im += (int64_t)lanes[1] + lanes[3];
+        n4 -= n;
+    }
+    fobos_cal_sum_scalar(src, count & 3, sum_re, sum_im);
+}
+//==============================================================================
+FOBOS_TARGET("sse2")
+static void fobos_cal_absdev_sse2(const int16_t * src, size_t count, int16_t avg_re, int16_t avg_im, int64_t * sum_re, int64_t * sum_im)
+{
+    const __m128i avg = _mm_set_epi16(avg_im, avg_re, avg_im, avg_re, avg_im, avg_re, avg_im, avg_re);
+    const __m128i zero = _mm_setzero_si128();
+    size_t n4 = count / 4;
+    while (n4)
+    {
+        size_t n = (n4 < FOBOS_CAL_FOLD) ? n4 : FOBOS_CAL_FOLD;
+        __m128i acc = _mm_setzero_si128();
+        for (size_t i = 0; i < n; i++)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i *)src);
+            // |x - avg| as an unsigned 16-bit value, exact for any int16 input
+            __m128i d = _mm_sub_epi16(_mm_max_epi16(x, avg), _mm_min_epi16(x, avg));
+            acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_unpacklo_epi16(d, zero), _mm_unpackhi_epi16(d, zero)));
+            src += 8;
+        }
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, acc);
+        *sum_re += (int64_t)lanes[0] + lanes[2];
+        *sum_im += (int64_t)lanes[1] + lanes[3];
+        n4 -= n;
+    }
+    fobos_cal_absdev_scalar(src, count & 3, avg_re, avg_im, sum_re, sum_im);
+}
+#endif // FOBOS_X86
+//==============================================================================
+#ifdef FOBOS_NEON
+static void fobos_cal_sum_neon(const int16_t * src, size_t count, int64_t * sum_re, int64_t * sum_im)
+{
+    size_t n8 = count / 8;
+    while (n8)
+    {
+        size_t n = (n8 < FOBOS_CAL_FOLD) ? n8 : FOBOS_CAL_FOLD;
+        int32x4_t acc_re = vdupq_n_s32(0);
+        int32x4_t acc_im = vdupq_n_s32(0);
+        for (size_t i = 0; i < n; i++)
+        {
+            int16x8x2_t x = vld2q_s16(src);
+            acc_re = vpadalq_s16(acc_re, x.val[0]);
+            acc_im = vpadalq_s16(acc_im, x.val[1]);
+            src += 16;
+        }
+        int32_t lanes_re[4];
+        int32_t lanes_im[4];
+        vst1q_s32(lanes_re, acc_re);
+        vst1q_s32(lanes_im, acc_im);
+        *sum_re += (int64_t)lanes_re[0] + lanes_re[1] + lanes_re[2] + lanes_re[3];
+        *sum_im += (int64_t)lanes_im[0] + lanes_im[1] + lanes_im[2] + lanes_im[3];
+        n8 -= n;
+    }
+    fobos_cal_sum_scalar(src, count & 7, sum_re, sum_im);
+}
+//==============================================================================
+static void fobos_cal_absdev_neon(const int16_t * src, size_t count, int16_t avg_re, int16_t avg_im, int64_t * sum_re, int64_t * sum_im)
+{
+    const int16x4_t vavg_re = vdup_n_s16(avg_re);
+    const int16x4_t vavg_im = vdup_n_s16(avg_im);
+    size_t n8 = count / 8;
+    while (n8)
+    {
+        size_t n = (n8 < FOBOS_CAL_FOLD) ? n8 : FOBOS_CAL_FOLD;
+        uint32x4_t acc_re = vdupq_n_u32(0);
+        uint32x4_t acc_im = vdupq_n_u32(0);
+        for (size_t i = 0; i < n; i++)
+        {
+            int16x8x2_t x = vld2q_s16(src);
+            acc_re = vaddq_u32(acc_re, vreinterpretq_u32_s32(vabdl_s16(vget_low_s16(x.val[0]), vavg_re)));
+            acc_re = vaddq_u32(acc_re, vreinterpretq_u32_s32(vabdl_s16(vget_high_s16(x.val[0]), vavg_re)));
+            acc_im = vaddq_u32(acc_im, vreinterpretq_u32_s32(vabdl_s16(vget_low_s16(x.val[1]), vavg_im)));
+            acc_im = vaddq_u32(acc_im, vreinterpretq_u32_s32(vabdl_s16(vget_high_s16(x.val[1]), vavg_im)));
+            src += 16;
+        }
+        uint32_t lanes_re[4];
+        uint32_t lanes_im[4];
+        vst1q_u32(lanes_re, acc_re);
+        vst1q_u32(lanes_im, acc_im);
+        *sum_re += (int64_t)lanes_re[0] + lanes_re[1] + lanes_re[2] + lanes_re[3];
+        *sum_im += (int64_t)lanes_im[0] + lanes_im[1] + lanes_im[2] + lanes_im[3];
+        n8 -= n;
+    }
+    fobos_cal_absdev_scalar(src, count & 7, avg_re, avg_im, sum_re, sum_im);
+}
+#endif // FOBOS_NEON
+//==============================================================================
+static int fobos_cpu_simd_level(void)
+{
+#if defined(FOBOS_X86) && defined(_MSC_VER)
+    int info[4];
+    int avx2 = 0;
+    int avx512 = 0;
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+    __cpuid(info, 1);
+    int sse2 = (info[3] >> 26) & 1;
+    int osxsave = (info[2] >> 27) & 1;
+    if ((max_leaf >= 7) && osxsave)
+    {
+        unsigned long long xcr0 = _xgetbv(0);
+        __cpuidex(info, 7, 0);
+        avx2 = ((xcr0 & 0x06) == 0x06) && ((info[1] >> 5) & 1);
+        avx512 = ((xcr0 & 0xE6) == 0xE6) && ((info[1] >> 16) & 1);
+    }
+    if (avx512) return FOBOS_SIMD_AVX512;
+    if (avx2) return FOBOS_SIMD_AVX2;
+    if (sse2) return FOBOS_SIMD_SSE2;
+#elif defined(FOBOS_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return FOBOS_SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2")) return FOBOS_SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2")) return FOBOS_SIMD_SSE2;
+#elif defined(FOBOS_NEON)
+    return FOBOS_SIMD_NEON;
+#endif
+    return FOBOS_SIMD_NONE;
+}
+//==============================================================================
+static fobos_cal_sum_fn_t fobos_cal_sum = fobos_cal_sum_scalar;
+static fobos_cal_absdev_fn_t fobos_cal_absdev = fobos_cal_absdev_scalar;
+//==============================================================================
+// Integer output formats reuse the float kernel on small blocks, the scale is
+// folded into the kernel so only a saturating round-and-pack remains.
+//==============================================================================
+#define FOBOS_CVT_BLOCK FOBOS_DC_SUBBLOCK
+static const uint32_t fobos_format_sample_size[] =
+{
+    2 * sizeof(float),   // FOBOS_FORMAT_CF32
+    2 * sizeof(int16_t), // FOBOS_FORMAT_CS16
+    2 * sizeof(int8_t),  // FOBOS_FORMAT_CS8
+};
+static const float fobos_format_full_scale[] =
+{
+    1.0f,                // FOBOS_FORMAT_CF32, +/-0.25
+    4.0f * 32768.0f,     // FOBOS_FORMAT_CS16, +/-32767
+    4.0f * 128.0f,       // FOBOS_FORMAT_CS8,  +/-127
+};
+//==============================================================================
+static void fobos_pack_s16(const float * src, int16_t * dst, size_t count)
+{
+    size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i lo = _mm_cvtps_epi32(_mm_loadu_ps(src + i + 0));
+        __m128i hi = _mm_cvtps_epi32(_mm_loadu_ps(src + i + 4));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(lo, hi));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        float v = src[i];
+        v = (v > 32767.0f) ? 32767.0f : ((v < -32768.0f) ? -32768.0f : v);
+        dst[i] = (int16_t)lrintf(v);
+    }
+}
+//==============================================================================
+static void fobos_pack_s8(const float * src, int8_t * dst, size_t count)
+{
+    size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i a = _mm_packs_epi32(_mm_cvtps_epi32(_mm_loadu_ps(src + i + 0)), _mm_cvtps_epi32(_mm_loadu_ps(src + i + 4)));
+        __m128i b = _mm_packs_epi32(_mm_cvtps_epi32(_mm_loadu_ps(src + i + 8)), _mm_cvtps_epi32(_mm_loadu_ps(src + i + 12)));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi16(a, b));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        float v = src[i];
+        v = (v > 127.0f) ? 127.0f : ((v < -128.0f) ? -128.0f : v);
+        dst[i] = (int8_t)lrintf(v);
+    }
+}
+//==============================================================================
+static FOBOS_INLINE void fobos_cvt_s16(fobos_cvt_f32_fn_t cvt_f32, fobos_cvt_state_t * st, const int16_t * src, int16_t * dst, size_t count)
+{
+    float tmp[2 * FOBOS_CVT_BLOCK];
+    while (count)
+    {
+        size_t n = (count < FOBOS_CVT_BLOCK) ? count : FOBOS_CVT_BLOCK;
+        cvt_f32(st, src, tmp, n);
+        fobos_pack_s16(tmp, dst, 2 * n);
+        src += 2 * n;
+        dst += 2 * n;
+        count -= n;
+    }
+}
+//==============================================================================
+static FOBOS_INLINE void fobos_cvt_s8(fobos_cvt_f32_fn_t cvt_f32, fobos_cvt_state_t * st, const int16_t * src, int8_t * dst, size_t count)
+{
+    float tmp[2 * FOBOS_CVT_BLOCK];
+    while (count)
+    {
+        size_t n = (count < FOBOS_CVT_BLOCK) ? count : FOBOS_CVT_BLOCK;
+        cvt_f32(st, src, tmp, n);
+        fobos_pack_s8(tmp, dst, 2 * n);
+        src += 2 * n;
+        dst += 2 * n;
+        count -= n;
+    }
+}
+//==============================================================================
+// Kernel table
+// One entry per DC mode, swap_iq and output format, all of them generated from
+// the kernel bodies above. The entry is picked by fobos_rx_cvt_select() when
+// the stream starts or the band, the direct sampling or the DC mode changes,
+// the streaming path only calls it.
+//==============================================================================
+typedef void(*fobos_cvt_fn_t)(struct fobos_cvt_state_t * st, const int16_t * src, void * dst, size_t count);
+typedef fobos_cvt_fn_t fobos_cvt_row_t[3];
+//==============================================================================
+#define FOBOS_CVT_FORMAT_VARIANTS(name) \
+static void name##_cf32(fobos_cvt_state_t * st, const int16_t * src, void * dst, size_t count) \
+{ \
+    name(st, src, (float *)dst, count); \
+} \
+static void name##_cs16(fobos_cvt_state_t * st, const int16_t * src, void * dst, size_t count) \
+{ \
+    fobos_cvt_s16(name, st, src, (int16_t *)dst, count); \
+} \
+static void name##_cs8(fobos_cvt_state_t * st, const int16_t * src, void * dst, size_t count) \
+{ \
+    fobos_cvt_s8(name, st, src, (int8_t *)dst, count); \
+}
+#define FOBOS_CVT_TABLE(table, name) \
+FOBOS_CVT_FORMAT_VARIANTS(name##_n) \
+FOBOS_CVT_FORMAT_VARIANTS(name##_s) \
+static const fobos_cvt_row_t fobos_cvt_table_##table[2] = \
+{ \
+    { name##_n_cf32, name##_n_cs16, name##_n_cs8 }, \
+    { name##_s_cf32, name##_s_cs16, name##_s_cs8 }, \
+};
+//==============================================================================
+FOBOS_CVT_TABLE(scalar, fobos_cvt_f32_scalar)
+FOBOS_CVT_TABLE(block, fobos_cvt_f32_block)
+#ifdef FOBOS_X86
+FOBOS_CVT_TABLE(sse2, fobos_cvt_f32_sse2)
+FOBOS_CVT_TABLE(avx2, fobos_cvt_f32_avx2)
+FOBOS_CVT_TABLE(avx512, fobos_cvt_f32_avx512)
+#endif // FOBOS_X86
+#ifdef FOBOS_NEON
+FOBOS_CVT_TABLE(neon, fobos_cvt_f32_neon)
+#endif // FOBOS_NEON
+static const fobos_cvt_row_t * fobos_cvt_table_iir = fobos_cvt_table_scalar;
+//==============================================================================
+static fobos_cvt_fn_t fobos_cvt_select(int dc_mode, int swap_iq, int format)
+{
+    const fobos_cvt_row_t * table = (dc_mode == FOBOS_DC_BLOCK) ? fobos_cvt_table_block : fobos_cvt_table_iir;
+    return table[swap_iq ? 1 : 0][format];
+}
+//==============================================================================
+// the devices may be opened from several threads, the first one selects the
+// kernels and the others wait until it is done
+void fobos_cvt_init(void)
+{
+    static fobos_atomic_t state = 0;    // 0 - not done, 1 - in progress, 2 - done
+    if (fobos_atomic_load(&state) == 2)
+    {
+        return;
+    }
+    if (!fobos_atomic_cas(&state, 0, 1))
+    {
+        while (fobos_atomic_load(&state) != 2)
+        {
+        }
+        return;
+    }
+    int simd = fobos_cpu_simd_level();
+    switch (simd)
+    {
+#ifdef FOBOS_X86
+        case FOBOS_SIMD_AVX512: fobos_cvt_table_iir = fobos_cvt_table_avx512; break;
+        case FOBOS_SIMD_AVX2:   fobos_cvt_table_iir = fobos_cvt_table_avx2;   break;
+        case FOBOS_SIMD_SSE2:   fobos_cvt_table_iir = fobos_cvt_table_sse2;   break;
+#endif // FOBOS_X86
+#ifdef FOBOS_NEON
+        case FOBOS_SIMD_NEON:   fobos_cvt_table_iir = fobos_cvt_table_neon;   break;
+#endif // FOBOS_NEON
+        default:                fobos_cvt_table_iir = fobos_cvt_table_scalar; break;
+    }
+#ifdef FOBOS_X86
+    if (simd >= FOBOS_SIMD_SSE2)
+    {
+        fobos_cal_sum = fobos_cal_sum_sse2;
+        fobos_cal_absdev = fobos_cal_absdev_sse2;
+    }
+#endif // FOBOS_X86
+#ifdef FOBOS_NEON
+    if (simd == FOBOS_SIMD_NEON)
+    {
+        fobos_cal_sum = fobos_cal_sum_neon;
+        fobos_cal_absdev = fobos_cal_absdev_neon;
+    }
+#endif // FOBOS_NEON
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("sample conversion simd level %d\n", simd);
+#endif // FOBOS_PRINT_DEBUG
+    fobos_atomic_store(&state, 2);
+}
+//==============================================================================
+// Conversion worker pool
+// A buffer is cut into slices of whole DC sub-blocks. Every slice starts from
+// the DC state at the start of the buffer and all of them are converted in
+// parallel, the calling thread takes the first one. Both DC filters are linear,
+// so a wrong initial state d only adds d * h[j] to the filter output, h being
+// the filter response to a unit initial state. Once the slices are done the
+// true initial states are chained from slice to slice and every slice is
+// corrected while the term is above FOBOS_CVT_POOL_EPS codes. The integer
+// formats are converted to float first and packed after the correction, so
+// they are rounded once. The last slice may end in a partial sub-block, its
+// response is computed for the actual length. The buffers are processed one
+// at a time, the delivery order never changes.
+//==============================================================================
+#define FOBOS_CVT_POOL_EPS    (1.0 / 64.0)
+//==============================================================================
+typedef struct fobos_cvt_job_t
+{
+    const int16_t * src;
+    void * dst;
+    float * tmp;            // float output of the integer formats, NULL for CF32
+    size_t count;
+    size_t tail;            // start of the partial last sub-block, count if none
+    float d_re;             // initial state error, output units
+    float d_im;
+    float d_max;            // initial state error, codes
+    fobos_cvt_state_t st;
+} fobos_cvt_job_t;
+//==============================================================================
+typedef struct fobos_cvt_worker_t
+{
+    struct fobos_cvt_pool_t * pool;
+    uint32_t index;
+} fobos_cvt_worker_t;
+//==============================================================================
+struct fobos_cvt_pool_t;
+typedef void(*fobos_cvt_work_fn_t)(struct fobos_cvt_pool_t * pool, fobos_cvt_job_t * job);
+//==============================================================================
+struct fobos_cvt_pool_t
+{
+    uint32_t threads_count;
+    fobos_thread_t threads[FOBOS_MAX_CVT_THREADS];
+    fobos_cvt_worker_t workers[FOBOS_MAX_CVT_THREADS];
+    fobos_mutex_t lock;
+    fobos_cond_t start_cond;
+    fobos_cond_t done_cond;
+    uint32_t generation;
+    uint32_t pending;
+    int quit;
+    fobos_cvt_work_fn_t work;
+    fobos_cvt_fn_t cvt;
+    int format;
+    uint32_t jobs_count;
+    fobos_cvt_job_t jobs[FOBOS_MAX_CVT_THREADS];
+    float * h;
+    size_t h_size;
+    int h_dc_mode;
+    float h_k;
+    float h_tail[FOBOS_DC_SUBBLOCK];
+    float * tmp;
+    size_t tmp_size;
+};
+//==============================================================================
+FOBOS_THREAD_PROC(fobos_cvt_worker_proc, arg)
+{
+    fobos_cvt_worker_t * worker = (fobos_cvt_worker_t *)arg;
+    struct fobos_cvt_pool_t * pool = worker->pool;
+    uint32_t generation = 0;
+    fobos_mutex_lock(&pool->lock);
+    while (1)
+    {
+        while (!pool->quit && (pool->generation == generation))
+        {
+            fobos_cond_wait(&pool->start_cond, &pool->lock);
+        }
+        if (pool->quit)
+        {
+            break;
+        }
+        generation = pool->generation;
+        if (worker->index < pool->jobs_count)
+        {
+            fobos_cvt_job_t * job = &pool->jobs[worker->index];
+            fobos_mutex_unlock(&pool->lock);
+            pool->work(pool, job);
+            fobos_mutex_lock(&pool->lock);
+        }
+        pool->pending--;
+        if (pool->pending == 0)
+        {
+            fobos_cond_broadcast(&pool->done_cond);
+        }
+    }
+    fobos_mutex_unlock(&pool->lock);
+    FOBOS_THREAD_RETURN;
+}
+//==============================================================================
+static void fobos_cvt_pool_destroy(struct fobos_cvt_pool_t * pool)
+{
+    if (!pool)
+    {
+        return;
+    }
+    fobos_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    fobos_cond_broadcast(&pool->start_cond);
+    fobos_mutex_unlock(&pool->lock);
+    for (uint32_t i = 1; i < pool->threads_count; i++)
+    {
+        fobos_thread_join(pool->threads[i]);
+    }
+    fobos_cond_destroy(&pool->done_cond);
+    fobos_cond_destroy(&pool->start_cond);
+    fobos_mutex_destroy(&pool->lock);
+    free(pool->h);
+    free(pool->tmp);
+    free(pool);
+}
+//==============================================================================
+static struct fobos_cvt_pool_t * fobos_cvt_pool_create(uint32_t threads_count)
+{
+    struct fobos_cvt_pool_t * pool = (struct fobos_cvt_pool_t *)calloc(1, sizeof(struct fobos_cvt_pool_t));
+    if (!pool)
+    {
+        return NULL;
+    }
+    fobos_mutex_init(&pool->lock);
+    fobos_cond_init(&pool->start_cond);
+    fobos_cond_init(&pool->done_cond);
+    pool->h_dc_mode = -1;
+    pool->threads_count = 1; // the calling thread
+    for (uint32_t i = 1; i < threads_count; i++)
+    {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        if (fobos_thread_create(&pool->threads[i], fobos_cvt_worker_proc, &pool->workers[i]) != 0)
+        {
+            break;
+        }
+        pool->threads_count++;
+    }
+    if (pool->threads_count < 2)
+    {
+        fobos_cvt_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+//==============================================================================
+// unit initial state response of the DC filter over whole sub-blocks,
+// h[j] for j = 0 .. size - 1
+static int fobos_cvt_pool_response(struct fobos_cvt_pool_t * pool, int dc_mode, float k, size_t size)
+{
+    if ((pool->h_dc_mode == dc_mode) && (pool->h_k == k) && (pool->h_size >= size))
+    {
+        return 0;
+    }
+    float * h = (float *)realloc(pool->h, size * sizeof(float));
+    if (!h)
+    {
+        return -1;
+    }
+    pool->h = h;
+    pool->h_size = size;
+    pool->h_dc_mode = dc_mode;
+    pool->h_k = k;
+    if (dc_mode == FOBOS_DC_BLOCK)
+    {
+        double decay = pow(1.0 - k, (double)FOBOS_DC_SUBBLOCK);
+        double h0 = 1.0;
+        for (size_t i = 0; i < size; i += FOBOS_DC_SUBBLOCK)
+        {
+            double h1 = h0 * decay;
+            for (size_t j = 0; (j < FOBOS_DC_SUBBLOCK) && (i + j < size); j++)
+            {
+                h[i + j] = (float)(h0 + (h1 - h0) * (double)(j + 1) / (double)FOBOS_DC_SUBBLOCK);
+            }
+            h0 = h1;
+        }
+    }
+    else
+    {
+        double a = 1.0 - k;
+        double hj = 1.0;
+        for (size_t j = 0; j < size; j++)
+        {
+            hj *= a;
+            h[j] = (float)hj;
+        }
+    }
+    return 0;
+}
+//==============================================================================
+// block mode response over the partial last sub-block of n samples, tail
+// being its start: the kernel decays the state by (1 - k)^n over it
+static void fobos_cvt_pool_response_tail(struct fobos_cvt_pool_t * pool, float k, size_t tail, size_t n)
+{
+    double h0 = pow(1.0 - k, (double)tail);
+    double h1 = h0 * pow(1.0 - k, (double)n);
+    for (size_t j = 0; j < n; j++)
+    {
+        pool->h_tail[j] = (float)(h0 + (h1 - h0) * (double)(j + 1) / (double)n);
+    }
+}
+//==============================================================================
+static FOBOS_INLINE float fobos_cvt_pool_h(struct fobos_cvt_pool_t * pool, fobos_cvt_job_t * job, size_t j)
+{
+    return (j < job->tail) ? pool->h[j] : pool->h_tail[j - job->tail];
+}
+//==============================================================================
+// subtract d * h[j] from the float output of the slice while the term is
+// above FOBOS_CVT_POOL_EPS codes, h decays monotonically
+static void fobos_cvt_pool_correct(struct fobos_cvt_pool_t * pool, fobos_cvt_job_t * job)
+{
+    float * out = job->tmp ? job->tmp : (float *)job->dst;
+    for (size_t j = 0; j < job->count; j++)
+    {
+        float h = fobos_cvt_pool_h(pool, job, j);
+        if (job->d_max * h <= FOBOS_CVT_POOL_EPS)
+        {
+            break;
+        }
+        out[2 * j + 0] -= job->d_re * h;
+        out[2 * j + 1] -= job->d_im * h;
+    }
+}
+//==============================================================================
+static void fobos_cvt_pool_convert(struct fobos_cvt_pool_t * pool, fobos_cvt_job_t * job)
+{
+    pool->cvt(&job->st, job->src, job->tmp ? (void *)job->tmp : job->dst, job->count);
+}
+//==============================================================================
+static void fobos_cvt_pool_pack(struct fobos_cvt_pool_t * pool, fobos_cvt_job_t * job)
+{
+    fobos_cvt_pool_correct(pool, job);
+    if (pool->format == FOBOS_FORMAT_CS16)
+    {
+        fobos_pack_s16(job->tmp, (int16_t *)job->dst, 2 * job->count);
+    }
+    else
+    {
+        fobos_pack_s8(job->tmp, (int8_t *)job->dst, 2 * job->count);
+    }
+}
+//==============================================================================
+// runs work on every job, the calling thread takes the first one
+static void fobos_cvt_pool_dispatch(struct fobos_cvt_pool_t * pool, fobos_cvt_work_fn_t work)
+{
+    fobos_mutex_lock(&pool->lock);
+    pool->work = work;
+    pool->pending = pool->threads_count - 1;
+    pool->generation++;
+    fobos_cond_broadcast(&pool->start_cond);
+    fobos_mutex_unlock(&pool->lock);
+    work(pool, &pool->jobs[0]);
+    fobos_mutex_lock(&pool->lock);
+    while (pool->pending)
+    {
+        fobos_cond_wait(&pool->done_cond, &pool->lock);
+    }
+    fobos_mutex_unlock(&pool->lock);
+}
+//==============================================================================
+// cvt converts to the output format, cvt_f32 is the float kernel of the same
+// DC mode and swap, used for the integer formats
+static void fobos_cvt_pool_run(struct fobos_cvt_pool_t * pool, fobos_cvt_fn_t cvt, fobos_cvt_fn_t cvt_f32, int dc_mode, int format,
+                               fobos_cvt_state_t * st, const int16_t * src, void * dst, size_t count)
+{
+    size_t slice = (count + pool->threads_count - 1) / pool->threads_count;
+    slice = FOBOS_DC_SUBBLOCK * ((slice + FOBOS_DC_SUBBLOCK - 1) / FOBOS_DC_SUBBLOCK);
+    if ((slice >= count) || (fobos_cvt_pool_response(pool, dc_mode, st->k, slice) != 0))
+    {
+        cvt(st, src, dst, count);
+        return;
+    }
+    if ((format != FOBOS_FORMAT_CF32) && (pool->tmp_size < count))
+    {
+        float * tmp = (float *)realloc(pool->tmp, count * 2 * sizeof(float));
+        if (!tmp)
+        {
+            cvt(st, src, dst, count);
+            return;
+        }
+        pool->tmp = tmp;
+        pool->tmp_size = count;
+    }
+    uint32_t jobs_count = 0;
+    for (size_t offset = 0; offset < count; offset += slice)
+    {
+        fobos_cvt_job_t * job = &pool->jobs[jobs_count++];
+        job->src = src + 2 * offset;
+        job->dst = (uint8_t *)dst + offset * fobos_format_sample_size[format];
+        job->tmp = (format != FOBOS_FORMAT_CF32) ? pool->tmp + 2 * offset : NULL;
+        job->count = (count - offset < slice) ? count - offset : slice;
+        job->tail = job->count;
+        job->d_re = 0.0f;
+        job->d_im = 0.0f;
+        job->d_max = 0.0f;
+        job->st = *st;
+    }
+    // only the last slice may end in a partial sub-block
+    fobos_cvt_job_t * last = &pool->jobs[jobs_count - 1];
+    size_t partial = last->count % FOBOS_DC_SUBBLOCK;
+    if ((dc_mode == FOBOS_DC_BLOCK) && partial)
+    {
+        last->tail = last->count - partial;
+        fobos_cvt_pool_response_tail(pool, st->k, last->tail, partial);
+    }
+    pool->cvt = (format != FOBOS_FORMAT_CF32) ? cvt_f32 : cvt;
+    pool->format = format;
+    pool->jobs_count = jobs_count;
+    fobos_cvt_pool_dispatch(pool, fobos_cvt_pool_convert);
+    // chain the true initial states, the first slice started from the true one
+    float dc_re = pool->jobs[0].st.dc_re;
+    float dc_im = pool->jobs[0].st.dc_im;
+    for (uint32_t i = 1; i < jobs_count; i++)
+    {
+        fobos_cvt_job_t * job = &pool->jobs[i];
+        float d_re = dc_re - st->dc_re;
+        float d_im = dc_im - st->dc_im;
+        float h_end = fobos_cvt_pool_h(pool, job, job->count - 1);
+        job->d_re = d_re * st->scale_re;
+        job->d_im = d_im * st->scale_im;
+        job->d_max = (fabsf(d_re) > fabsf(d_im)) ? fabsf(d_re) : fabsf(d_im);
+        dc_re = job->st.dc_re + d_re * h_end;
+        dc_im = job->st.dc_im + d_im * h_end;
+    }
+    st->dc_re = dc_re;
+    st->dc_im = dc_im;
+    if (format != FOBOS_FORMAT_CF32)
+    {
+        fobos_cvt_pool_dispatch(pool, fobos_cvt_pool_pack);
+        return;
+    }
+    for (uint32_t i = 1; i < jobs_count; i++)
+    {
+        fobos_cvt_pool_correct(pool, &pool->jobs[i]);
+    }
+}
+//==============================================================================
+static void fobos_cvt_pool_start(struct fobos_dev_t * dev)
+{
+    if ((dev->cvt_threads_count > 1) && !dev->cvt_pool)
+    {
+        dev->cvt_pool = fobos_cvt_pool_create(dev->cvt_threads_count);
+#ifdef FOBOS_PRINT_DEBUG
+        printf_internal("conversion threads %d\n", dev->cvt_pool ? dev->cvt_pool->threads_count : 1);
+#endif // FOBOS_PRINT_DEBUG
+    }
+}
+//==============================================================================
+static void fobos_cvt_pool_stop(struct fobos_dev_t * dev)
+{
+    fobos_cvt_pool_destroy(dev->cvt_pool);
+    dev->cvt_pool = NULL;
+}
+//==============================================================================
+// IQ amplitude calibration
+// The ratio of the mean absolute deviations of I and Q is smoothed over the
+// calibration runs and published to rx_scale_im. With the background mode the
+// streaming thread only copies the calibration slice and reads the scale. The
+// mode may change while streaming, so a background run and an inline one may
+// overlap: the smoothed pair lives in one 64-bit word updated by a CAS loop and
+// the scale is always derived from a consistent pair.
+//==============================================================================
+typedef union fobos_cal_avg_t
+{
+    struct
+    {
+        float re;
+        float im;
+    } f;
+    int64_t i;
+} fobos_cal_avg_t;
+//==============================================================================
+void fobos_rx_calibrate(struct fobos_dev_t * dev, void * data, size_t size, uint32_t elapsed)
+{
+    size_t complex_samples_count = size / 4;
+    if (complex_samples_count == 0)
+    {
+        return;
+    }
+    const int16_t * psample = (const int16_t *)data;
+    size_t count = 4 * (complex_samples_count / 4);
+    int64_t summ_re = 0ll;
+    int64_t summ_im = 0ll;
+    fobos_cal_sum(psample, count, &summ_re, &summ_im);
+    summ_re /= (int64_t)complex_samples_count;
+    summ_im /= (int64_t)complex_samples_count;
+    int16_t avg_re = (int16_t)summ_re;
+    int16_t avg_im = (int16_t)summ_im;
+    fobos_cal_absdev(psample, count, avg_re, avg_im, &summ_re, &summ_im);
+    // keep the smoothing time constant in buffers when calibrating every n buffers
+    float alpha = (elapsed > 1) ? 1.0f - powf(0.999f, (float)elapsed) : 0.001f;
+    fobos_cal_avg_t prev;
+    fobos_cal_avg_t avg;
+    do
+    {
+        prev.i = fobos_atomic_load64(&dev->rx_avg);
+        avg.f.re = prev.f.re + alpha * ((float)summ_re - prev.f.re);
+        avg.f.im = prev.f.im + alpha * ((float)summ_im - prev.f.im);
+    } while (!fobos_atomic_cas64(&dev->rx_avg, prev.i, avg.i));
+    if ((avg.f.re > 0.0f) && (avg.f.im > 0.0f) && !dev->rx_direct_sampling)
+    {
+        float ratio = avg.f.re / avg.f.im;
+#ifdef FOBOS_PRINT_DEBUG
+        if (dev->cal_count % 128 == 0)
+        {
+            printf_internal("re/im scale = %f\n", ratio);
+        }
+#endif // FOBOS_PRINT_DEBUG
+        if ((ratio < 1.6f) && (ratio > 0.625f))
+        {
+            fobos_atomic_store_float(&dev->rx_scale_im, dev->rx_scale_re * ratio);
+        }
+    }
+    dev->cal_count++;
+}
+//==============================================================================
+FOBOS_THREAD_PROC(fobos_rx_cal_thread, arg)
+{
+    struct fobos_dev_t * dev = (struct fobos_dev_t *)arg;
+    fobos_mutex_lock(&dev->cal_lock);
+    while (!dev->cal_quit)
+    {
+        if (fobos_atomic_load(&dev->cal_busy))
+        {
+            fobos_mutex_unlock(&dev->cal_lock);
+            fobos_rx_calibrate(dev, dev->cal_buf, dev->cal_buf_length, dev->cal_buf_elapsed);
+            fobos_atomic_store(&dev->cal_busy, 0);
+            fobos_mutex_lock(&dev->cal_lock);
+            continue;
+        }
+        fobos_cond_wait(&dev->cal_cond, &dev->cal_lock);
+    }
+    fobos_mutex_unlock(&dev->cal_lock);
+    FOBOS_THREAD_RETURN;
+}
+//==============================================================================
+static void fobos_rx_cal_start(struct fobos_dev_t * dev)
+{
+    dev->cal_elapsed = 0;
+    dev->cal_last_ns = 0;
+    dev->cal_running = 0;
+    dev->cal_quit = 0;
+    fobos_atomic_store(&dev->cal_busy, 0);
+    if (dev->cal_mode != FOBOS_CAL_BACKGROUND)
+    {
+        return;
+    }
+    dev->cal_buf_size = dev->transfer_buf_size / 16;
+    dev->cal_buf = (int16_t *)malloc(dev->cal_buf_size);
+    if (!dev->cal_buf)
+    {
+        return;
+    }
+    fobos_mutex_init(&dev->cal_lock);
+    fobos_cond_init(&dev->cal_cond);
+    if (fobos_thread_create(&dev->cal_thread, fobos_rx_cal_thread, dev) != 0)
+    {
+        fobos_cond_destroy(&dev->cal_cond);
+        fobos_mutex_destroy(&dev->cal_lock);
+        free(dev->cal_buf);
+        dev->cal_buf = NULL;
+        return;
+    }
+    dev->cal_running = 1;
+}
+//==============================================================================
+static void fobos_rx_cal_stop(struct fobos_dev_t * dev)
+{
+    if (!dev->cal_running)
+    {
+        return;
+    }
+    fobos_mutex_lock(&dev->cal_lock);
+    dev->cal_quit = 1;
+    fobos_cond_broadcast(&dev->cal_cond);
+    fobos_mutex_unlock(&dev->cal_lock);
+    fobos_thread_join(dev->cal_thread);
+    fobos_cond_destroy(&dev->cal_cond);
+    fobos_mutex_destroy(&dev->cal_lock);
+    free(dev->cal_buf);
+    dev->cal_buf = NULL;
+    dev->cal_running = 0;
+}
+//==============================================================================
+static void fobos_rx_calibrate_step(struct fobos_dev_t * dev, void * data, size_t size)
+{
+    dev->cal_elapsed++;
+    if ((dev->cal_mode == FOBOS_CAL_OFF) || (dev->cal_elapsed < dev->cal_interval))
+    {
+        return;
+    }
+    uint64_t now = 0;
+    if (dev->cal_interval_ms)
+    {
+        now = fobos_time_ns();
+        if (now - dev->cal_last_ns < (uint64_t)dev->cal_interval_ms * 1000000ull)
+        {
+            return;
+        }
+    }
+    if (dev->cal_running && (dev->cal_mode == FOBOS_CAL_BACKGROUND))
+    {
+        if (fobos_atomic_load(&dev->cal_busy))
+        {
+            return; // the previous run is not finished yet, retry with the next buffer
+        }
+        dev->cal_buf_length = (size < dev->cal_buf_size) ? size : dev->cal_buf_size;
+        memcpy(dev->cal_buf, data, dev->cal_buf_length);
+        dev->cal_buf_elapsed = dev->cal_elapsed;
+        fobos_atomic_store(&dev->cal_busy, 1);
+        fobos_mutex_lock(&dev->cal_lock);
+        fobos_cond_broadcast(&dev->cal_cond);
+        fobos_mutex_unlock(&dev->cal_lock);
+    }
+    else
+    {
+        fobos_rx_calibrate(dev, data, size, dev->cal_elapsed);
+    }
+    dev->cal_elapsed = 0;
+    dev->cal_last_ns = now;
+}
+//==============================================================================
+#define FOBOS_SWAP_IQ_HW 1
+// the converter iq order of a band
+static int fobos_rx_cvt_swap(struct fobos_dev_t * dev, int swap_iq)
+{
+    return dev->rx_direct_sampling ? FOBOS_SWAP_IQ_HW : (swap_iq ^ FOBOS_SWAP_IQ_HW);
+}
+//==============================================================================
+static void fobos_rx_cvt_select(struct fobos_dev_t * dev)
+{
+    dev->rx_cvt_sel.dc_mode = dev->rx_dc_mode;
+    dev->rx_cvt_sel.swap_iq = fobos_rx_cvt_swap(dev, dev->rx_swap_iq);
+    dev->rx_cvt_sel.calibrate = !dev->rx_direct_sampling;
+}
+//==============================================================================
+void fobos_rx_convert_samples(struct fobos_dev_t * dev, const struct fobos_rx_cvt_sel_t * sel, void * data, size_t size, void * dst_samples)
+{
+    size_t complex_samples_count = size / 4;
+    fobos_cvt_state_t st;
+    st.k = 0.0004f; // ~ play around
+    st.scale_re = 1.0f / 32768.0f;
+    st.scale_im = 1.0f / 32768.0f;
+    if (sel->calibrate)
+    {
+        fobos_rx_calibrate_step(dev, data, size / 16);
+        st.scale_re = dev->rx_scale_re;
+        st.scale_im = fobos_atomic_load_float(&dev->rx_scale_im);
+    }
+#ifdef FOBOS_PRINT_DEBUG
+    if (dev->rx_buff_counter % 256 == 0)
+    {
+        print_buff(data, 64);
+    }
+#endif // FOBOS_PRINT_DEBUG
+    st.dc_re = dev->rx_dc_re;
+    st.dc_im = dev->rx_dc_im;
+    st.scale_re *= fobos_format_full_scale[dev->rx_format];
+    st.scale_im *= fobos_format_full_scale[dev->rx_format];
+    fobos_cvt_fn_t cvt = fobos_cvt_select(sel->dc_mode, sel->swap_iq, dev->rx_format);
+    if (dev->cvt_pool)
+    {
+        fobos_cvt_fn_t cvt_f32 = fobos_cvt_select(sel->dc_mode, sel->swap_iq, FOBOS_FORMAT_CF32);
+        fobos_cvt_pool_run(dev->cvt_pool, cvt, cvt_f32, sel->dc_mode, dev->rx_format, &st, (const int16_t *)data, dst_samples, complex_samples_count);
+    }
+    else
+    {
+        cvt(&st, (const int16_t *)data, dst_samples, complex_samples_count);
+    }
+    dev->rx_dc_re = st.dc_re;
+    dev->rx_dc_im = st.dc_im;
+}
+//==============================================================================
+// Buffer arena
+// The transfer buffers and the conversion buffer are carved from one page
+// aligned block. The block is kept from one stream to the next and released on
+// close, or replaced when a larger one or other options are needed. Optionally
+// it is backed by huge pages, locked in memory and prefaulted, so the first
+// seconds of a capture take no page faults.
+//==============================================================================
+#define FOBOS_ARENA_PAGE_SIZE   4096
+#define FOBOS_ARENA_HUGE_SIZE   (2 * 1024 * 1024)
+static void fobos_arena_release(struct fobos_dev_t * dev)
+{
+    if (!dev->arena)
+    {
+        return;
+    }
+#ifdef _WIN32
+    VirtualFree(dev->arena, 0, MEM_RELEASE);
+#else
+    munmap(dev->arena, dev->arena_size);
+#endif
+    dev->arena = NULL;
+    dev->arena_size = 0;
+}
+//==============================================================================
+static uint8_t * fobos_arena_reserve(struct fobos_dev_t * dev, size_t size)
+{
+    unsigned int flags = dev->arena_flags;
+    if (dev->arena && (dev->arena_size >= size) && (dev->arena_used_flags == flags))
+    {
+        return dev->arena;
+    }
+    fobos_arena_release(dev);
+    size_t page = (flags & (FOBOS_ARENA_HUGE_THP | FOBOS_ARENA_HUGE_TLB)) ? FOBOS_ARENA_HUGE_SIZE : FOBOS_ARENA_PAGE_SIZE;
+    size_t length = (size + page - 1) / page * page;
+    void * mem = NULL;
+#ifdef _WIN32
+    if (flags & FOBOS_ARENA_HUGE_TLB)
+    {
+        SIZE_T large = GetLargePageMinimum();
+        if (large)
+        {
+            SIZE_T large_length = (size + large - 1) / large * large;
+            mem = VirtualAlloc(NULL, large_length, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+            if (mem)
+            {
+                length = large_length;
+            }
+        }
+        if (!mem)
+        {
+            printf_internal("No large pages, falling back to normal pages\n");
+        }
+    }
+    if (!mem)
+    {
+        mem = VirtualAlloc(NULL, length, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+#else
+#ifdef MAP_HUGETLB
+    if (flags & FOBOS_ARENA_HUGE_TLB)
+    {
+        mem = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem == MAP_FAILED)
+        {
+            printf_internal("No huge pages reserved, falling back to normal pages\n");
+            mem = NULL;
+        }
+    }
+#endif // MAP_HUGETLB
+    if (!mem)
+    {
+        mem = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED)
+        {
+            mem = NULL;
+        }
+#ifdef MADV_HUGEPAGE
+        if (mem && (flags & FOBOS_ARENA_HUGE_THP))
+        {
+            madvise(mem, length, MADV_HUGEPAGE);
+        }
+#endif // MADV_HUGEPAGE
+    }
+#endif // _WIN32
+    if (!mem)
+    {
+        return NULL;
+    }
+    if (flags & FOBOS_ARENA_MLOCK)
+    {
+#ifdef _WIN32
+        if (!VirtualLock(mem, length))
+#else
+        if (mlock(mem, length) != 0)
+#endif
+        {
+            printf_internal("Failed to lock the buffers in memory\n");
+        }
+    }
+    if (flags & FOBOS_ARENA_PREFAULT)
+    {
+        volatile uint8_t * p = (volatile uint8_t *)mem;
+        for (size_t i = 0; i < length; i += FOBOS_ARENA_PAGE_SIZE)
+        {
+            p[i] = 0;
+        }
+    }
+    dev->arena = (uint8_t *)mem;
+    dev->arena_size = length;
+    dev->arena_used_flags = flags;
+    return dev->arena;
+}
+//==============================================================================
+// on failure everything allocated here is released again
+int fobos_alloc_buffers(struct fobos_dev_t *dev)
+{
+    int result = fobos_check(dev);
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (dev->transfer_buf)
+    {
+        return FOBOS_ERR_NO_MEM;        // the buffers of a stream still in use
+    }
+    if (!dev->transfer)
+    {
+        dev->transfer = (struct libusb_transfer **)calloc(dev->transfer_buf_count, sizeof(struct libusb_transfer *));
+        if (!dev->transfer)
+        {
+            return FOBOS_ERR_NO_MEM;
+        }
+        for (size_t i = 0; i < dev->transfer_buf_count; i++)
+        {
+            dev->transfer[i] = libusb_alloc_transfer(0);
+            if (!dev->transfer[i])
+            {
+                fobos_free_buffers(dev);
+                return FOBOS_ERR_NO_MEM;
+            }
+        }
+    }
+    uint32_t buf_count = dev->transfer_buf_count + dev->transfer_spare_count;
+    dev->transfer_buf = (unsigned char **)calloc(buf_count, sizeof(unsigned char *));
+    if (!dev->transfer_buf)
+    {
+        fobos_free_buffers(dev);
+        return FOBOS_ERR_NO_MEM;
+    }
+#if defined(ENABLE_ZEROCOPY) && defined (__linux__) && LIBUSB_API_VERSION >= 0x01000105
+    printf_internal("Allocating %d zero-copy buffers\n", buf_count);
+    dev->use_zerocopy = 1;
+    for (size_t i = 0; i < buf_count; ++i)
+    {
+        dev->transfer_buf[i] = libusb_dev_mem_alloc(dev->libusb_devh, dev->transfer_buf_size);
+        if (dev->transfer_buf[i])
+        {
+            if (dev->transfer_buf[i][0] || memcmp(dev->transfer_buf[i],
+                dev->transfer_buf[i] + 1,
+                dev->transfer_buf_size - 1))
+            {
+                printf_internal("Kernel usbfs mmap() bug, falling back to buffers\n");
+                dev->use_zerocopy = 0;
+                break;
+            }
+        }
+        else
+        {
+            printf_internal("Failed to allocate zero-copy buffer for transfer %d\n", i);
+            dev->use_zerocopy = 0;
+            break;
+        }
+    }
+    if (!dev->use_zerocopy)
+    {
+        for (size_t i = 0; i < buf_count; ++i)
+        {
+            if (dev->transfer_buf[i])
+            {
+                libusb_dev_mem_free(dev->libusb_devh, dev->transfer_buf[i], dev->transfer_buf_size);
+            }
+        }
+    }
+#endif
+    // the conversion buffer (or the frame store) first, the transfer buffers follow
+    size_t cvt_length = dev->frame_capacity ? dev->frame_capacity : dev->transfer_buf_size / 4;
+    size_t cvt_size = cvt_length * fobos_format_sample_size[dev->rx_format];
+    cvt_size = (cvt_size + 511) & ~(size_t)511;
+    size_t arena_size = cvt_size + (dev->use_zerocopy ? 0 : (size_t)buf_count * dev->transfer_buf_size);
+    uint8_t * arena = fobos_arena_reserve(dev, arena_size);
+    if (!arena)
+    {
+        fobos_free_buffers(dev);
+        return FOBOS_ERR_NO_MEM;
+    }
+    dev->rx_buff = arena;
+    if (!dev->use_zerocopy)
+    {
+        for (size_t i = 0; i < buf_count; ++i)
+        {
+            dev->transfer_buf[i] = arena + cvt_size + i * dev->transfer_buf_size;
+        }
+    }
+    dev->rx_bufs = (struct fobos_rx_buf_t *)calloc(buf_count, sizeof(struct fobos_rx_buf_t));
+    dev->rx_xfers = (struct fobos_rx_xfer_t *)calloc(dev->transfer_buf_count, sizeof(struct fobos_rx_xfer_t));
+    if (!dev->rx_bufs || !dev->rx_xfers)
+    {
+        fobos_free_buffers(dev);
+        return FOBOS_ERR_NO_MEM;
+    }
+    for (size_t i = 0; i < buf_count; ++i)
+    {
+        dev->rx_bufs[i].data = dev->transfer_buf[i];
+    }
+    for (size_t i = 0; i < dev->transfer_buf_count; ++i)
+    {
+        dev->rx_xfers[i].dev = dev;
+        dev->rx_xfers[i].buf = &dev->rx_bufs[i];
+    }
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+int fobos_free_buffers(struct fobos_dev_t *dev)
+{
+    int result = fobos_check(dev);
+    if (result != 0)
+    {
+        return result;
+    }
+    if (dev->transfer)
+    {
+        for (size_t i = 0; i < dev->transfer_buf_count; ++i)
+        {
+            if (dev->transfer[i])
+            {
+                libusb_free_transfer(dev->transfer[i]);
+            }
+        }
+        free(dev->transfer);
+        dev->transfer = NULL;
+    }
+    if (dev->transfer_buf)
+    {
+        for (size_t i = 0; i < dev->transfer_buf_count + dev->transfer_spare_count; ++i)
+        {
+            if (dev->transfer_buf[i])
+            {
+                if (dev->use_zerocopy)
+                {
+#if defined (__linux__) && LIBUSB_API_VERSION >= 0x01000105
+                    libusb_dev_mem_free(dev->libusb_devh, dev->transfer_buf[i], dev->transfer_buf_size);
+#endif
+                }
+            }
+        }
+        free(dev->transfer_buf);
+        dev->transfer_buf = NULL;
+    }
+    free(dev->rx_bufs);
+    dev->rx_bufs = NULL;
+    free(dev->rx_xfers);
+    dev->rx_xfers = NULL;
+    dev->rx_buff = NULL;                // in the arena, kept for the next stream
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+// Transfers that could not be reaped may still be completed by libusb and
+// written into their buffers, leases not returned may still be read by the
+// application, so nothing they reference may be released or reused: the
+// transfers, the buffers and the arena are abandoned instead.
+static void fobos_abandon_buffers(struct fobos_dev_t * dev)
+{
+    dev->transfer = NULL;
+    dev->transfer_buf = NULL;
+    dev->rx_bufs = NULL;
+    dev->rx_xfers = NULL;
+    dev->rx_buff = NULL;
+    dev->arena = NULL;
+    dev->arena_size = 0;
+}
+//==============================================================================
+// Buffer metadata
+// The sample index counts every sample the device has sent, including the ones
+// lost. The completion lateness against the sample clock is measured from the
+// earliest completion seen. A host stall delays a few completions and the
+// transfers in flight catch up afterwards, while lost samples leave every
+// following completion late. So a gap is reported when the whole window of
+// completions (transfers in flight + 1) stays late by more than half a buffer,
+// the lateness estimates the lost samples count.
+//==============================================================================
+// settings reported by the metadata from now on
+static void fobos_rx_meta_config(struct fobos_dev_t * dev)
+{
+    dev->meta_config_id = dev->cfg_id;
+    dev->meta_frequency = dev->rx_frequency;
+    dev->meta_samplerate = dev->rx_samplerate;
+    dev->meta_lna_gain = dev->rx_lna_gain;
+    dev->meta_vga_gain = dev->rx_vga_gain;
+}
+//==============================================================================
+static void fobos_rx_meta_reset(struct fobos_dev_t * dev, uint32_t window)
+{
+    memset(&dev->rx_meta, 0, sizeof(dev->rx_meta));
+    dev->meta_index = 0;
+    dev->meta_lost = 0;
+    dev->meta_flags = 0;
+    dev->meta_next = 0;
+    dev->meta_t0 = fobos_time_ns();
+    dev->meta_last_ns = dev->meta_t0;
+    dev->meta_count = 0;
+    dev->meta_window = window;
+    dev->meta_win_count = 0;
+    dev->meta_base = 0.0;
+    dev->meta_win_min = 0.0;
+    dev->cfg_pending = 0;
+    fobos_rx_meta_config(dev);
+}
+//==============================================================================
+static void fobos_rx_meta_short(struct fobos_dev_t * dev, uint32_t count)
+{
+    dev->meta_flags |= FOBOS_META_SHORT;
+    dev->meta_lost += count;
+    dev->meta_index += count;
+    fobos_stat_add(&dev->rx_stats.lost_samples, count);
+}
+//==============================================================================
+static void fobos_rx_meta_stamp(struct fobos_dev_t * dev, struct fobos_rx_meta_t * meta, uint32_t count)
+{
+    uint64_t now = fobos_time_ns();
+    meta->flags = dev->meta_flags;
+    meta->lost_samples = dev->meta_lost;
+    dev->meta_flags = 0;
+    dev->meta_lost = 0;
+    double samplerate = dev->rx_samplerate;
+    if (samplerate > 0.0)
+    {
+        double late = (double)(now - dev->meta_t0) * 1e-9 - (double)(dev->meta_index + count) / samplerate;
+        if ((dev->meta_count == 0) || (late < dev->meta_base))
+        {
+            dev->meta_base = late;
+        }
+        late -= dev->meta_base;
+        fobos_stat_max32(&dev->rx_stats.max_jitter_us, (uint32_t)(late * 1e6));
+        if ((dev->meta_win_count == 0) || (late < dev->meta_win_min))
+        {
+            dev->meta_win_min = late;
+        }
+        dev->meta_win_count++;
+        if (dev->meta_win_count >= dev->meta_window)
+        {
+            if (dev->meta_win_min * samplerate > 0.5 * count)
+            {
+                uint64_t gap = (uint64_t)(dev->meta_win_min * samplerate + 0.5);
+                meta->flags |= FOBOS_META_GAP;
+                meta->lost_samples += gap;
+                dev->meta_index += gap;
+                fobos_stat_add(&dev->rx_stats.gaps, 1);
+                fobos_stat_add(&dev->rx_stats.lost_samples, gap);
+            }
+            else
+            {
+                // follow a slow drift of the device clock
+                dev->meta_base += dev->meta_win_min * 0.125;
+            }
+            dev->meta_win_count = 0;
+        }
+    }
+    dev->meta_count++;
+    dev->meta_last_ns = now;
+    if (dev->cfg_pending && !fobos_atomic_load(&dev->cfg_txn) && (dev->meta_index >= dev->cfg_index))
+    {
+        dev->cfg_pending = 0;
+        fobos_rx_meta_config(dev);
+        meta->flags |= FOBOS_META_CONFIG;
+    }
+    meta->sample_index = dev->meta_index;
+    meta->timestamp_ns = now;
+    meta->frequency = dev->meta_frequency;
+    meta->samplerate = dev->meta_samplerate;
+    meta->lna_gain = dev->meta_lna_gain;
+    meta->vga_gain = dev->meta_vga_gain;
+    meta->config_id = dev->meta_config_id;
+    dev->meta_index += count;
+}
+//==============================================================================
+// Ring pull mode
+// The ring is an arena of slots, one converted buffer each. The streaming side
+// takes a free slot, converts straight into it and queues it as filled. The
+// reader owns one slot at a time and returns the spans from it, the slot goes
+// back to the free queue on the read that moves past it. When no free slot is
+// left FOBOS_RING_DROP_NEWEST drops the incoming buffer and
+// FOBOS_RING_DROP_OLDEST takes back the oldest filled slot. Both sides pop the
+// filled queue with a CAS, so the slot held by the reader is never overwritten.
+// The streaming side takes the lock only to wake a reader that sleeps on an
+// empty ring.
+//==============================================================================
+struct fobos_rx_ring_t
+{
+    uint8_t * arena;
+    uint32_t slots_count;
+    uint32_t slot_length;   // complex samples
+    uint32_t sample_size;
+    int format;
+    int policy;
+    fobos_spsc_t free;      // reader -> streaming side
+    fobos_spsc_t filled;    // streaming side -> reader
+    uint8_t * held;
+    uint32_t held_offset;
+    struct fobos_rx_meta_t * metas;     // per slot
+    struct fobos_rx_meta_t held_meta;
+    uint32_t span_offset;
+    uint64_t next_index;
+    fobos_mutex_t lock;
+    fobos_cond_t cond;
+    fobos_atomic_t waiting;  // the reader sleeps on cond
+    fobos_atomic_t stop;     // fobos_rx_ring_stop() was called
+    fobos_thread_t thread;
+    int finished;
+    int result;
+};
+//==============================================================================
+static void fobos_rx_ring_put(struct fobos_dev_t * dev, const struct fobos_rx_buf_t * buf, int length)
+{
+    struct fobos_rx_ring_t * ring = dev->rx_ring;
+    uint8_t * slot = (uint8_t *)fobos_spsc_pop(&ring->free);
+    if (!slot && (ring->policy == FOBOS_RING_DROP_OLDEST))
+    {
+        slot = (uint8_t *)fobos_spsc_pop_shared(&ring->filled);
+        if (slot)
+        {
+            fobos_stat_add(&dev->rx_stats.ring_dropped, ring->slot_length);
+        }
+    }
+    if (!slot)
+    {
+        fobos_stat_add(&dev->rx_stats.ring_dropped, length / 4);
+        return;
+    }
+    fobos_rx_convert_samples(dev, &buf->cvt, buf->data, length, slot);
+    ring->metas[(slot - ring->arena) / ((size_t)ring->slot_length * ring->sample_size)] = buf->meta;
+    fobos_spsc_push(&ring->filled, slot);
+    fobos_atomic_fence();
+    if (fobos_atomic_load(&ring->waiting))
+    {
+        fobos_mutex_lock(&ring->lock);
+        fobos_cond_broadcast(&ring->cond);
+        fobos_mutex_unlock(&ring->lock);
+    }
+    fobos_stat_add(&dev->rx_stats.buffers, 1);
+}
+//==============================================================================
+// Callback framing
+// The converted stream is re-blocked into frames of frame_length samples, one
+// every frame_hop samples, independent of the transfer length. The converter
+// writes straight into the frame store, which takes the place of the
+// conversion buffer, and a frame is passed to the callback in place, so the
+// overlapping part of the frames is neither converted nor copied twice. When
+// the store has no room for the next buffer the leftover of less than a frame
+// is moved to the store start. The store holds four frames and four transfers,
+// so that happens at most once every three frames and three transfers. A frame
+// never spans a short transfer, a gap or a dropped buffer: the partial frame is
+// discarded and framing restarts at the next buffer.
+//==============================================================================
+static void fobos_rx_frame_reset(struct fobos_dev_t * dev)
+{
+    dev->frame_start = 0;
+    dev->frame_end = 0;
+    dev->frame_skip = 0;
+    dev->frame_flags = 0;
+    dev->frame_lost = 0;
+}
+//==============================================================================
+static void fobos_rx_frame_buffer(struct fobos_dev_t * dev, struct fobos_rx_buf_t * buf, int length)
+{
+    uint32_t count = length / 4;
+    struct fobos_rx_meta_t * meta = &buf->meta;
+    size_t sample_size = fobos_format_sample_size[dev->rx_format];
+    uint8_t * store = (uint8_t *)dev->rx_buff;
+    const unsigned char * data = buf->data;
+    if (meta->flags & (FOBOS_META_SHORT | FOBOS_META_GAP | FOBOS_META_DROPPED | FOBOS_META_SEGMENT_START))
+    {
+        dev->frame_start = 0;
+        dev->frame_end = 0;
+        dev->frame_skip = 0;
+    }
+    // a frame cannot tell it is the last one of a hop segment
+    dev->frame_flags |= meta->flags & ~FOBOS_META_SEGMENT_END;
+    dev->frame_lost += meta->lost_samples;
+    if (dev->frame_skip >= count)
+    {
+        dev->frame_skip -= count;
+        return;
+    }
+    data += dev->frame_skip * 4;
+    count -= dev->frame_skip;
+    if (dev->frame_end == 0)
+    {
+        dev->frame_index = meta->sample_index + dev->frame_skip;
+    }
+    dev->frame_skip = 0;
+    if (dev->frame_end + count > dev->frame_capacity)
+    {
+        uint32_t left = dev->frame_end - dev->frame_start;
+        memmove(store, store + dev->frame_start * sample_size, left * sample_size);
+        dev->frame_index += dev->frame_start;
+        dev->frame_start = 0;
+        dev->frame_end = left;
+        fobos_stat_add(&dev->rx_stats.frame_carried, left);
+    }
+    fobos_rx_convert_samples(dev, &buf->cvt, (void *)data, count * 4, store + dev->frame_end * sample_size);
+    dev->frame_end += count;
+    while (dev->frame_start + dev->frame_length <= dev->frame_end)
+    {
+        void * frame = store + dev->frame_start * sample_size;
+        struct fobos_rx_meta_t frame_meta = *meta;
+        frame_meta.sample_index = dev->frame_index + dev->frame_start;
+        frame_meta.flags = dev->frame_flags;
+        frame_meta.lost_samples = dev->frame_lost;
+        dev->frame_flags = 0;
+        dev->frame_lost = 0;
+        dev->rx_meta = frame_meta;
+        if (dev->rx_meta_cb)
+        {
+            dev->rx_meta_cb(frame, dev->frame_length, dev->rx_format, &frame_meta, dev->rx_cb_ctx);
+        }
+        else if (dev->rx_fmt_cb)
+        {
+            dev->rx_fmt_cb(frame, dev->frame_length, dev->rx_format, dev->rx_cb_ctx);
+        }
+        else if (dev->rx_cb)
+        {
+            dev->rx_cb((float *)frame, dev->frame_length, dev->rx_cb_ctx);
+        }
+        fobos_stat_add(&dev->rx_stats.frames, 1);
+        dev->frame_start += dev->frame_hop;
+    }
+    if (dev->frame_start >= dev->frame_end)
+    {
+        dev->frame_skip = dev->frame_start - dev->frame_end;
+        dev->frame_start = 0;
+        dev->frame_end = 0;
+    }
+}
+//==============================================================================
+// Frequency hopping
+// The stream walks a schedule of tuning plans, each held for its dwell. The
+// buffers are tagged in completion order on the usb side: a segment takes the
+// buffers from its first sample on, the buffer that reaches the dwell is its
+// last one and is flagged FOBOS_META_SEGMENT_END. The retune is done by the
+// streaming thread between the event handling passes, as the queued control
+// commands, so a segment ends on a buffer boundary and may run past its dwell
+// by the buffers completed in the same pass. The next segment starts one
+// transfer length past the sample index the usb side has reached after the
+// retune (the samples in flight may be of either frequency) plus the settling
+// interval. The samples in between are dropped, the first delivered buffer of
+// a segment is flagged FOBOS_META_SEGMENT_START and every delivered buffer
+// carries the frequency, the schedule entry and the first sample index of its
+// segment. The iq order of the segment plan is stamped on its buffers, so the
+// ones still queued for the processing thread after the next retune are not
+// converted in the order of the next band.
+//==============================================================================
+// the stream starts at the first entry, settle samples after the start
+static void fobos_rx_hop_reset(struct fobos_dev_t * dev)
+{
+    dev->hop_pos = 0;
+    dev->hop_start = dev->hop_settle;
+    dev->hop_captured = 0;
+    dev->hop_closed = 0;
+    dev->hop_failing = 0;
+    dev->hop_flags = 0;
+    dev->hop_lost = 0;
+    if (dev->hop_count)
+    {
+        if (fobos_rx_plan_load(dev, &dev->hop_plans[0]) != FOBOS_ERR_OK)
+        {
+            printf_internal("Failed to tune to the first hop\n");
+        }
+        fobos_rx_meta_config(dev);
+    }
+}
+//==============================================================================
+// usb side, right after the buffer is stamped
+static void fobos_rx_hop_stamp(struct fobos_dev_t * dev, struct fobos_rx_buf_t * buf, uint32_t count)
+{
+    struct fobos_rx_meta_t * meta = &buf->meta;
+    uint64_t first = meta->sample_index;
+    uint64_t end = first + count;
+    if (dev->hop_closed || (end <= dev->hop_start))
+    {
+        buf->skip = count;
+        fobos_stat_add(&dev->rx_stats.hop_dead_samples, count);
+        return;
+    }
+    buf->skip = (first < dev->hop_start) ? (uint32_t)(dev->hop_start - first) : 0;
+    fobos_stat_add(&dev->rx_stats.hop_dead_samples, buf->skip);
+    meta->frequency = dev->hop_plans[dev->hop_pos].actual;
+    meta->hop_index = dev->hop_pos;
+    meta->segment_start = dev->hop_start;
+    buf->cvt.swap_iq = fobos_rx_cvt_swap(dev, dev->hop_plans[dev->hop_pos].swap_iq);
+    if (dev->hop_captured == 0)
+    {
+        meta->flags |= FOBOS_META_SEGMENT_START;
+    }
+    dev->hop_captured += count - buf->skip;
+    uint32_t dwell = dev->hop_dwells[dev->hop_pos];
+    if (end >= dev->hop_start + dwell)
+    {
+        meta->flags |= FOBOS_META_SEGMENT_END;
+        fobos_stat_add(&dev->rx_stats.hop_dwell_requested, dwell);
+        fobos_stat_add(&dev->rx_stats.hop_dwell_achieved, dev->hop_captured);
+        dev->hop_closed = 1;
+    }
+}
+//==============================================================================
+// streaming thread, between the event handling passes
+static void fobos_rx_hop_retune(struct fobos_dev_t * dev)
+{
+    // a transaction of the application is not to be committed by a hop
+    if (fobos_atomic_load(&dev->cfg_txn) || (FOBOS_RUNNING != fobos_rx_status(dev)))
+    {
+        return;
+    }
+    uint64_t t0 = fobos_time_ns();
+    dev->hop_pos = (dev->hop_pos + 1 < dev->hop_count) ? dev->hop_pos + 1 : 0;
+    int result = fobos_rx_plan_load(dev, &dev->hop_plans[dev->hop_pos]);
+    uint64_t elapsed = fobos_time_ns() - t0;
+    fobos_stat_add(&dev->rx_stats.hop_retune_ns, elapsed);
+    fobos_stat_max64(&dev->rx_stats.hop_retune_max_ns, elapsed);
+    if (result != FOBOS_ERR_OK)
+    {
+        // the segment stays closed, the next pass tries the next entry, a run
+        // of failures is reported once and counted by hop_errors
+        if (!dev->hop_failing)
+        {
+            printf_internal("Failed to tune to hop #%d, err %d\n", dev->hop_pos, result);
+        }
+        dev->hop_failing = 1;
+        fobos_stat_add(&dev->rx_stats.hop_errors, 1);
+        return;
+    }
+    dev->hop_failing = 0;
+    fobos_stat_add(&dev->rx_stats.hops, 1);
+    // the buffers completed while retuning are dropped as the segment is still
+    // closed, the samples the device sent meanwhile are not counted yet
+    uint64_t retune_samples = (uint64_t)((double)elapsed * 1e-9 * dev->rx_samplerate);
+    dev->hop_start = dev->meta_index + retune_samples + dev->transfer_buf_size / 4 + dev->hop_settle;
+    dev->hop_captured = 0;
+    dev->hop_closed = 0;
+}
+//==============================================================================
+// delivery side: drops the samples out of the segments, returns 0 when nothing is left
+static int fobos_rx_hop_slice(struct fobos_dev_t * dev, struct fobos_rx_buf_t * buf, struct fobos_rx_buf_t * part, int * length)
+{
+    uint32_t count = *length / 4;
+    if (buf->skip >= count)
+    {
+        dev->hop_flags |= buf->meta.flags;
+        dev->hop_lost += buf->meta.lost_samples;
+        return 0;
+    }
+    part->data = buf->data + buf->skip * 4;
+    part->meta = buf->meta;
+    part->cvt = buf->cvt;
+    part->meta.sample_index += buf->skip;
+    part->meta.flags |= dev->hop_flags;
+    part->meta.lost_samples += dev->hop_lost;
+    dev->hop_flags = 0;
+    dev->hop_lost = 0;
+    *length = (count - buf->skip) * 4;
+    return 1;
+}
+//==============================================================================
+static void fobos_rx_process_buffer(struct fobos_dev_t * dev, struct fobos_rx_buf_t * buf, int length)
+{
+    uint32_t complex_samples_count = length / 4;
+    struct fobos_rx_meta_t * meta = &buf->meta;
+    if (meta->sample_index != dev->meta_next + meta->lost_samples)
+    {
+        meta->flags |= FOBOS_META_DROPPED;
+    }
+    dev->meta_next = meta->sample_index + complex_samples_count;
+    dev->rx_buff_counter++;
+    struct fobos_rx_buf_t part;
+    if (dev->hop_count)
+    {
+        if (!fobos_rx_hop_slice(dev, buf, &part, &length))
+        {
+            return;
+        }
+        buf = &part;
+        meta = &part.meta;
+        complex_samples_count = length / 4;
+    }
+    if (dev->rx_ring)
+    {
+        fobos_rx_ring_put(dev, buf, length);
+        return;
+    }
+    if (dev->frame_capacity)
+    {
+        fobos_rx_frame_buffer(dev, buf, length);
+        fobos_stat_add(&dev->rx_stats.buffers, 1);
+        return;
+    }
+    dev->rx_meta = *meta;
+    fobos_rx_convert_samples(dev, &buf->cvt, buf->data, length, dev->rx_buff);
+    if (dev->rx_meta_cb)
+    {
+        dev->rx_meta_cb(dev->rx_buff, complex_samples_count, dev->rx_format, meta, dev->rx_cb_ctx);
+    }
+    else if (dev->rx_fmt_cb)
+    {
+        dev->rx_fmt_cb(dev->rx_buff, complex_samples_count, dev->rx_format, dev->rx_cb_ctx);
+    }
+    else if (dev->rx_cb)
+    {
+        dev->rx_cb((float *)dev->rx_buff, complex_samples_count, dev->rx_cb_ctx);
+    }
+    fobos_stat_add(&dev->rx_stats.buffers, 1);
+}
+//==============================================================================
+// Processing thread: converts the filled raw buffers and calls the callback
+// while the libusb event thread only resubmits the transfers. The buffers are
+// handed over through the SPSC queues, the event thread takes proc_lock only
+// to wake the processing thread when it sleeps on an empty queue.
+//==============================================================================
+FOBOS_THREAD_PROC(fobos_rx_proc_thread, arg)
+{
+    struct fobos_dev_t * dev = (struct fobos_dev_t *)arg;
+    while (1)
+    {
+        struct fobos_rx_buf_t * buf = (struct fobos_rx_buf_t *)fobos_spsc_pop(&dev->proc_filled);
+        if (!buf)
+        {
+            // announce the sleep before the last look at the queue, the
+            // event thread looks at proc_sleeping after the push
+            fobos_mutex_lock(&dev->proc_lock);
+            fobos_atomic_store(&dev->proc_sleeping, 1);
+            fobos_atomic_fence();
+            while (!dev->proc_quit && (fobos_spsc_count(&dev->proc_filled) == 0))
+            {
+                fobos_cond_wait(&dev->proc_cond, &dev->proc_lock);
+            }
+            fobos_atomic_store(&dev->proc_sleeping, 0);
+            int quit = dev->proc_quit;
+            fobos_mutex_unlock(&dev->proc_lock);
+            if (quit)
+            {
+                break;
+            }
+            continue;
+        }
+        fobos_rx_process_buffer(dev, buf, dev->transfer_buf_size);
+        fobos_spsc_push(&dev->proc_free, buf);
+    }
+    FOBOS_THREAD_RETURN;
+}
+//==============================================================================
+static int fobos_rx_proc_start(struct fobos_dev_t * dev)
+{
+    dev->proc_running = 0;
+    dev->proc_quit = 0;
+    dev->proc_sleeping = 0;
+    if (dev->transfer_spare_count == 0)
+    {
+        return FOBOS_ERR_OK;
+    }
+    uint32_t buf_count = dev->transfer_buf_count + dev->transfer_spare_count;
+    if ((fobos_spsc_init(&dev->proc_filled, buf_count) != 0) ||
+        (fobos_spsc_init(&dev->proc_free, buf_count) != 0))
+    {
+        fobos_spsc_free(&dev->proc_filled);
+        fobos_spsc_free(&dev->proc_free);
+        return FOBOS_ERR_NO_MEM;
+    }
+    for (uint32_t i = dev->transfer_buf_count; i < buf_count; i++)
+    {
+        fobos_spsc_push(&dev->proc_free, &dev->rx_bufs[i]);
+    }
+    fobos_mutex_init(&dev->proc_lock);
+    fobos_cond_init(&dev->proc_cond);
+    if (fobos_thread_create(&dev->proc_thread, fobos_rx_proc_thread, dev) != 0)
+    {
+        fobos_cond_destroy(&dev->proc_cond);
+        fobos_mutex_destroy(&dev->proc_lock);
+        fobos_spsc_free(&dev->proc_filled);
+        fobos_spsc_free(&dev->proc_free);
+        return FOBOS_ERR_NO_MEM;
+    }
+    dev->proc_running = 1;
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+static void fobos_rx_proc_stop(struct fobos_dev_t * dev)
+{
+    if (!dev->proc_running)
+    {
+        return;
+    }
+    fobos_mutex_lock(&dev->proc_lock);
+    dev->proc_quit = 1;
+    fobos_cond_broadcast(&dev->proc_cond);
+    fobos_mutex_unlock(&dev->proc_lock);
+    fobos_thread_join(dev->proc_thread);
+    fobos_cond_destroy(&dev->proc_cond);
+    fobos_mutex_destroy(&dev->proc_lock);
+    fobos_spsc_free(&dev->proc_filled);
+    fobos_spsc_free(&dev->proc_free);
+    dev->proc_running = 0;
+}
+//==============================================================================
+// Zero-copy leases
+// The raw transfer buffer itself is passed to the application, the transfer is
+// resubmitted with a spare buffer at once. The leased buffer becomes a spare
+// again when the application returns it, from any thread. When every spare is
+// leased the transfer is resubmitted with its own buffer and the samples are
+// dropped, the next lease is flagged FOBOS_META_DROPPED. The stop waits up to
+// FOBOS_LEASE_TIMEOUT_MS for the leases out, the buffers of the leases still
+// not returned are abandoned rather than released under the application. The
+// lock lives as long as the device, so a late release finds the stream
+// stopped instead of a destroyed lock.
+//==============================================================================
+static void fobos_rx_lease_start(struct fobos_dev_t * dev)
+{
+    fobos_mutex_lock(&dev->lease_lock);
+    dev->lease_free_count = 0;
+    dev->lease_held = 0;
+    for (uint32_t i = 0; i < dev->transfer_spare_count; i++)
+    {
+        dev->rx_bufs[dev->transfer_buf_count + i].leased = 0;
+        dev->lease_free[dev->lease_free_count++] = &dev->rx_bufs[dev->transfer_buf_count + i];
+    }
+    for (uint32_t i = 0; i < dev->transfer_buf_count; i++)
+    {
+        dev->rx_bufs[i].leased = 0;
+    }
+    dev->lease_running = 1;
+    fobos_mutex_unlock(&dev->lease_lock);
+}
+//==============================================================================
+// returns FOBOS_ERR_TIMEOUT when leases are still out, their buffers must not
+// be released
+static int fobos_rx_lease_stop(struct fobos_dev_t * dev)
+{
+    int result = FOBOS_ERR_OK;
+    fobos_mutex_lock(&dev->lease_lock);
+    if (dev->lease_running)
+    {
+        uint64_t deadline = fobos_time_ns() + FOBOS_LEASE_TIMEOUT_MS * 1000000ULL;
+        dev->lease_waiting = 1;
+        while (dev->lease_held)
+        {
+            uint64_t now = fobos_time_ns();
+            if (now >= deadline)
+            {
+                printf_internal("%u leases were not returned, their buffers are leaked\n", dev->lease_held);
+                result = FOBOS_ERR_TIMEOUT;
+                break;
+            }
+            fobos_cond_timedwait(&dev->lease_cond, &dev->lease_lock, (uint32_t)((deadline - now) / 1000000ULL) + 1);
+        }
+        dev->lease_waiting = 0;
+        dev->lease_running = 0;
+    }
+    fobos_mutex_unlock(&dev->lease_lock);
+    return result;
+}
+//==============================================================================
+static struct fobos_rx_buf_t * fobos_rx_lease_take(struct fobos_dev_t * dev)
+{
+    struct fobos_rx_buf_t * spare = NULL;
+    fobos_mutex_lock(&dev->lease_lock);
+    if (dev->lease_free_count)
+    {
+        spare = dev->lease_free[--dev->lease_free_count];
+    }
+    fobos_mutex_unlock(&dev->lease_lock);
+    return spare;
+}
+//==============================================================================
+static void fobos_rx_lease_deliver(struct fobos_dev_t * dev, struct fobos_rx_buf_t * buf, int length)
+{
+    uint32_t complex_samples_count = length / 4;
+    struct fobos_rx_meta_t * meta = &buf->meta;
+    if (meta->sample_index != dev->meta_next + meta->lost_samples)
+    {
+        meta->flags |= FOBOS_META_DROPPED;
+    }
+    dev->meta_next = meta->sample_index + complex_samples_count;
+    dev->rx_buff_counter++;
+    dev->rx_meta = *meta;
+    buf->lease.raw = (const uint16_t *)buf->data;
+    buf->lease.length = complex_samples_count;
+    buf->lease.q_first = buf->cvt.swap_iq;
+    buf->lease.meta = *meta;
+    fobos_mutex_lock(&dev->lease_lock);
+    buf->leased = 1;
+    dev->lease_held++;
+    fobos_stat_max32(&dev->rx_stats.leases_held_max, dev->lease_held);
+    fobos_mutex_unlock(&dev->lease_lock);
+    fobos_stat_add(&dev->rx_stats.leases, 1);
+    fobos_stat_add(&dev->rx_stats.buffers, 1);
+    dev->rx_lease_cb(&buf->lease, dev->rx_cb_ctx);
+}
+//==============================================================================
+int fobos_rx_release_lease(struct fobos_dev_t * dev, const struct fobos_rx_lease_t * lease)
+{
+    int result = fobos_check(dev);
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (!lease)
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    struct fobos_rx_buf_t * buf = (struct fobos_rx_buf_t *)((const char *)lease - offsetof(struct fobos_rx_buf_t, lease));
+    fobos_mutex_lock(&dev->lease_lock);
+    if (!dev->lease_running)
+    {
+        result = FOBOS_ERR_NOT_STARTED;
+    }
+    else if ((buf < dev->rx_bufs) || (buf >= dev->rx_bufs + dev->transfer_buf_count + dev->transfer_spare_count))
+    {
+        result = FOBOS_ERR_UNSUPPORTED;
+    }
+    else if (buf->leased)
+    {
+        buf->leased = 0;
+        dev->lease_free[dev->lease_free_count++] = buf;
+        dev->lease_held--;
+        fobos_stat_add(&dev->rx_stats.lease_returns, 1);
+        if (dev->lease_waiting && !dev->lease_held)
+        {
+            fobos_cond_broadcast(&dev->lease_cond);
+        }
+    }
+    else
+    {
+        result = FOBOS_ERR_UNSUPPORTED;
+    }
+    fobos_mutex_unlock(&dev->lease_lock);
+    return result;
+}
+//==============================================================================
+// a transfer is not resubmitted, the cancel waits for the last one
+static void fobos_rx_xfer_reaped(struct fobos_dev_t * dev)
+{
+    if (dev->prep_active)
+    {
+        // fobos_rx_pause_async() waits in another thread
+        fobos_mutex_lock(&dev->state_lock);
+        if (dev->xfer_active && (--dev->xfer_active == 0))
+        {
+            dev->xfer_idle = 1;
+            fobos_cond_broadcast(&dev->state_cond);
+        }
+        fobos_mutex_unlock(&dev->state_lock);
+        return;
+    }
+    if (dev->xfer_active && (--dev->xfer_active == 0))
+    {
+        dev->xfer_idle = 1;
+    }
+}
+//==============================================================================
+// the device is gone or keeps failing, the streaming ends (or is recovered)
+static void fobos_rx_lost(struct fobos_dev_t * dev)
+{
+    dev->dev_lost = 1;
+    if (fobos_rx_status_cancel(dev))
+    {
+        dev->rx_async_cancel = 1;
+    }
+}
+//==============================================================================
+static void LIBUSB_CALL _libusb_callback(struct libusb_transfer *transfer)
+{
+    struct fobos_rx_xfer_t * xfer = (struct fobos_rx_xfer_t *)transfer->user_data;
+    struct fobos_dev_t *dev = xfer->dev;
+    if (LIBUSB_TRANSFER_COMPLETED == transfer->status)
+    {
+        struct fobos_rx_buf_t * filled = NULL;
+        struct fobos_rx_buf_t * leased = NULL;
+        if (transfer->actual_length == (int)dev->transfer_buf_size)
+        {
+            //printf_internal(".");
+            fobos_rx_meta_stamp(dev, &xfer->buf->meta, transfer->actual_length / 4);
+            xfer->buf->cvt = dev->rx_cvt_sel;
+            if (dev->hop_count)
+            {
+                fobos_rx_hop_stamp(dev, xfer->buf, transfer->actual_length / 4);
+            }
+            if (dev->lease_running)
+            {
+                struct fobos_rx_buf_t * spare = fobos_rx_lease_take(dev);
+                if (spare)
+                {
+                    leased = xfer->buf;
+                    xfer->buf = spare;
+                    transfer->buffer = spare->data;
+                }
+                else
+                {
+                    fobos_stat_add(&dev->rx_stats.lease_denied, 1);
+                }
+            }
+            else if (dev->proc_running)
+            {
+                struct fobos_rx_buf_t * spare = (struct fobos_rx_buf_t *)fobos_spsc_pop(&dev->proc_free);
+                if (spare)
+                {
+                    filled = xfer->buf;
+                    xfer->buf = spare;
+                    transfer->buffer = spare->data;
+                }
+                else
+                {
+                    fobos_stat_add(&dev->rx_stats.queue_overflows, 1);
+                }
+            }
+            else
+            {
+                fobos_rx_process_buffer(dev, xfer->buf, transfer->actual_length);
+            }
+        }
+        else
+        {
+            printf_internal("E");
+            dev->rx_failures++;
+            fobos_rx_meta_short(dev, transfer->actual_length / 4);
+        }
+        if ((FOBOS_CANCELING == fobos_rx_status(dev)) || (libusb_submit_transfer(transfer) < 0))
+        {
+            fobos_rx_xfer_reaped(dev);
+        }
+        dev->transfer_errors = 0;
+        if (leased)
+        {
+            fobos_rx_lease_deliver(dev, leased, transfer->actual_length);
+        }
+        if (filled)
+        {
+            fobos_spsc_push(&dev->proc_filled, filled);
+            fobos_stat_max32(&dev->rx_stats.queue_max_fill, fobos_spsc_count(&dev->proc_filled));
+            // the lock is only taken when the processing thread sleeps
+            fobos_atomic_fence();
+            if (fobos_atomic_load(&dev->proc_sleeping))
+            {
+                fobos_mutex_lock(&dev->proc_lock);
+                fobos_cond_broadcast(&dev->proc_cond);
+                fobos_mutex_unlock(&dev->proc_lock);
+            }
+        }
+    }
+    else if (LIBUSB_TRANSFER_CANCELLED == transfer->status)
+    {
+        fobos_rx_xfer_reaped(dev);
+    }
+    else
+    {
+        printf_internal("transfer->status = %d\n", transfer->status);
+        fobos_rx_xfer_reaped(dev);
+#ifndef _WIN32
+        if (LIBUSB_TRANSFER_ERROR == transfer->status)
+        {
+            dev->transfer_errors++;
+        }
+        if (dev->transfer_errors >= (int)dev->transfer_buf_count || LIBUSB_TRANSFER_NO_DEVICE == transfer->status)
+        {
+            fobos_rx_lost(dev);
+        }
+#else
+        fobos_rx_lost(dev);
+#endif
+    }
+}
+//==============================================================================
+// Automatic transfer count and length
+// A sample waits in its transfer until the transfer is full, so the transfer
+// length follows the latency target: half of it, but not less than 1 ms of
+// samples to keep the completion rate sane, and not less than a few bursts of
+// the usb link. The transfers in flight have to cover the host stalls. The
+// stall budget starts at FOBOS_AUTO_STALL_MS and is adapted after every run:
+// doubled on overflows or gaps, otherwise moved toward the measured jitter.
+//==============================================================================
+static void fobos_rx_auto_buffers(struct fobos_dev_t * dev, uint32_t * buf_count, uint32_t * buf_length, int fixed_length)
+{
+    double samplerate = dev->rx_samplerate;
+    if ((dev->auto_latency_ms <= 0.0) || (samplerate <= 0.0))
+    {
+        return;
+    }
+    uint32_t length = *buf_length;
+    if (!fixed_length || (length == 0))
+    {
+        int speed = libusb_get_device_speed(libusb_get_device(dev->libusb_devh));
+        double min_length = (speed >= LIBUSB_SPEED_SUPER) ? 16384.0 : 4096.0;
+        double value = samplerate * dev->auto_latency_ms * 0.5e-3;
+        if (value < samplerate * 1e-3)
+        {
+            value = samplerate * 1e-3;
+        }
+        if (value < min_length)
+        {
+            value = min_length;
+        }
+        if (value > FOBOS_AUTO_MAX_BUF_SIZE / 4)
+        {
+            value = FOBOS_AUTO_MAX_BUF_SIZE / 4;
+        }
+        length = 128 * (uint32_t)((value + 127.0) / 128.0);
+    }
+    double transfer_ms = 1e3 * length / samplerate;
+    double count = ceil(dev->auto_stall_ms / transfer_ms) + 2.0;
+    if (count > FOBOS_MAX_BUF_COUNT)
+    {
+        count = FOBOS_MAX_BUF_COUNT;
+    }
+    *buf_count = (uint32_t)count;
+    *buf_length = length;
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("Auto buffers: %u x %u samples (%.2f ms), stall budget %.1f ms\n", *buf_count, length, transfer_ms, dev->auto_stall_ms);
+#endif // FOBOS_PRINT_DEBUG
+}
+//==============================================================================
+static void fobos_rx_auto_update(struct fobos_dev_t * dev)
+{
+    if (dev->auto_latency_ms <= 0.0)
+    {
+        return;
+    }
+    double jitter_ms = 1.5e-3 * dev->rx_stats.max_jitter_us;
+    double stall = dev->auto_stall_ms;
+    if (dev->rx_stats.queue_overflows || dev->rx_stats.gaps)
+    {
+        stall = (2.0 * stall > jitter_ms) ? 2.0 * stall : jitter_ms;
+    }
+    else
+    {
+        stall = 0.75 * stall + 0.25 * ((jitter_ms > FOBOS_AUTO_MIN_STALL_MS) ? jitter_ms : FOBOS_AUTO_MIN_STALL_MS);
+    }
+    if (stall < FOBOS_AUTO_MIN_STALL_MS)
+    {
+        stall = FOBOS_AUTO_MIN_STALL_MS;
+    }
+    if (stall > FOBOS_AUTO_MAX_STALL_MS)
+    {
+        stall = FOBOS_AUTO_MAX_STALL_MS;
+    }
+    dev->auto_stall_ms = stall;
+}
+//==============================================================================
+// The data flow is started in two steps, so that the devices of a synchronized
+// start get their fx3 commands back to back: arm every device, then enable the
+// adc outputs. The start time is taken right after the enable.
+static void fobos_rx_flow_arm(struct fobos_dev_t * dev)
+{
+    fobos_fx3_command(dev, 0xE1, 1, 0);        // start fx
+}
+//==============================================================================
+static void fobos_rx_flow_enable(struct fobos_dev_t * dev)
+{
+    if (dev->dev_gpo & (1 << FOBOS_DEV_ADC_SDI))
+    {
+        bitclear(dev->dev_gpo, FOBOS_DEV_ADC_SDI);
+        fobos_rx_set_dev_gpo(dev, dev->dev_gpo);
+    }
+    dev->start_ns = fobos_time_ns();
+    dev->meta_t0 = dev->start_ns;
+}
+//==============================================================================
+// set up the streaming and submit the transfers
+static int fobos_rx_async_begin(struct fobos_dev_t * dev, fobos_rx_cb_t cb, fobos_rx_fmt_cb_t fmt_cb, fobos_rx_meta_cb_t meta_cb, void *ctx, uint32_t buf_count, uint32_t buf_length, int format)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%p, %p, %p, %d, %d, %d)\n", __FUNCTION__, (void*)dev, (void*)cb, (void*)ctx, buf_count, buf_length, format);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (FOBOS_IDDLE != fobos_rx_status(dev))
+    {
+        return FOBOS_ERR_ASYNC_IN_SYNC;
+    }
+    if ((format < FOBOS_FORMAT_CF32) || (format > FOBOS_FORMAT_CS8))
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    if (dev->hop_count && (dev->rx_ring || dev->rx_lease_cb))
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    result = FOBOS_ERR_OK;
+    fobos_rx_set_status(dev, FOBOS_STARTING);
+    dev->rx_async_cancel = 0;
+    dev->recover_abort = 0;
+    // fobos_rx_ring_stop() called before the ring thread got here
+    fobos_atomic_fence();
+    if (dev->rx_ring && fobos_atomic_load(&dev->rx_ring->stop))
+    {
+        fobos_rx_set_status(dev, FOBOS_CANCELING);
+        dev->rx_async_cancel = 1;
+    }
+    dev->rx_buff_counter = 0;
+    dev->rx_cb = cb;
+    dev->rx_fmt_cb = fmt_cb;
+    dev->rx_meta_cb = meta_cb;
+    dev->rx_cb_ctx = ctx;
+    dev->rx_format = format;
+    fobos_rx_cvt_select(dev);
+    fobos_atomic_store64(&dev->rx_avg, 0);
+    fobos_rx_auto_buffers(dev, &buf_count, &buf_length, dev->rx_ring != NULL);
+    if (buf_count == 0)
+    {
+        buf_count = FOBOS_DEF_BUF_COUNT;
+    }
+    if (buf_count > FOBOS_MAX_BUF_COUNT)
+    {
+        buf_count = FOBOS_MAX_BUF_COUNT;
+    }
+    dev->transfer_buf_count = buf_count;
+
+    if (buf_length == 0)
+    {
+        buf_length = FOBOS_DEF_BUF_LENGTH;
+    }
+    buf_length = 128 * (buf_length / 128); // complex samples count
+
+    uint32_t transfer_buf_size = buf_length * 4; //raw int16 buff size
+    transfer_buf_size = 512 * (transfer_buf_size / 512); // len must be multiple of 512
+
+    dev->transfer_buf_size = transfer_buf_size;
+    dev->transfer_spare_count = dev->rx_lease_cb ? dev->lease_spare_count : dev->proc_queue_depth;
+
+    memset(&dev->rx_stats, 0, sizeof(dev->rx_stats));
+    dev->rx_stats.queue_depth = dev->rx_lease_cb ? 0 : dev->proc_queue_depth;
+    dev->rx_stats.buf_count = buf_count;
+    dev->rx_stats.buf_length = transfer_buf_size / 4;
+
+    dev->frame_capacity = 0;
+    if (dev->frame_length && !dev->rx_ring && !dev->rx_lease_cb)
+    {
+        dev->frame_capacity = 4 * dev->frame_length + 4 * (transfer_buf_size / 4);
+    }
+    fobos_rx_frame_reset(dev);
+    result = fobos_alloc_buffers(dev);
+    if (result != FOBOS_ERR_OK)
+    {
+        dev->transfer_spare_count = 0;
+        fobos_rx_set_status(dev, FOBOS_IDDLE);
+        return result;
+    }
+    fobos_rx_meta_reset(dev, dev->transfer_buf_count + 1);
+    fobos_rx_hop_reset(dev);
+
+    fobos_cvt_pool_start(dev);
+    fobos_rx_cal_start(dev);
+    if (dev->rx_lease_cb)
+    {
+        fobos_rx_lease_start(dev);
+    }
+    else if (fobos_rx_proc_start(dev) != FOBOS_ERR_OK)
+    {
+        printf_internal("Failed to start the processing thread, processing in the event thread\n");
+        dev->rx_stats.queue_depth = 0;
+    }
+
+    if (!dev->start_deferred)
+    {
+        fobos_rx_flow_arm(dev);
+        fobos_rx_flow_enable(dev);
+    }
+
+    dev->xfer_active = 0;
+    dev->xfer_idle = 0;
+    for (uint32_t i = 0; i < dev->transfer_buf_count; ++i)
+    {
+        libusb_fill_bulk_transfer(dev->transfer[i],
+            dev->libusb_devh,
+            LIBUSB_BULK_IN_ENDPOINT,
+            dev->rx_xfers[i].buf->data,
+            dev->transfer_buf_size,
+            _libusb_callback,
+            (void *)&dev->rx_xfers[i],
+            LIBUSB_BULK_TIMEOUT);
+        if (dev->prep_active)
+        {
+            continue;
+        }
+        result = libusb_submit_transfer(dev->transfer[i]);
+        if (result < 0)
+        {
+            printf_internal("Failed to submit transfer #%d, err %i\n", i, result);
+            fobos_rx_set_status(dev, FOBOS_CANCELING);
+            break;
+        }
+        dev->xfer_active++;
+    }
+
+    fobos_atomic_cas(&dev->rx_async_status, FOBOS_STARTING, dev->prep_active ? FOBOS_PAUSED : FOBOS_RUNNING);
+    if (dev->evt_running)
+    {
+        fobos_mutex_lock(&dev->evt_lock);
+        fobos_cond_broadcast(&dev->evt_cond);
+        fobos_mutex_unlock(&dev->evt_lock);
+    }
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+// one pass of the event loop, returns 1 when the streaming has ended.
+// Once cancelled every transfer in flight is cancelled in one pass and the
+// events are handled until the last one is reaped, the callback does not
+// resubmit anymore. Transfers still not reaped after 2 s keep their buffers,
+// they are abandoned so the end of the stream can not release them.
+static int fobos_rx_async_step(struct fobos_dev_t * dev, struct timeval * tv, int * result)
+{
+    //printf_internal("X");
+    fobos_rx_cmd_enter(dev);
+    *result = libusb_handle_events_timeout_completed(dev->libusb_ctx, tv, &dev->rx_async_cancel);
+    fobos_rx_cmd_leave(dev, 1);
+    if (*result < 0)
+    {
+        printf_internal("libusb_handle_events_timeout_completed returned: %d\n", *result);
+        if (*result != LIBUSB_ERROR_INTERRUPTED)
+        {
+            fobos_rx_set_status(dev, FOBOS_CANCELING);
+        }
+    }
+    if (FOBOS_CANCELING != fobos_rx_status(dev))
+    {
+        return 0;
+    }
+    uint64_t deadline = fobos_time_ns() + 2000000000ULL;
+    while (dev->xfer_active && dev->transfer)
+    {
+        for (uint32_t i = 0; i < dev->transfer_buf_count; ++i)
+        {
+            if (dev->transfer[i])
+            {
+                libusb_cancel_transfer(dev->transfer[i]);
+            }
+        }
+        struct timeval tvx = { 0, 100000 };
+        libusb_handle_events_timeout_completed(dev->libusb_ctx, &tvx, &dev->xfer_idle);
+        if (dev->xfer_active && (fobos_time_ns() > deadline))
+        {
+            printf_internal("%u transfers were not reaped, their buffers are leaked\n", dev->xfer_active);
+            fobos_abandon_buffers(dev);
+            break;
+        }
+    }
+    return 1;
+}
+//==============================================================================
+// stop the device and release the streaming resources
+static void fobos_rx_async_end(struct fobos_dev_t * dev)
+{
+    fobos_fx3_command(dev, 0xE1, 0, 0);       // stop fx
+    fobos_rx_auto_update(dev);
+    fobos_rx_proc_stop(dev);
+    int leased = (fobos_rx_lease_stop(dev) != FOBOS_ERR_OK);
+    fobos_rx_cal_stop(dev);
+    if (leased)
+    {
+        fobos_abandon_buffers(dev);
+    }
+    fobos_free_buffers(dev);
+    dev->transfer_spare_count = 0;
+    fobos_cvt_pool_stop(dev);
+    bitset(dev->dev_gpo, FOBOS_DEV_ADC_SDI);
+    fobos_rx_set_dev_gpo(dev, dev->dev_gpo);
+    fobos_mutex_lock(&dev->state_lock);
+    fobos_rx_set_status(dev, FOBOS_IDDLE);
+    dev->rx_async_cancel = 0;
+    fobos_cond_broadcast(&dev->state_cond);
+    fobos_mutex_unlock(&dev->state_lock);
+    fobos_rx_cmd_drain(dev);
+    fobos_atomic_store(&dev->cmd_tid_valid, 0);
+    dev->cmd_in_events = 0;
+}
+//==============================================================================
+// Stream recovery
+// With the recovery enabled a stream ended by a lost device or by repeated
+// transfer errors is not torn down. The buffers and the helper threads are
+// kept while the device is looked up by its serial number every
+// FOBOS_RECOVER_INTERVAL_MS, a device that was not unplugged keeps its handle.
+// The hardware is initialized and the cached configuration replayed, then the
+// same transfers are submitted again into the same callback. The first buffer
+// after the recovery is flagged FOBOS_META_GAP | FOBOS_META_RECOVERED and
+// carries the samples missed meanwhile, estimated from the time elapsed since
+// the last completion. Only the streams of fobos_rx_read_async*(),
+// fobos_rx_start_async() out of a session and the ring mode are recovered.
+//==============================================================================
+static int fobos_rx_hw_restore(struct fobos_dev_t * dev)
+{
+    int clk_external = !(dev->dev_gpo & (1 << FOBOS_DEV_CLKSEL));
+    double frequency = dev->rx_frequency_req;
+    double samplerate = dev->rx_samplerate;
+    unsigned int lna_gain = dev->rx_lna_gain;
+    unsigned int vga_gain = dev->rx_vga_gain;
+    unsigned int direct_sampling = dev->rx_direct_sampling;
+    uint32_t bw_idx = dev->rx_bw_idx;
+    uint32_t bw_adj = dev->rx_bw_adj;
+    int result = fobos_rx_hw_init(dev);
+    if (result < 0)
+    {
+        return result;
+    }
+    // the device is at its power on state, the cached values are not
+    dev->rx_frequency = 0.0;
+    dev->rx_frequency_band = 0xFFFFFFFF;
+    dev->rx_bw_idx = 0xFFFFFFFF;
+    dev->rx_bw_adj = 0xFFFFFFFF;
+    dev->rx_lna_gain = 0xFFFFFFFF;
+    dev->rx_vga_gain = 0xFFFFFFFF;
+    dev->rx_direct_sampling = 0;
+    fobos_rx_set_clk_source(dev, clk_external);
+    fobos_rx_set_frequency(dev, frequency, 0);
+    fobos_rx_set_samplerate(dev, samplerate, 0);
+    // the sample rate sets its own bandwidth, the one set after it wins
+    if ((bw_idx != 0xFFFFFFFF) && (bw_adj != 0xFFFFFFFF))
+    {
+        fobos_max2830_set_bw(dev, bw_idx, bw_adj);
+    }
+    fobos_rx_set_lna_gain(dev, lna_gain);
+    fobos_rx_set_vga_gain(dev, vga_gain);
+    fobos_rx_set_direct_sampling(dev, direct_sampling);
+    if (dev->user_gpo_known)
+    {
+        fobos_rx_set_user_gpo(dev, (uint8_t)dev->user_gpo);
+    }
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+static int fobos_rx_reopen(struct fobos_dev_t * dev)
+{
+    libusb_device **dev_list;
+    libusb_device *current = libusb_get_device(dev->libusb_devh);
+    struct libusb_device_handle * devh = NULL;
+    struct libusb_device_descriptor dd;
+    char serial[FOBOS_INFO_LEN];
+    ssize_t cnt = libusb_get_device_list(dev->libusb_ctx, &dev_list);
+    for (ssize_t i = 0; i < cnt; i++)
+    {
+        libusb_get_device_descriptor(dev_list[i], &dd);
+        if ((dd.idVendor != FOBOS_VENDOR_ID) ||
+            (dd.idProduct != FOBOS_PRODUCT_ID) ||
+            (dd.bcdDevice != FOBOS_DEV_ID))
+        {
+            continue;
+        }
+        if (dev_list[i] == current)
+        {
+            devh = dev->libusb_devh;
+            break;
+        }
+        if (libusb_open(dev_list[i], &devh) != 0)
+        {
+            devh = NULL;
+            continue;
+        }
+        memset(serial, 0, sizeof(serial));
+        libusb_get_string_descriptor_ascii(devh, dd.iSerialNumber, (unsigned char*)serial, sizeof(serial));
+        if ((strcmp(serial, dev->serial) == 0) && (libusb_claim_interface(devh, 0) == 0))
+        {
+            break;
+        }
+        libusb_close(devh);
+        devh = NULL;
+    }
+    if (cnt >= 0)
+    {
+        libusb_free_device_list(dev_list, 1);
+    }
+    if (!devh)
+    {
+        return FOBOS_ERR_NO_DEV;
+    }
+    if (devh != dev->libusb_devh)
+    {
+        libusb_close(dev->libusb_devh);
+        dev->libusb_devh = devh;
+    }
+    if (fobos_rx_hw_restore(dev) < 0)
+    {
+        return FOBOS_ERR_NO_DEV;
+    }
+    dev->dev_lost = 0;
+    dev->transfer_errors = 0;
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+static int fobos_rx_recover(struct fobos_dev_t * dev)
+{
+    if (!dev->transfer)
+    {
+        // abandoned with transfers not reaped, nothing to submit again
+        return FOBOS_ERR_NO_DEV;
+    }
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("Device lost, recovering\n");
+#endif // FOBOS_PRINT_DEBUG
+    uint64_t deadline = fobos_time_ns() + (uint64_t)dev->recover_timeout_ms * 1000000ULL;
+    int result = FOBOS_ERR_NO_DEV;
+    fobos_mutex_lock(&dev->state_lock);
+    fobos_rx_set_status(dev, FOBOS_RECOVERING);
+    while (!dev->recover_abort)
+    {
+        fobos_mutex_unlock(&dev->state_lock);
+        result = fobos_rx_reopen(dev);
+        fobos_mutex_lock(&dev->state_lock);
+        if ((result == FOBOS_ERR_OK) || dev->recover_abort)
+        {
+            break;
+        }
+        if (dev->recover_timeout_ms && (fobos_time_ns() > deadline))
+        {
+            break;
+        }
+        fobos_cond_timedwait(&dev->state_cond, &dev->state_lock, FOBOS_RECOVER_INTERVAL_MS);
+    }
+    if (dev->recover_abort)
+    {
+        result = FOBOS_ERR_NOT_STARTED;
+    }
+    fobos_rx_set_status(dev, (result == FOBOS_ERR_OK) ? FOBOS_RUNNING : FOBOS_CANCELING);
+    fobos_mutex_unlock(&dev->state_lock);
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    dev->rx_async_cancel = 0;
+    dev->xfer_active = 0;
+    dev->xfer_idle = 0;
+    fobos_rx_flow_arm(dev);
+    fobos_rx_flow_enable(dev);
+    uint64_t gap = 0;
+    if (dev->start_ns > dev->meta_last_ns)
+    {
+        gap = (uint64_t)((double)(dev->start_ns - dev->meta_last_ns) * 1e-9 * dev->rx_samplerate);
+    }
+    dev->meta_index += gap;
+    dev->meta_lost += gap;
+    dev->meta_flags |= FOBOS_META_GAP | FOBOS_META_RECOVERED;
+    dev->meta_count = 0;
+    dev->meta_win_count = 0;
+    fobos_stat_add(&dev->rx_stats.lost_samples, gap);
+    fobos_stat_add(&dev->rx_stats.recovery_lost_samples, gap);
+    fobos_stat_add(&dev->rx_stats.recoveries, 1);
+    for (uint32_t i = 0; i < dev->transfer_buf_count; ++i)
+    {
+        libusb_fill_bulk_transfer(dev->transfer[i],
+            dev->libusb_devh,
+            LIBUSB_BULK_IN_ENDPOINT,
+            dev->rx_xfers[i].buf->data,
+            dev->transfer_buf_size,
+            _libusb_callback,
+            (void *)&dev->rx_xfers[i],
+            LIBUSB_BULK_TIMEOUT);
+        result = libusb_submit_transfer(dev->transfer[i]);
+        if (result < 0)
+        {
+            printf_internal("Failed to submit transfer #%d, err %i\n", i, result);
+            fobos_rx_set_status(dev, FOBOS_CANCELING);
+            break;
+        }
+        dev->xfer_active++;
+    }
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("Device recovered, %llu samples lost\n", (unsigned long long)gap);
+#endif // FOBOS_PRINT_DEBUG
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+static int fobos_rx_read_async_ex(struct fobos_dev_t * dev, fobos_rx_cb_t cb, fobos_rx_fmt_cb_t fmt_cb, fobos_rx_meta_cb_t meta_cb, void *ctx, uint32_t buf_count, uint32_t buf_length, int format)
+{
+    int result = fobos_rx_async_begin(dev, cb, fmt_cb, meta_cb, ctx, buf_count, buf_length, format);
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    struct timeval tv1 = { 1, 0 };
+    while (1)
+    {
+        while (!fobos_rx_async_step(dev, &tv1, &result))
+        {
+        }
+        if (!dev->dev_lost || !dev->recover_enabled || dev->recover_abort || (fobos_rx_recover(dev) != FOBOS_ERR_OK))
+        {
+            break;
+        }
+    }
+    fobos_rx_async_end(dev);
+    return result;
+}
+//==============================================================================
+int fobos_rx_read_async(struct fobos_dev_t * dev, fobos_rx_cb_t cb, void *ctx, uint32_t buf_count, uint32_t buf_length)
+{
+    return fobos_rx_read_async_ex(dev, cb, NULL, NULL, ctx, buf_count, buf_length, FOBOS_FORMAT_CF32);
+}
+//==============================================================================
+int fobos_rx_read_async_fmt(struct fobos_dev_t * dev, fobos_rx_fmt_cb_t cb, void *ctx, uint32_t buf_count, uint32_t buf_length, int format)
+{
+    return fobos_rx_read_async_ex(dev, NULL, cb, NULL, ctx, buf_count, buf_length, format);
+}
+//==============================================================================
+int fobos_rx_read_async_meta(struct fobos_dev_t * dev, fobos_rx_meta_cb_t cb, void *ctx, uint32_t buf_count, uint32_t buf_length, int format)
+{
+    return fobos_rx_read_async_ex(dev, NULL, NULL, cb, ctx, buf_count, buf_length, format);
+}
+//==============================================================================
+int fobos_rx_cancel_async(struct fobos_dev_t * dev)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s()\n", __FUNCTION__);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    dev->recover_abort = 1;
+    if (fobos_rx_status_cancel(dev))
+    {
+        dev->rx_async_cancel = 1;
+#if LIBUSB_API_VERSION >= 0x01000105
+        libusb_interrupt_event_handler(dev->libusb_ctx);
+#endif
+    }
+    else if (FOBOS_RECOVERING == fobos_rx_status(dev))
+    {
+        fobos_mutex_lock(&dev->state_lock);
+        fobos_cond_broadcast(&dev->state_cond);
+        fobos_mutex_unlock(&dev->state_lock);
+    }
+    return 0;
+}
+//==============================================================================
+// Prepared stream
+// fobos_rx_prepare_async() allocates the buffers, fills the transfers and
+// starts the helper threads once, the stream starts paused. Resume only starts
+// the fx3 data flow and submits the transfers, pause stops the data flow,
+// cancels them and waits until they are reaped, so a duty cycled capture pays
+// no setup per burst. A stream whose transfers are not reaped within 2 s is
+// not paused, it can only be released and its buffers are then abandoned.
+// Every resume starts a new segment, the sample index counts from 0. The
+// events are handled by an owned thread, or by the session thread for a
+// session device. fobos_rx_stop_async() releases the stream.
+//==============================================================================
+FOBOS_THREAD_PROC(fobos_rx_prep_thread, arg)
+{
+    struct fobos_dev_t * dev = (struct fobos_dev_t *)arg;
+    fobos_thread_set_sched(dev->evt_cpu, dev->evt_priority);
+    while (!dev->prep_quit)
+    {
+        struct timeval tv = { 0, 100000 };
+        fobos_rx_cmd_enter(dev);
+        libusb_handle_events_timeout_completed(dev->libusb_ctx, &tv, &dev->prep_quit);
+        fobos_rx_cmd_leave(dev, 1);
+    }
+    FOBOS_THREAD_RETURN;
+}
+//==============================================================================
+int fobos_rx_prepare_async(struct fobos_dev_t * dev, fobos_rx_fmt_cb_t cb, void *ctx, uint32_t buf_count, uint32_t buf_length, int format)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%p, %p, %d, %d, %d)\n", __FUNCTION__, (void*)cb, (void*)ctx, buf_count, buf_length, format);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (dev->evt_running || dev->evt_polled || dev->rx_sync_started || dev->rx_ring || (FOBOS_IDDLE != fobos_rx_status(dev)))
+    {
+        return FOBOS_ERR_ASYNC_IN_SYNC;
+    }
+    dev->prep_active = 1;
+    dev->start_deferred = 1;
+    result = fobos_rx_async_begin(dev, NULL, cb, NULL, ctx, buf_count, buf_length, format);
+    dev->start_deferred = 0;
+    if (result != FOBOS_ERR_OK)
+    {
+        dev->prep_active = 0;
+        return result;
+    }
+    dev->prep_quit = 0;
+    if (!dev->session && (fobos_thread_create(&dev->prep_thread, fobos_rx_prep_thread, dev) != 0))
+    {
+        fobos_rx_async_end(dev);
+        dev->prep_active = 0;
+        return FOBOS_ERR_NO_MEM;
+    }
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+int fobos_rx_resume_async(struct fobos_dev_t * dev)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s()\n", __FUNCTION__);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (dev->dev_lost)
+    {
+        return FOBOS_ERR_NO_DEV;
+    }
+    if (!dev->prep_active || (FOBOS_PAUSED != fobos_rx_status(dev)))
+    {
+        return FOBOS_ERR_NOT_STARTED;
+    }
+    fobos_rx_meta_reset(dev, dev->transfer_buf_count + 1);
+    fobos_rx_frame_reset(dev);
+    fobos_rx_hop_reset(dev);
+    dev->rx_async_cancel = 0;
+    dev->xfer_idle = 0;
+    fobos_rx_set_status(dev, FOBOS_RUNNING);
+    fobos_rx_flow_arm(dev);
+    fobos_rx_flow_enable(dev);
+    for (uint32_t i = 0; i < dev->transfer_buf_count; ++i)
+    {
+        fobos_mutex_lock(&dev->state_lock);
+        dev->xfer_active++;
+        fobos_mutex_unlock(&dev->state_lock);
+        result = libusb_submit_transfer(dev->transfer[i]);
+        if (result < 0)
+        {
+            printf_internal("Failed to submit transfer #%d, err %i\n", i, result);
+            fobos_rx_xfer_reaped(dev);
+            fobos_rx_pause_async(dev);
+            return FOBOS_ERR_LIBUSB;
+        }
+    }
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+int fobos_rx_pause_async(struct fobos_dev_t * dev)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s()\n", __FUNCTION__);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (!dev->prep_active)
+    {
+        return FOBOS_ERR_NOT_STARTED;
+    }
+    if (FOBOS_PAUSED == fobos_rx_status(dev))
+    {
+        return FOBOS_ERR_OK;
+    }
+    fobos_fx3_command(dev, 0xE1, 0, 0);       // stop fx
+    fobos_rx_set_status(dev, FOBOS_CANCELING);
+    uint64_t deadline = fobos_time_ns() + 2000000000ULL;
+    fobos_mutex_lock(&dev->state_lock);
+    while (dev->xfer_active)
+    {
+        fobos_mutex_unlock(&dev->state_lock);
+        for (uint32_t i = 0; i < dev->transfer_buf_count; ++i)
+        {
+            libusb_cancel_transfer(dev->transfer[i]);
+        }
+        if (dev->session)
+        {
+            fobos_session_wake(dev->session);
+        }
+        fobos_mutex_lock(&dev->state_lock);
+        if (dev->xfer_active)
+        {
+            fobos_cond_timedwait(&dev->state_cond, &dev->state_lock, 10);
+        }
+        if (dev->xfer_active && (fobos_time_ns() > deadline))
+        {
+            printf_internal("%u transfers were not reaped, the stream is not paused\n", dev->xfer_active);
+            fobos_mutex_unlock(&dev->state_lock);
+            return FOBOS_ERR_TIMEOUT;
+        }
+    }
+    fobos_rx_set_status(dev, FOBOS_PAUSED);
+    fobos_mutex_unlock(&dev->state_lock);
+    return dev->dev_lost ? FOBOS_ERR_NO_DEV : FOBOS_ERR_OK;
+}
+//==============================================================================
+static int fobos_rx_prep_release(struct fobos_dev_t * dev)
+{
+    int result = fobos_rx_pause_async(dev);
+    if (result == FOBOS_ERR_TIMEOUT)
+    {
+        printf_internal("%u transfers were not reaped, their buffers are leaked\n", dev->xfer_active);
+        fobos_abandon_buffers(dev);
+    }
+    if (!dev->session)
+    {
+        dev->prep_quit = 1;
+#if LIBUSB_API_VERSION >= 0x01000105
+        libusb_interrupt_event_handler(dev->libusb_ctx);
+#endif
+        fobos_thread_join(dev->prep_thread);
+    }
+    dev->prep_active = 0;
+    fobos_rx_async_end(dev);
+    return result;
+}
+//==============================================================================
+// Sessions
+// A session owns one libusb context shared by the devices opened in it and one
+// event thread handling the usb events of all of them. The transfers keep
+// their device in the user data, so every device has its own callback,
+// processing queue and statistics. A device streamed by the session thread is
+// submitted by fobos_rx_start_async() and ended by the thread once cancelled.
+// The thread retunes the hops and ends the cancelled streams without the
+// session lock: a device is not removed from the session while its transfers
+// are in flight, and only this thread reaps them.
+//==============================================================================
+static void fobos_session_wake(struct fobos_session_t * session)
+{
+#if LIBUSB_API_VERSION >= 0x01000105
+    libusb_interrupt_event_handler(session->libusb_ctx);
+#else
+    (void)session;
+#endif
+}
+//==============================================================================
+FOBOS_THREAD_PROC(fobos_session_thread, arg)
+{
+    struct fobos_session_t * session = (struct fobos_session_t *)arg;
+    struct fobos_dev_t * ending[FOBOS_SESSION_MAX_DEVICES];
+    struct fobos_dev_t * hopping[FOBOS_SESSION_MAX_DEVICES];
+    fobos_mutex_lock(&session->lock);
+    while (!session->quit)
+    {
+        for (uint32_t i = 0; i < session->dev_count; i++)
+        {
+            fobos_rx_cmd_enter(session->devs[i]);
+        }
+        fobos_mutex_unlock(&session->lock);
+        struct timeval tv = { 0, 100000 };
+        libusb_handle_events_timeout_completed(session->libusb_ctx, &tv, NULL);
+        fobos_mutex_lock(&session->lock);
+        uint32_t hopping_count = 0;
+        for (uint32_t i = 0; i < session->dev_count; i++)
+        {
+            struct fobos_dev_t * dev = session->devs[i];
+            fobos_rx_cmd_leave(dev, 0);
+            if (dev->hop_closed && (FOBOS_RUNNING == fobos_rx_status(dev)))
+            {
+                hopping[hopping_count++] = dev;
+            }
+        }
+        uint32_t ending_count = 0;
+        for (uint32_t i = 0; i < session->dev_count; i++)
+        {
+            struct fobos_dev_t * dev = session->devs[i];
+            if (!dev->evt_session || dev->evt_finished || (FOBOS_RUNNING == fobos_rx_status(dev)))
+            {
+                continue;
+            }
+            ending[ending_count++] = dev;
+        }
+        fobos_mutex_unlock(&session->lock);
+        for (uint32_t i = 0; i < hopping_count; i++)
+        {
+            fobos_rx_hop_retune(hopping[i]);
+        }
+        for (uint32_t i = 0; i < ending_count; i++)
+        {
+            struct fobos_dev_t * dev = ending[i];
+            struct timeval tv0 = { 0, 0 };
+            int result = 0;
+            if (fobos_rx_async_step(dev, &tv0, &result))
+            {
+                fobos_rx_async_end(dev);
+                fobos_mutex_lock(&session->lock);
+                dev->evt_result = result;
+                dev->evt_finished = 1;
+                fobos_cond_broadcast(&session->cond);
+                fobos_mutex_unlock(&session->lock);
+            }
+        }
+        fobos_mutex_lock(&session->lock);
+    }
+    fobos_mutex_unlock(&session->lock);
+    FOBOS_THREAD_RETURN;
+}
+//==============================================================================
+// hand the submitted transfers over to the session thread
+static void fobos_session_attach(struct fobos_dev_t * dev)
+{
+    struct fobos_session_t * session = dev->session;
+    fobos_mutex_lock(&session->lock);
+    dev->evt_result = 0;
+    dev->evt_finished = 0;
+    dev->evt_running = 1;
+    dev->evt_session = 1;
+    fobos_mutex_unlock(&session->lock);
+}
+//==============================================================================
+static int fobos_session_start(struct fobos_dev_t * dev, fobos_rx_fmt_cb_t cb, void *ctx, uint32_t buf_count, uint32_t buf_length, int format)
+{
+    int result = fobos_rx_async_begin(dev, NULL, cb, NULL, ctx, buf_count, buf_length, format);
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    fobos_session_attach(dev);
+    if (FOBOS_RUNNING != fobos_rx_status(dev))
+    {
+        fobos_rx_stop_async(dev);
+        return FOBOS_ERR_LIBUSB;
+    }
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+static int fobos_session_stop(struct fobos_dev_t * dev)
+{
+    struct fobos_session_t * session = dev->session;
+    // the stream is running or cancelled already, the thread ends it on its
+    // next pass and signals session->cond
+    fobos_rx_cancel_async(dev);
+    fobos_session_wake(session);
+    fobos_mutex_lock(&session->lock);
+    while (!dev->evt_finished)
+    {
+        fobos_cond_wait(&session->cond, &session->lock);
+    }
+    dev->evt_session = 0;
+    dev->evt_running = 0;
+    int result = dev->evt_result;
+    fobos_mutex_unlock(&session->lock);
+    if (dev->dev_lost)
+    {
+        return FOBOS_ERR_NO_DEV;
+    }
+    return (result < 0) ? FOBOS_ERR_LIBUSB : FOBOS_ERR_OK;
+}
+//==============================================================================
+static void fobos_session_remove(struct fobos_dev_t * dev)
+{
+    struct fobos_session_t * session = dev->session;
+    fobos_mutex_lock(&session->lock);
+    for (uint32_t i = 0; i < session->dev_count; i++)
+    {
+        if (session->devs[i] == dev)
+        {
+            session->devs[i] = session->devs[--session->dev_count];
+            break;
+        }
+    }
+    fobos_mutex_unlock(&session->lock);
+}
+//==============================================================================
+int fobos_session_create(struct fobos_session_t ** out_session)
+{
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s()\n", __FUNCTION__);
+#endif // FOBOS_PRINT_DEBUG
+    if (!out_session)
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    struct fobos_session_t * session = (struct fobos_session_t*)malloc(sizeof(struct fobos_session_t));
+    if (NULL == session)
+    {
+        return FOBOS_ERR_NO_MEM;
+    }
+    memset(session, 0, sizeof(struct fobos_session_t));
+    int result = libusb_init(&session->libusb_ctx);
+    if (result < 0)
+    {
+        free(session);
+        return result;
+    }
+    fobos_mutex_init(&session->lock);
+    fobos_cond_init(&session->cond);
+    if (fobos_thread_create(&session->thread, fobos_session_thread, session) != 0)
+    {
+        fobos_cond_destroy(&session->cond);
+        fobos_mutex_destroy(&session->lock);
+        libusb_exit(session->libusb_ctx);
+        free(session);
+        return FOBOS_ERR_NO_MEM;
+    }
+    *out_session = session;
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+int fobos_session_open(struct fobos_session_t * session, struct fobos_dev_t ** out_dev, uint32_t index)
+{
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%d)\n", __FUNCTION__, index);
+#endif // FOBOS_PRINT_DEBUG
+    if (!session || !out_dev)
+    {
+        return FOBOS_ERR_NO_DEV;
+    }
+    struct fobos_dev_t * dev = NULL;
+    int result = fobos_rx_open_ex(&dev, index, session);
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    fobos_mutex_lock(&session->lock);
+    int full = (session->dev_count >= FOBOS_SESSION_MAX_DEVICES);
+    if (!full)
+    {
+        session->devs[session->dev_count++] = dev;
+    }
+    fobos_mutex_unlock(&session->lock);
+    if (full)
+    {
+        fobos_rx_close(dev);
+        return FOBOS_ERR_NO_MEM;
+    }
+    *out_dev = dev;
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+int fobos_session_start_async(struct fobos_session_t * session, struct fobos_dev_t ** devs, unsigned int count, fobos_rx_fmt_cb_t cb, void ** ctx, uint32_t buf_count, uint32_t buf_length, int format)
+{
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%d, %p, %d, %d, %d)\n", __FUNCTION__, count, (void*)cb, buf_count, buf_length, format);
+#endif // FOBOS_PRINT_DEBUG
+    if (!session || !devs || !count)
+    {
+        return FOBOS_ERR_NO_DEV;
+    }
+    if ((format < FOBOS_FORMAT_CF32) || (format > FOBOS_FORMAT_CS8))
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    unsigned int i;
+    for (i = 0; i < count; i++)
+    {
+        struct fobos_dev_t * dev = devs[i];
+        int result = fobos_check(dev);
+        if (result != FOBOS_ERR_OK)
+        {
+            return result;
+        }
+        if (dev->session != session)
+        {
+            return FOBOS_ERR_UNSUPPORTED;
+        }
+        if (dev->evt_running || dev->evt_polled || dev->rx_sync_started || dev->rx_ring || (FOBOS_IDDLE != fobos_rx_status(dev)))
+        {
+            return FOBOS_ERR_ASYNC_IN_SYNC;
+        }
+    }
+    // submit the transfers of every device, no data flows yet
+    int result = FOBOS_ERR_OK;
+    for (i = 0; i < count; i++)
+    {
+        devs[i]->start_deferred = 1;
+        result = fobos_rx_async_begin(devs[i], NULL, cb, NULL, ctx ? ctx[i] : NULL, buf_count, buf_length, format);
+        devs[i]->start_deferred = 0;
+        if (result != FOBOS_ERR_OK)
+        {
+            break;
+        }
+        fobos_session_attach(devs[i]);
+    }
+    if (result == FOBOS_ERR_OK)
+    {
+        for (i = 0; i < count; i++)
+        {
+            fobos_rx_flow_arm(devs[i]);
+        }
+        for (i = 0; i < count; i++)
+        {
+            fobos_rx_flow_enable(devs[i]);
+        }
+        for (i = 0; i < count; i++)
+        {
+            if (FOBOS_RUNNING != fobos_rx_status(devs[i]))
+            {
+                result = FOBOS_ERR_LIBUSB;
+            }
+        }
+    }
+    if (result != FOBOS_ERR_OK)
+    {
+        for (i = 0; i < count; i++)
+        {
+            fobos_rx_stop_async(devs[i]);
+        }
+    }
+    return result;
+}
+//==============================================================================
+int fobos_session_destroy(struct fobos_session_t * session)
+{
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s()\n", __FUNCTION__);
+#endif // FOBOS_PRINT_DEBUG
+    if (!session)
+    {
+        return FOBOS_ERR_NO_DEV;
+    }
+    while (session->dev_count)
+    {
+        fobos_rx_close(session->devs[0]);
+    }
+    fobos_mutex_lock(&session->lock);
+    session->quit = 1;
+    fobos_mutex_unlock(&session->lock);
+    fobos_session_wake(session);
+    fobos_thread_join(session->thread);
+    fobos_cond_destroy(&session->cond);
+    fobos_mutex_destroy(&session->lock);
+    libusb_exit(session->libusb_ctx);
+    free(session);
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+// Owned event thread
+// fobos_rx_start_async() runs fobos_rx_read_async_ex() in a thread of its own
+// and waits until the transfers are submitted or the start has failed.
+// fobos_rx_stop_async() cancels the streaming, waits on evt_cond until the
+// thread has released the stream and joins it.
+//==============================================================================
+FOBOS_THREAD_PROC(fobos_rx_event_thread, arg)
+{
+    struct fobos_dev_t * dev = (struct fobos_dev_t *)arg;
+    fobos_thread_set_sched(dev->evt_cpu, dev->evt_priority);
+    int result = fobos_rx_read_async_ex(dev, NULL, dev->evt_cb, NULL, dev->evt_ctx, dev->evt_buf_count, dev->evt_buf_length, dev->evt_format);
+    fobos_mutex_lock(&dev->evt_lock);
+    dev->evt_result = result;
+    dev->evt_finished = 1;
+    fobos_cond_broadcast(&dev->evt_cond);
+    fobos_mutex_unlock(&dev->evt_lock);
+    FOBOS_THREAD_RETURN;
+}
+//==============================================================================
+int fobos_rx_start_async(struct fobos_dev_t * dev, fobos_rx_fmt_cb_t cb, void *ctx, uint32_t buf_count, uint32_t buf_length, int format)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%p, %p, %d, %d, %d)\n", __FUNCTION__, (void*)cb, (void*)ctx, buf_count, buf_length, format);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (dev->evt_running || dev->evt_polled || dev->rx_sync_started || dev->rx_ring || (FOBOS_IDDLE != fobos_rx_status(dev)))
+    {
+        return FOBOS_ERR_ASYNC_IN_SYNC;
+    }
+    if ((format < FOBOS_FORMAT_CF32) || (format > FOBOS_FORMAT_CS8))
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    if (dev->session)
+    {
+        return fobos_session_start(dev, cb, ctx, buf_count, buf_length, format);
+    }
+    dev->evt_cb = cb;
+    dev->evt_ctx = ctx;
+    dev->evt_buf_count = buf_count;
+    dev->evt_buf_length = buf_length;
+    dev->evt_format = format;
+    dev->evt_finished = 0;
+    dev->evt_result = 0;
+    fobos_mutex_init(&dev->evt_lock);
+    fobos_cond_init(&dev->evt_cond);
+    dev->evt_running = 1;
+    if (fobos_thread_create(&dev->evt_thread, fobos_rx_event_thread, dev) != 0)
+    {
+        dev->evt_running = 0;
+        fobos_cond_destroy(&dev->evt_cond);
+        fobos_mutex_destroy(&dev->evt_lock);
+        return FOBOS_ERR_NO_MEM;
+    }
+    fobos_mutex_lock(&dev->evt_lock);
+    while (!dev->evt_finished && (FOBOS_RUNNING != fobos_rx_status(dev)) && (FOBOS_CANCELING != fobos_rx_status(dev)))
+    {
+        fobos_cond_wait(&dev->evt_cond, &dev->evt_lock);
+    }
+    int finished = dev->evt_finished;
+    fobos_mutex_unlock(&dev->evt_lock);
+    if (finished || (FOBOS_RUNNING != fobos_rx_status(dev)))
+    {
+        result = fobos_rx_stop_async(dev);
+        return (result != FOBOS_ERR_OK) ? result : FOBOS_ERR_LIBUSB;
+    }
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+int fobos_rx_stop_async(struct fobos_dev_t * dev)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s()\n", __FUNCTION__);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (dev->prep_active)
+    {
+        return fobos_rx_prep_release(dev);
+    }
+    if (dev->evt_polled)
+    {
+        struct timeval tv = { 0, 10000 };
+        fobos_rx_cancel_async(dev);
+        while (!fobos_rx_async_step(dev, &tv, &result))
+        {
+        }
+        fobos_rx_async_end(dev);
+        dev->evt_polled = 0;
+        return dev->dev_lost ? FOBOS_ERR_NO_DEV : FOBOS_ERR_OK;
+    }
+    if (!dev->evt_running)
+    {
+        return FOBOS_ERR_OK;
+    }
+    if (dev->evt_session)
+    {
+        return fobos_session_stop(dev);
+    }
+    // fobos_rx_start_async() has seen the stream running or cancelled, so
+    // one cancel reaches it, a recovery in progress is aborted as well
+    fobos_rx_cancel_async(dev);
+    fobos_mutex_lock(&dev->evt_lock);
+    while (!dev->evt_finished)
+    {
+        fobos_cond_wait(&dev->evt_cond, &dev->evt_lock);
+    }
+    fobos_mutex_unlock(&dev->evt_lock);
+    fobos_thread_join(dev->evt_thread);
+    fobos_cond_destroy(&dev->evt_cond);
+    fobos_mutex_destroy(&dev->evt_lock);
+    dev->evt_running = 0;
+    result = dev->evt_result;
+    if (dev->dev_lost)
+    {
+        return FOBOS_ERR_NO_DEV;
+    }
+    return (result < 0) ? FOBOS_ERR_LIBUSB : FOBOS_ERR_OK;
+}
+//==============================================================================
+// Event loop integration
+// fobos_rx_start_async_polled() submits the transfers and returns, the
+// application polls the libusb file descriptors together with its own ones and
+// calls fobos_rx_handle_events(), which runs the same completion path as the
+// blocking loop. Not available where libusb has no pollable descriptors
+// (Windows), there fobos_rx_handle_events() may be called periodically.
+//==============================================================================
+static void LIBUSB_CALL fobos_pollfd_added(int fd, short events, void * user_data)
+{
+    struct fobos_dev_t * dev = (struct fobos_dev_t *)user_data;
+    if (dev->pollfd_added)
+    {
+        dev->pollfd_added(fd, events, dev->pollfd_ctx);
+    }
+}
+//==============================================================================
+static void LIBUSB_CALL fobos_pollfd_removed(int fd, void * user_data)
+{
+    struct fobos_dev_t * dev = (struct fobos_dev_t *)user_data;
+    if (dev->pollfd_removed)
+    {
+        dev->pollfd_removed(fd, dev->pollfd_ctx);
+    }
+}
+//==============================================================================
+int fobos_rx_start_async_polled(struct fobos_dev_t * dev, fobos_rx_fmt_cb_t cb, void *ctx, uint32_t buf_count, uint32_t buf_length, int format)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%p, %p, %d, %d, %d)\n", __FUNCTION__, (void*)cb, (void*)ctx, buf_count, buf_length, format);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (dev->evt_running || dev->evt_polled || dev->rx_sync_started || dev->rx_ring)
+    {
+        return FOBOS_ERR_ASYNC_IN_SYNC;
+    }
+    if (dev->session)
+    {
+        // the session thread handles the events of the shared context
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    result = fobos_rx_async_begin(dev, NULL, cb, NULL, ctx, buf_count, buf_length, format);
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    dev->evt_polled = 1;
+    if (FOBOS_RUNNING != fobos_rx_status(dev))
+    {
+        fobos_rx_stop_async(dev);
+        return FOBOS_ERR_LIBUSB;
+    }
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+int fobos_rx_get_pollfds(struct fobos_dev_t * dev, struct fobos_pollfd_t * fds, unsigned int * count)
+{
+    int result = fobos_check(dev);
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (!count)
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    const struct libusb_pollfd ** list = libusb_get_pollfds(dev->libusb_ctx);
+    if (!list)
+    {
+        *count = 0;
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    unsigned int n = 0;
+    for (; list[n]; n++)
+    {
+        if (fds && (n < *count))
+        {
+            fds[n].fd = list[n]->fd;
+            fds[n].events = list[n]->events;
+        }
+    }
+    *count = n;
+#if LIBUSB_API_VERSION >= 0x01000104
+    libusb_free_pollfds(list);
+#else
+    free((void *)list);
+#endif
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+int fobos_rx_set_pollfd_notifiers(struct fobos_dev_t * dev, fobos_pollfd_added_cb_t added, fobos_pollfd_removed_cb_t removed, void *ctx)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%p, %p, %p)\n", __FUNCTION__, (void*)added, (void*)removed, ctx);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    dev->pollfd_added = added;
+    dev->pollfd_removed = removed;
+    dev->pollfd_ctx = ctx;
+    if (added || removed)
+    {
+        libusb_set_pollfd_notifiers(dev->libusb_ctx, fobos_pollfd_added, fobos_pollfd_removed, dev);
+    }
+    else
+    {
+        libusb_set_pollfd_notifiers(dev->libusb_ctx, NULL, NULL, NULL);
+    }
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+int fobos_rx_get_next_timeout(struct fobos_dev_t * dev, int * timeout_ms)
+{
+    int result = fobos_check(dev);
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (!timeout_ms)
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    struct timeval tv = { 0, 0 };
+    result = libusb_get_next_timeout(dev->libusb_ctx, &tv);
+    if (result < 0)
+    {
+        return FOBOS_ERR_LIBUSB;
+    }
+    *timeout_ms = (result == 0) ? -1 : (int)(tv.tv_sec * 1000 + (tv.tv_usec + 999) / 1000);
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+int fobos_rx_handle_events(struct fobos_dev_t * dev, int timeout_ms)
+{
+    int result = fobos_check(dev);
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    struct timeval tv = { 0, 0 };
+    if (timeout_ms > 0)
+    {
+        tv.tv_sec = timeout_ms / 1000;
+        tv.tv_usec = (timeout_ms % 1000) * 1000;
+    }
+    if (!dev->evt_polled)
+    {
+        result = libusb_handle_events_timeout_completed(dev->libusb_ctx, &tv, NULL);
+        return (result < 0) ? FOBOS_ERR_LIBUSB : FOBOS_ERR_NOT_STARTED;
+    }
+    if (fobos_rx_async_step(dev, &tv, &result))
+    {
+        // cancelled from a callback or the device is lost
+        fobos_rx_async_end(dev);
+        dev->evt_polled = 0;
+        return dev->dev_lost ? FOBOS_ERR_NO_DEV : FOBOS_ERR_NOT_STARTED;
+    }
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+FOBOS_THREAD_PROC(fobos_rx_ring_thread, arg)
+{
+    struct fobos_dev_t * dev = (struct fobos_dev_t *)arg;
+    struct fobos_rx_ring_t * ring = dev->rx_ring;
+    fobos_thread_set_sched(dev->evt_cpu, dev->evt_priority);
+    int result = fobos_rx_read_async_ex(dev, NULL, NULL, NULL, NULL, 0, ring->slot_length, ring->format);
+    fobos_mutex_lock(&ring->lock);
+    ring->result = result;
+    ring->finished = 1;
+    fobos_cond_broadcast(&ring->cond);
+    fobos_mutex_unlock(&ring->lock);
+    FOBOS_THREAD_RETURN;
+}
+//==============================================================================
+static void fobos_rx_ring_free(struct fobos_rx_ring_t * ring)
+{
+    fobos_spsc_free(&ring->free);
+    fobos_spsc_free(&ring->filled);
+    free(ring->metas);
+    free(ring->arena);
+    free(ring);
+}
+//==============================================================================
+int fobos_rx_ring_start(struct fobos_dev_t * dev, uint32_t ring_length, uint32_t buf_length, int format, int policy)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%d, %d, %d, %d)\n", __FUNCTION__, ring_length, buf_length, format, policy);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    if (dev->rx_sync_started || dev->rx_ring || (FOBOS_IDDLE != fobos_rx_status(dev)))
+    {
+        return FOBOS_ERR_ASYNC_IN_SYNC;
+    }
+    if (dev->rx_lease_cb || dev->hop_count ||
+        (format < FOBOS_FORMAT_CF32) || (format > FOBOS_FORMAT_CS8) ||
+        ((policy != FOBOS_RING_DROP_OLDEST) && (policy != FOBOS_RING_DROP_NEWEST)))
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    if (buf_length == 0)
+    {
+        buf_length = FOBOS_DEF_BUF_LENGTH;
+    }
+    buf_length = 128 * (buf_length / 128);
     if (buf_length == 0)
     {
-        buf_length = FOBOS_DEF_BUF_LENGTH;
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    struct fobos_rx_ring_t * ring = (struct fobos_rx_ring_t *)calloc(1, sizeof(struct fobos_rx_ring_t));
+    if (!ring)
+    {
+        return FOBOS_ERR_NO_MEM;
+    }
+    ring->slot_length = buf_length;
+    ring->slots_count = (ring_length + buf_length - 1) / buf_length;
+    if (ring->slots_count < 2)
+    {
+        ring->slots_count = 2;
+    }
+    ring->sample_size = fobos_format_sample_size[format];
+    ring->format = format;
+    ring->policy = policy;
+    ring->arena = (uint8_t *)malloc((size_t)ring->slots_count * ring->slot_length * ring->sample_size);
+    ring->metas = (struct fobos_rx_meta_t *)calloc(ring->slots_count, sizeof(struct fobos_rx_meta_t));
+    if (!ring->arena || !ring->metas ||
+        (fobos_spsc_init(&ring->free, ring->slots_count) != 0) ||
+        (fobos_spsc_init(&ring->filled, ring->slots_count) != 0))
+    {
+        fobos_rx_ring_free(ring);
+        return FOBOS_ERR_NO_MEM;
+    }
+    for (uint32_t i = 0; i < ring->slots_count; i++)
+    {
+        fobos_spsc_push(&ring->free, ring->arena + (size_t)i * ring->slot_length * ring->sample_size);
+    }
+    fobos_mutex_init(&ring->lock);
+    fobos_cond_init(&ring->cond);
+    dev->rx_ring = ring;
+    if (fobos_thread_create(&ring->thread, fobos_rx_ring_thread, dev) != 0)
+    {
+        dev->rx_ring = NULL;
+        fobos_cond_destroy(&ring->cond);
+        fobos_mutex_destroy(&ring->lock);
+        fobos_rx_ring_free(ring);
+        return FOBOS_ERR_NO_MEM;
+    }
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+int fobos_rx_ring_read(struct fobos_dev_t * dev, void ** samples, uint32_t * length, uint32_t max_length, int timeout_ms)
+{
+    int result = fobos_check(dev);
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    struct fobos_rx_ring_t * ring = dev->rx_ring;
+    if (!ring)
+    {
+        return FOBOS_ERR_NOT_STARTED;
+    }
+    if (!samples || !length)
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    *samples = NULL;
+    *length = 0;
+    if (ring->held && (ring->held_offset >= ring->slot_length))
+    {
+        fobos_spsc_push(&ring->free, ring->held);
+        ring->held = NULL;
+    }
+    if (!ring->held)
+    {
+        uint8_t * slot = (uint8_t *)fobos_spsc_pop_shared(&ring->filled);
+        if (!slot && (timeout_ms != 0))
+        {
+            uint64_t deadline = fobos_time_ns() + (uint64_t)timeout_ms * 1000000ull;
+            // announce the sleep before the last look at the ring, the
+            // streaming side looks at waiting after the push
+            fobos_mutex_lock(&ring->lock);
+            fobos_atomic_store(&ring->waiting, 1);
+            fobos_atomic_fence();
+            while (!(slot = (uint8_t *)fobos_spsc_pop_shared(&ring->filled)) && !ring->finished)
+            {
+                if (timeout_ms < 0)
+                {
+                    fobos_cond_wait(&ring->cond, &ring->lock);
+                    continue;
+                }
+                uint64_t now = fobos_time_ns();
+                if (now >= deadline)
+                {
+                    break;
+                }
+                fobos_cond_timedwait(&ring->cond, &ring->lock, (uint32_t)((deadline - now + 999999ull) / 1000000ull));
+            }
+            fobos_atomic_store(&ring->waiting, 0);
+            fobos_mutex_unlock(&ring->lock);
+        }
+        if (!slot)
+        {
+            if (ring->finished)
+            {
+                return dev->dev_lost ? FOBOS_ERR_NO_DEV : FOBOS_ERR_NOT_STARTED;
+            }
+            return FOBOS_ERR_TIMEOUT;
+        }
+        ring->held = slot;
+        ring->held_offset = 0;
+        ring->held_meta = ring->metas[(slot - ring->arena) / ((size_t)ring->slot_length * ring->sample_size)];
+        if (ring->held_meta.sample_index != ring->next_index + ring->held_meta.lost_samples)
+        {
+            ring->held_meta.flags |= FOBOS_META_DROPPED;
+        }
+        ring->next_index = ring->held_meta.sample_index + ring->slot_length;
+    }
+    uint32_t count = ring->slot_length - ring->held_offset;
+    if (max_length && (count > max_length))
+    {
+        count = max_length;
+    }
+    *samples = ring->held + (size_t)ring->held_offset * ring->sample_size;
+    *length = count;
+    ring->span_offset = ring->held_offset;
+    ring->held_offset += count;
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+int fobos_rx_ring_stop(struct fobos_dev_t * dev)
+{
+    int result = fobos_check(dev);
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s()\n", __FUNCTION__);
+#endif // FOBOS_PRINT_DEBUG
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
+    }
+    struct fobos_rx_ring_t * ring = dev->rx_ring;
+    if (!ring)
+    {
+        return FOBOS_ERR_OK;
+    }
+    // a stream that has not started yet sees the flag in fobos_rx_async_begin()
+    fobos_atomic_store(&ring->stop, 1);
+    fobos_atomic_fence();
+    fobos_rx_cancel_async(dev);
+    fobos_mutex_lock(&ring->lock);
+    while (!ring->finished)
+    {
+        fobos_cond_wait(&ring->cond, &ring->lock);
+    }
+    fobos_mutex_unlock(&ring->lock);
+    fobos_thread_join(ring->thread);
+    dev->rx_ring = NULL;
+    result = ring->result;
+    fobos_cond_destroy(&ring->cond);
+    fobos_mutex_destroy(&ring->lock);
+    fobos_rx_ring_free(ring);
+    return (result < 0) ? FOBOS_ERR_LIBUSB : FOBOS_ERR_OK;
+}
+//==============================================================================
+int fobos_rx_get_meta(struct fobos_dev_t * dev, struct fobos_rx_meta_t * meta)
+{
+    int result = fobos_check(dev);
+    if (result != FOBOS_ERR_OK)
+    {
+        return result;
     }
-    buf_length = 128 * (buf_length / 128); // complex samples count
-
-    uint32_t transfer_buf_size = buf_length * 4; //raw int16 buff size
-    transfer_buf_size = 512 * (transfer_buf_size / 512); // len must be multiple of 512
-
-    dev->transfer_buf_size = transfer_buf_size;
-
-    result = fobos_alloc_buffers(dev);
+    if (!meta)
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    struct fobos_rx_ring_t * ring = dev->rx_ring;
+    if (ring)
+    {
+        if (!ring->held)
+        {
+            return FOBOS_ERR_NOT_STARTED;
+        }
+        *meta = ring->held_meta;
+        meta->sample_index += ring->span_offset;
+        return FOBOS_ERR_OK;
+    }
+    *meta = dev->rx_meta;
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+int fobos_rx_get_start_time(struct fobos_dev_t * dev, uint64_t * start_ns)
+{
+    int result = fobos_check(dev);
     if (result != FOBOS_ERR_OK)
     {
         return result;
     }
-
-    dev->rx_buff = (float*)malloc(buf_length * 2 * sizeof(float));
-
-    fobos_fx3_command(dev, 0xE1, 1, 0);        // start fx
-
-    bitclear(dev->dev_gpo, FOBOS_DEV_ADC_SDI);
-    fobos_rx_set_dev_gpo(dev, dev->dev_gpo);
-
-    for (uint32_t i = 0; i < dev->transfer_buf_count; ++i)
+    if (!start_ns)
     {
-        libusb_fill_bulk_transfer(dev->transfer[i],
-            dev->libusb_devh,
-            LIBUSB_BULK_IN_ENDPOINT,
-            dev->transfer_buf[i],
-            dev->transfer_buf_size,
-            _libusb_callback,
-            (void *)dev,
-            LIBUSB_BULK_TIMEOUT);
-
-        result = libusb_submit_transfer(dev->transfer[i]);
-        if (result < 0)
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    if (!dev->start_ns)
+    {
+        return FOBOS_ERR_NOT_STARTED;
+    }
+    *start_ns = dev->start_ns;
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+// Stream alignment
+// Direct cross-correlation of two complex sample blocks over the lags
+// -max_lag..max_lag, the cost is length * (2 * max_lag + 1). The blocks are
+// converted to float with the mean removed, the correlation at every lag is
+// normalized by the energies of the whole blocks, so a short overlap can not
+// score high on its own. The lag is limited to half the block, every lag
+// compared has at least half the samples overlapping. The start times narrow
+// down the lag range.
+//==============================================================================
+static float * fobos_load_complex(const void * src, uint32_t length, int format)
+{
+    float * dst = (float *)malloc(length * 2 * sizeof(float));
+    if (!dst)
+    {
+        return NULL;
+    }
+    uint32_t i;
+    switch (format)
+    {
+    case FOBOS_FORMAT_CS16:
+        for (i = 0; i < length * 2; i++)
         {
-            printf_internal("Failed to submit transfer #%d, err %i\n", i, result);
-            dev->rx_async_status = FOBOS_CANCELING;
-            break;
+            dst[i] = (float)((const int16_t *)src)[i];
+        }
+        break;
+    case FOBOS_FORMAT_CS8:
+        for (i = 0; i < length * 2; i++)
+        {
+            dst[i] = (float)((const int8_t *)src)[i];
         }
+        break;
+    default:
+        memcpy(dst, src, length * 2 * sizeof(float));
+        break;
     }
-
-    dev->rx_async_status = FOBOS_RUNNING;
-    while (FOBOS_IDDLE != dev->rx_async_status)
+    double avg_re = 0.0;
+    double avg_im = 0.0;
+    for (i = 0; i < length; i++)
     {
-        //printf_internal("X");
-        result = libusb_handle_events_timeout_completed(dev->libusb_ctx, &tv1, &dev->rx_async_cancel);
-        if (result < 0)
+        avg_re += dst[2 * i];
+        avg_im += dst[2 * i + 1];
+    }
+    avg_re /= length;
+    avg_im /= length;
+    for (i = 0; i < length; i++)
+    {
+        dst[2 * i] -= (float)avg_re;
+        dst[2 * i + 1] -= (float)avg_im;
+    }
+    return dst;
+}
+//==============================================================================
+int fobos_rx_estimate_offset(const void * a, const void * b, uint32_t length, int format, int max_lag, int * offset, float * peak)
+{
+#ifdef FOBOS_PRINT_DEBUG
+    printf_internal("%s(%d, %d, %d)\n", __FUNCTION__, length, format, max_lag);
+#endif // FOBOS_PRINT_DEBUG
+    if (!a || !b || !offset || (max_lag < 0) || ((uint32_t)max_lag > length / 2))
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    if ((format < FOBOS_FORMAT_CF32) || (format > FOBOS_FORMAT_CS8))
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    float * fa = fobos_load_complex(a, length, format);
+    float * fb = fobos_load_complex(b, length, format);
+    if (!fa || !fb)
+    {
+        free(fa);
+        free(fb);
+        return FOBOS_ERR_NO_MEM;
+    }
+    double ea = 0.0;
+    double eb = 0.0;
+    for (uint32_t n = 0; n < length * 2; n++)
+    {
+        ea += fa[n] * fa[n];
+        eb += fb[n] * fb[n];
+    }
+    int best_lag = 0;
+    double best = -1.0;
+    for (int lag = -max_lag; lag <= max_lag; lag++)
+    {
+        // b[n] against a[n + lag]
+        int n0 = (lag < 0) ? -lag : 0;
+        int n1 = (lag > 0) ? (int)length - lag : (int)length;
+        double re = 0.0;
+        double im = 0.0;
+        for (int n = n0; n < n1; n++)
         {
-            printf_internal("libusb_handle_events_timeout_completed returned: %d\n", result);
-            if (result == LIBUSB_ERROR_INTERRUPTED)
-            {
-                continue;
-            }
-            else
-            {
-                break;
-            }
+            const float * pa = fa + 2 * (n + lag);
+            const float * pb = fb + 2 * n;
+            re += pa[0] * pb[0] + pa[1] * pb[1];
+            im += pa[1] * pb[0] - pa[0] * pb[1];
         }
-        if (FOBOS_CANCELING == dev->rx_async_status)
+        double norm = (ea > 0.0 && eb > 0.0) ? sqrt((re * re + im * im) / (ea * eb)) : 0.0;
+        if (norm > best)
         {
-            printf_internal("FOBOS_CANCELING \n");
-            dev->rx_async_status = FOBOS_IDDLE;
-            if (!dev->transfer)
-            {
-                break;
-            }
-            for (uint32_t i = 0; i < dev->transfer_buf_count; ++i)
+            best = norm;
+            best_lag = lag;
+        }
+    }
+    free(fa);
+    free(fb);
+    *offset = best_lag;
+    if (peak)
+    {
+        *peak = (float)best;
+    }
+    return FOBOS_ERR_OK;
+}
+//==============================================================================
+// Pipelined synchronous mode
+// fobos_rx_start_sync() submits sync_depth transfers. The reads run the libusb
+// events in the calling thread and take the transfers in the submission order,
+// each one is resubmitted as soon as its samples are converted, so the device
+// has transfers to fill while the caller processes the data. The samples of a
+// transfer that do not fit the caller buffer wait in rx_buff for the next read.
+//==============================================================================
+static void LIBUSB_CALL _libusb_sync_callback(struct libusb_transfer *transfer)
+{
+    struct fobos_rx_xfer_t * xfer = (struct fobos_rx_xfer_t *)transfer->user_data;
+    struct fobos_dev_t * dev = xfer->dev;
+    if (LIBUSB_TRANSFER_COMPLETED == transfer->status)
+    {
+        fobos_rx_meta_stamp(dev, &xfer->buf->meta, transfer->actual_length / 4);
+    }
+    else if (LIBUSB_TRANSFER_NO_DEVICE == transfer->status)
+    {
+        dev->dev_lost = 1;
+    }
+    xfer->done = 1;
+    dev->sync_completed = 1;
+}
+//==============================================================================
+static void fobos_rx_sync_release(struct fobos_dev_t * dev)
+{
+    if (dev->sync_depth == 0)
+    {
+        return;
+    }
+    uint32_t i = dev->sync_next;
+    dev->rx_xfers[i].done = 0;
+    int result = libusb_submit_transfer(dev->transfer[i]);
+    if (result < 0)
+    {
+        printf_internal("Failed to resubmit transfer #%d, err %i\n", i, result);
+        if (result == LIBUSB_ERROR_NO_DEVICE)
+        {
+            dev->dev_lost = 1;
+        }
+        dev->transfer[i]->status = LIBUSB_TRANSFER_ERROR;
+        dev->rx_xfers[i].done = 1;
+    }
+    dev->sync_next = (i + 1) % dev->sync_depth;
+}
+//==============================================================================
+// obtain the raw samples of the next transfer, fobos_rx_sync_release() when done
+static int fobos_rx_sync_fetch(struct fobos_dev_t * dev, int timeout_ms, unsigned char ** data, int * actual)
+{
+    *actual = 0;
+    if (dev->sync_depth == 0)
+    {
+        unsigned int timeout = (timeout_ms < 0) ? LIBUSB_BULK_TIMEOUT : ((timeout_ms > 0) ? (unsigned int)timeout_ms : 1);
+        int result = libusb_bulk_transfer(
+            dev->libusb_devh,
+            LIBUSB_BULK_IN_ENDPOINT,
+            dev->rx_sync_buf,
+            dev->transfer_buf_size,
+            actual,
+            timeout);
+        if (result == LIBUSB_ERROR_TIMEOUT)
+        {
+            if (*actual == 0)
             {
-                //printf_internal(" ~%d", i);
-                if (!dev->transfer[i])
-                    continue;
-                if (LIBUSB_TRANSFER_CANCELLED != dev->transfer[i]->status)
-                {
-                    struct libusb_transfer * xf = dev->transfer[i];
-                    printf_internal(" ~%02x", xf->flags);
-
-                    result = libusb_cancel_transfer(dev->transfer[i]);
-                    libusb_handle_events_timeout_completed(dev->libusb_ctx, &tvx, NULL);
-                    if (result < 0)
-                    {
-                        printf_internal("libusb_cancel_transfer[%d] returned: %d %s\n", i, result, libusb_error_name(result));
-                        continue;
-                    }
-                    dev->rx_async_status = FOBOS_CANCELING;
-                }
+                return FOBOS_ERR_TIMEOUT;
             }
-            if (dev->dev_lost || FOBOS_IDDLE == dev->rx_async_status)
+            result = LIBUSB_SUCCESS;
+        }
+        if (result != LIBUSB_SUCCESS)
+        {
+            return result;
+        }
+        fobos_rx_meta_stamp(dev, &dev->rx_meta, *actual / 4);
+        *data = dev->rx_sync_buf;
+        return FOBOS_ERR_OK;
+    }
+    struct fobos_rx_xfer_t * xfer = &dev->rx_xfers[dev->sync_next];
+    struct libusb_transfer * transfer = dev->transfer[dev->sync_next];
+    uint64_t deadline = fobos_time_ns() + (uint64_t)((timeout_ms < 0) ? 0 : timeout_ms) * 1000000ull;
+    int polled = 0;
+    while (!xfer->done)
+    {
+        struct timeval tv = { 1, 0 };
+        if (timeout_ms >= 0)
+        {
+            uint64_t now = fobos_time_ns();
+            uint64_t left = (now < deadline) ? deadline - now : 0;
+            if (!left && polled)
             {
-                libusb_handle_events_timeout_completed(dev->libusb_ctx, &tvx, NULL);
-                break;
+                return FOBOS_ERR_TIMEOUT;
             }
+            tv.tv_sec = (long)(left / 1000000000ull);
+            tv.tv_usec = (long)((left % 1000000000ull) / 1000ull);
+        }
+        polled = 1;
+        dev->sync_completed = 0;
+        int result = libusb_handle_events_timeout_completed(dev->libusb_ctx, &tv, &dev->sync_completed);
+        if ((result < 0) && (result != LIBUSB_ERROR_INTERRUPTED))
+        {
+            printf_internal("libusb_handle_events_timeout_completed returned: %d\n", result);
+            return FOBOS_ERR_LIBUSB;
         }
     }
-    fobos_fx3_command(dev, 0xE1, 0, 0);       // stop fx
-    fobos_free_buffers(dev);
-    free(dev->rx_buff);
-    dev->rx_buff = NULL;
-    bitset(dev->dev_gpo, FOBOS_DEV_ADC_SDI);
-    fobos_rx_set_dev_gpo(dev, dev->dev_gpo);
-    dev->rx_async_status = FOBOS_IDDLE;
-    dev->rx_async_cancel = 0;
-    return result;
+    if (LIBUSB_TRANSFER_COMPLETED != transfer->status)
+    {
+        printf_internal("transfer->status = %d\n", transfer->status);
+        if (dev->dev_lost)
+        {
+            return FOBOS_ERR_NO_DEV;
+        }
+        fobos_rx_sync_release(dev);
+        return FOBOS_ERR_LIBUSB;
+    }
+    dev->rx_meta = xfer->buf->meta;
+    *data = xfer->buf->data;
+    *actual = transfer->actual_length;
+    return FOBOS_ERR_OK;
 }
 //==============================================================================
-int fobos_rx_cancel_async(struct fobos_dev_t * dev)
+// length == 0 - up to one transfer of samples, otherwise exactly length samples
+static int fobos_rx_read_sync_ex(struct fobos_dev_t * dev, void * buf, uint32_t length, uint32_t * actual_length, int timeout_ms)
 {
     int result = fobos_check(dev);
 #ifdef FOBOS_PRINT_DEBUG
-    printf_internal("%s()\n", __FUNCTION__);
+    printf_internal("%s(%d, %d)\n", __FUNCTION__, length, timeout_ms);
 #endif // FOBOS_PRINT_DEBUG
+    if (actual_length)
+    {
+        *actual_length = 0;
+    }
     if (result != FOBOS_ERR_OK)
     {
         return result;
     }
-    if (FOBOS_RUNNING == dev->rx_async_status)
+    if (dev->rx_sync_started != 1)
     {
-        dev->rx_async_status = FOBOS_CANCELING;
-        dev->rx_async_cancel = 1;
+        return FOBOS_ERR_SYNC_NOT_STARTED;
     }
-    return 0;
+    if (!buf)
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    size_t sample_size = fobos_format_sample_size[dev->rx_format];
+    uint8_t * dst = (uint8_t *)buf;
+    uint32_t want = length ? length : dev->transfer_buf_size / 4;
+    uint32_t count = 0;
+    uint64_t deadline = fobos_time_ns() + (uint64_t)((timeout_ms < 0) ? 0 : timeout_ms) * 1000000ull;
+    while (count < want)
+    {
+        if (dev->sync_offset < dev->sync_length)
+        {
+            uint32_t n = dev->sync_length - dev->sync_offset;
+            if (n > want - count)
+            {
+                n = want - count;
+            }
+            memcpy(dst + count * sample_size, (uint8_t *)dev->rx_buff + dev->sync_offset * sample_size, n * sample_size);
+            dev->sync_offset += n;
+            count += n;
+            if (!length)
+            {
+                break;
+            }
+            continue;
+        }
+        int timeout = timeout_ms;
+        if (timeout_ms > 0)
+        {
+            uint64_t now = fobos_time_ns();
+            timeout = (now < deadline) ? (int)((deadline - now + 999999ull) / 1000000ull) : 0;
+        }
+        unsigned char * data = NULL;
+        int actual = 0;
+        result = fobos_rx_sync_fetch(dev, timeout, &data, &actual);
+        if (result != FOBOS_ERR_OK)
+        {
+            break;
+        }
+        if (actual != (int)dev->transfer_buf_size)
+        {
+            dev->rx_meta.flags |= FOBOS_META_SHORT;
+        }
+        uint32_t samples = actual / 4;
+        if (samples <= want - count)
+        {
+            fobos_rx_convert_samples(dev, &dev->rx_cvt_sel, data, actual, dst + count * sample_size);
+            count += samples;
+        }
+        else
+        {
+            fobos_rx_convert_samples(dev, &dev->rx_cvt_sel, data, actual, dev->rx_buff);
+            dev->sync_offset = 0;
+            dev->sync_length = samples;
+        }
+        fobos_rx_sync_release(dev);
+        fobos_stat_add(&dev->rx_stats.buffers, 1);
+        if (!length && count)
+        {
+            break;
+        }
+    }
+    if (actual_length)
+    {
+        *actual_length = count;
+    }
+    return result;
 }
 //==============================================================================
 int fobos_rx_start_sync(struct fobos_dev_t * dev, uint32_t buf_length)
+{
+    return fobos_rx_start_sync_fmt(dev, buf_length, FOBOS_FORMAT_CF32);
+}
+//==============================================================================
+int fobos_rx_start_sync_fmt(struct fobos_dev_t * dev, uint32_t buf_length, int format)
 {
     int i = 0;
     int actual = 0;
@@ -2115,7 +8035,7 @@ int fobos_rx_start_sync(struct fobos_dev_t * dev, uint32_t buf_length)
     {
         return result;
     }
-    if (FOBOS_IDDLE != dev->rx_async_status)
+    if (FOBOS_IDDLE != fobos_rx_status(dev))
     {
         return FOBOS_ERR_SYNC_IN_ASYNC;
     }
@@ -2123,57 +8043,108 @@ int fobos_rx_start_sync(struct fobos_dev_t * dev, uint32_t buf_length)
     {
         return 0;
     }
+    if ((format < FOBOS_FORMAT_CF32) || (format > FOBOS_FORMAT_CS8))
+    {
+        return FOBOS_ERR_UNSUPPORTED;
+    }
+    dev->rx_format = format;
+    fobos_rx_cvt_select(dev);
     if (buf_length == 0)
     {
         buf_length = FOBOS_DEF_BUF_LENGTH;
     }
     buf_length = 128 * (buf_length / 128);
-    dev->rx_buff = (float*)malloc(buf_length * 2 * sizeof(float));
     dev->transfer_buf_size = buf_length * 4;
-    dev->rx_sync_buf = (unsigned char *)malloc(dev->transfer_buf_size);
-    if (dev->rx_sync_buf == 0)
+    dev->sync_offset = 0;
+    dev->sync_length = 0;
+    dev->sync_next = 0;
+    dev->frame_capacity = 0;
+    if (dev->sync_depth)
+    {
+        dev->transfer_buf_count = dev->sync_depth;
+        dev->transfer_spare_count = 0;
+        result = fobos_alloc_buffers(dev);
+        if (result != FOBOS_ERR_OK)
+        {
+            dev->transfer_buf_size = 0;
+            return result;
+        }
+    }
+    else
     {
-        dev->transfer_buf_size = 0;
-        return FOBOS_ERR_NO_MEM;
+        dev->rx_buff = malloc(buf_length * fobos_format_sample_size[format]);
+        dev->rx_sync_buf = (unsigned char *)malloc(dev->transfer_buf_size);
+        if ((dev->rx_buff == 0) || (dev->rx_sync_buf == 0))
+        {
+            free(dev->rx_buff);
+            dev->rx_buff = NULL;
+            free(dev->rx_sync_buf);
+            dev->rx_sync_buf = NULL;
+            dev->transfer_buf_size = 0;
+            return FOBOS_ERR_NO_MEM;
+        }
     }
-    fobos_fx3_command(dev, 0xE1, 1, 0);        // start fx
-    bitclear(dev->dev_gpo, FOBOS_DEV_ADC_SDI);
-    fobos_rx_set_dev_gpo(dev, dev->dev_gpo);
+    memset(&dev->rx_stats, 0, sizeof(dev->rx_stats));
+    dev->rx_stats.buf_count = dev->sync_depth;
+    dev->rx_stats.buf_length = buf_length;
+    fobos_rx_meta_reset(dev, dev->sync_depth + 1);
+    fobos_cvt_pool_start(dev);
+    fobos_rx_cal_start(dev);
+    fobos_rx_flow_arm(dev);
+    fobos_rx_flow_enable(dev);
     dev->rx_sync_started = 1;
+    for (uint32_t i = 0; i < dev->sync_depth; ++i)
+    {
+        libusb_fill_bulk_transfer(dev->transfer[i],
+            dev->libusb_devh,
+            LIBUSB_BULK_IN_ENDPOINT,
+            dev->rx_xfers[i].buf->data,
+            dev->transfer_buf_size,
+            _libusb_sync_callback,
+            (void *)&dev->rx_xfers[i],
+            LIBUSB_BULK_TIMEOUT);
+        dev->rx_xfers[i].done = 0;
+        result = libusb_submit_transfer(dev->transfer[i]);
+        if (result < 0)
+        {
+            printf_internal("Failed to submit transfer #%d, err %i\n", i, result);
+            fobos_rx_stop_sync(dev);
+            return FOBOS_ERR_LIBUSB;
+        }
+    }
     return FOBOS_ERR_OK;
 }
 //==============================================================================
 int fobos_rx_read_sync(struct fobos_dev_t * dev, float * buf, uint32_t * actual_buf_length)
 {
-    int actual = 0;
-    int result = fobos_check(dev);
-#ifdef FOBOS_PRINT_DEBUG
-    printf_internal("%s()\n", __FUNCTION__);
-#endif // FOBOS_PRINT_DEBUG
-    if (result != FOBOS_ERR_OK)
-    {
-        return result;
-    }
-    if (dev->rx_sync_started != 1)
+    if ((fobos_check(dev) == FOBOS_ERR_OK) && (dev->rx_format != FOBOS_FORMAT_CF32))
     {
-        return FOBOS_ERR_SYNC_NOT_STARTED;
+        return FOBOS_ERR_UNSUPPORTED;
     }
-    result = libusb_bulk_transfer(
-        dev->libusb_devh,
-        LIBUSB_BULK_IN_ENDPOINT, 
-        dev->rx_sync_buf, 
-        dev->transfer_buf_size, 
-        &actual, 
-        LIBUSB_BULK_TIMEOUT);
-    if (result == FOBOS_ERR_OK)
+    return fobos_rx_read_sync_fmt(dev, buf, actual_buf_length);
+}
+//==============================================================================
+int fobos_rx_read_sync_fmt(struct fobos_dev_t * dev, void * buf, uint32_t * actual_buf_length)
+{
+    return fobos_rx_read_sync_ex(dev, buf, 0, actual_buf_length, -1);
+}
+//==============================================================================
+int fobos_rx_read_sync_timeout(struct fobos_dev_t * dev, void * buf, uint32_t * actual_buf_length, int timeout_ms)
+{
+    return fobos_rx_read_sync_ex(dev, buf, 0, actual_buf_length, timeout_ms);
+}
+//==============================================================================
+int fobos_rx_read_sync_len(struct fobos_dev_t * dev, void * buf, uint32_t length, uint32_t * actual_length, int timeout_ms)
+{
+    if (length == 0)
     {
-        fobos_rx_convert_samples(dev, dev->rx_sync_buf, actual, buf);
-        if (actual_buf_length)
+        if (actual_length)
         {
-            *actual_buf_length = actual / 4;
+            *actual_length = 0;
         }
+        return fobos_check(dev);
     }
-    return result;
+    return fobos_rx_read_sync_ex(dev, buf, length, actual_length, timeout_ms);
 }
 //==============================================================================
 int fobos_rx_stop_sync(struct fobos_dev_t * dev)
@@ -2189,12 +8160,55 @@ int fobos_rx_stop_sync(struct fobos_dev_t * dev)
     result = 0;
     if (dev->rx_sync_started)
     {
+        if (dev->sync_depth && dev->transfer)
+        {
+            // a lost device still completes the cancelled transfers, with
+            // LIBUSB_TRANSFER_NO_DEVICE, so the events are handled until the
+            // last one is reaped or libusb gives up
+            struct timeval tv = { 0, 100000 };
+            uint64_t deadline = fobos_time_ns() + 2000000000ULL;
+            for (uint32_t i = 0; i < dev->sync_depth; ++i)
+            {
+                if (!dev->rx_xfers[i].done)
+                {
+                    libusb_cancel_transfer(dev->transfer[i]);
+                }
+            }
+            uint32_t pending = 0;
+            while (1)
+            {
+                pending = 0;
+                for (uint32_t i = 0; i < dev->sync_depth; ++i)
+                {
+                    pending += dev->rx_xfers[i].done ? 0 : 1;
+                }
+                if (!pending || (fobos_time_ns() > deadline))
+                {
+                    break;
+                }
+                dev->sync_completed = 0;
+                int events = libusb_handle_events_timeout_completed(dev->libusb_ctx, &tv, &dev->sync_completed);
+                if ((events < 0) && (events != LIBUSB_ERROR_INTERRUPTED))
+                {
+                    break;
+                }
+            }
+            if (pending)
+            {
+                printf_internal("%u transfers were not reaped, their buffers are leaked\n", pending);
+                fobos_abandon_buffers(dev);
+                result = FOBOS_ERR_LIBUSB;
+            }
+            fobos_free_buffers(dev);
+        }
         bitset(dev->dev_gpo, FOBOS_DEV_ADC_SDI);
         fobos_rx_set_dev_gpo(dev, dev->dev_gpo);
         free(dev->rx_sync_buf);
         dev->rx_sync_buf = NULL;
         free(dev->rx_buff);
         dev->rx_buff = NULL;
+        fobos_cvt_pool_stop(dev);
+        fobos_rx_cal_stop(dev);
         dev->rx_sync_started = 0;
     }
     return result;
@@ -2210,7 +8224,7 @@ int fobos_rx_write_firmware(struct fobos_dev_t* dev, const char * file_name, int
     {
         return result;
     }
-    if (dev->rx_sync_started || dev->rx_async_status != FOBOS_IDDLE)
+    if (dev->rx_sync_started || fobos_rx_status(dev) != FOBOS_IDDLE)
     {
         return FOBOS_ERR_UNSUPPORTED;
     }
@@ -2277,7 +8291,7 @@ int fobos_rx_read_firmware(struct fobos_dev_t* dev, const char * file_name, int
     {
         return result;
     }
-    if (dev->rx_sync_started || dev->rx_async_status != FOBOS_IDDLE)
+    if (dev->rx_sync_started || fobos_rx_status(dev) != FOBOS_IDDLE)
     {
         return FOBOS_ERR_UNSUPPORTED;
     }
@@ -2331,6 +8345,9 @@ const char * fobos_rx_error_name(int error)
         case FOBOS_ERR_SYNC_NOT_STARTED: return "Sync mode is not started";
         case FOBOS_ERR_UNSUPPORTED:      return "Unsuppotred parameter or mode";
         case FOBOS_ERR_LIBUSB:           return "libusb error";
+        case FOBOS_ERR_TIMEOUT:          return "Timeout";
+        case FOBOS_ERR_NOT_STARTED:      return "Streaming is not started";
+        case FOBOS_ERR_PENDING:          return "The change is queued and applied later";
         default:   return "Unknown error";
     }
 }
@@ -17,6 +17,30 @@
 //  2025.01.19 - v.2.3.2 fobos_rx_reset()
 //  2025.08.23 - v.2.4.0 DC filter improved, VGA gain fixed
 //  2025.10.23 - v.2.4.1 new software DC filter
+//  2026.10.16 - v.2.5.0 SIMD sample conversion (SSE2, AVX2, AVX-512, NEON)
+//  2026.10.16 - v.2.5.0 CS16, CS8 output formats
+//  2026.10.16 - v.2.5.0 block dc removal mode, fobos_rx_set_dc_mode()
+//  2026.10.16 - v.2.5.0 multithreaded conversion, fobos_rx_set_convert_threads()
+//  2026.10.16 - v.2.5.0 processing thread, fobos_rx_set_processing_queue(), fobos_rx_get_stats()
+//  2026.10.16 - v.2.5.0 vectorized and deferred iq calibration, fobos_rx_set_calibration()
+//  2026.10.16 - v.2.5.0 ring pull mode (fobos_rx_ring_start, fobos_rx_ring_read, fobos_rx_ring_stop)
+//  2026.10.16 - v.2.5.0 per buffer metadata (fobos_rx_read_async_meta, fobos_rx_get_meta)
+//  2026.10.16 - v.2.5.0 owned event thread (fobos_rx_start_async, fobos_rx_stop_async, fobos_rx_set_event_thread)
+//  2026.10.16 - v.2.5.0 pipelined sync mode (fobos_rx_set_sync_queue, fobos_rx_read_sync_timeout, fobos_rx_read_sync_len)
+//  2026.10.16 - v.2.5.0 automatic transfer count and length (fobos_rx_set_auto_buffers)
+//  2026.10.16 - v.2.5.0 event loop integration (fobos_rx_start_async_polled, fobos_rx_get_pollfds, fobos_rx_handle_events, ...)
+//  2026.10.16 - v.2.5.0 multi-device sessions (fobos_session_create, fobos_session_open, fobos_session_destroy)
+//  2026.10.16 - v.2.5.0 synchronized start and stream alignment (fobos_session_start_async, fobos_rx_get_start_time, fobos_rx_estimate_offset)
+//  2026.10.16 - v.2.5.0 streaming buffer arena (fobos_rx_set_buffer_arena)
+//  2026.10.16 - v.2.5.0 zero-copy raw buffer leases (fobos_rx_set_lease_mode, fobos_rx_release_lease)
+//  2026.10.16 - v.2.5.0 event driven stream stop and device close
+//  2026.10.16 - v.2.5.0 prepared stream with pause and resume (fobos_rx_prepare_async, fobos_rx_pause_async, fobos_rx_resume_async)
+//  2026.10.16 - v.2.5.0 callback framing with overlap (fobos_rx_set_framing)
+//  2026.10.16 - v.2.5.0 stream recovery after a device loss (fobos_rx_set_recovery)
+//  2026.10.16 - v.2.5.0 thread safe tuning and gain changes while streaming (control command queue)
+//  2026.10.16 - v.2.5.0 configuration transactions writing the net register changes (fobos_rx_begin_config, fobos_rx_commit_config)
+//  2026.10.16 - v.2.5.0 precomputed tuning plans (fobos_rx_make_plans, fobos_rx_apply_plan, fobos_rx_save_plans, fobos_rx_load_plans)
+//  2026.10.16 - v.2.5.0 frequency hopping schedule in the streaming path (fobos_rx_set_hop_schedule)
 //==============================================================================
 #ifndef LIB_FOBOS_H
 #include <stdint.h>
@@ -42,10 +66,114 @@ extern "C"
 #define FOBOS_ERR_SYNC_NOT_STARTED  -7
 #define FOBOS_ERR_UNSUPPORTED       -8
 #define FOBOS_ERR_LIBUSB            -9
+#define FOBOS_ERR_TIMEOUT           -10
+#define FOBOS_ERR_NOT_STARTED       -11
+#define FOBOS_ERR_PENDING           1   // not a failure: the change is queued and applied later
 #define FOBOS_INFO_LEN              64
 //==============================================================================
+#define FOBOS_FORMAT_CF32           0   // interleaved float32 I/Q, full scale +/-0.25
+#define FOBOS_FORMAT_CS16           1   // interleaved int16 I/Q, full scale +/-32767
+#define FOBOS_FORMAT_CS8            2   // interleaved int8 I/Q, full scale +/-127
+#define FOBOS_DC_IIR                0   // per sample IIR filter (default)
+#define FOBOS_DC_BLOCK              1   // per block estimate, vectorized subtraction
+#define FOBOS_CAL_OFF               0   // keep the current iq amplitude balance
+#define FOBOS_CAL_INLINE            1   // calibrate in the streaming thread (default)
+#define FOBOS_CAL_BACKGROUND        2   // calibrate in a background thread started with the stream
+#define FOBOS_RING_DROP_OLDEST      0   // on overflow overwrite the oldest unread buffer
+#define FOBOS_RING_DROP_NEWEST      1   // on overflow drop the incoming buffer
+#define FOBOS_META_SHORT            0x01    // a short transfer was discarded before this buffer
+#define FOBOS_META_GAP              0x02    // completion timing shows samples lost before this buffer
+#define FOBOS_META_DROPPED          0x04    // buffers were dropped by the library before this buffer
+#define FOBOS_META_RECOVERED        0x08    // first buffer after the device was lost and reopened
+#define FOBOS_META_CONFIG           0x10    // first buffer captured entirely after a configuration change
+#define FOBOS_META_SEGMENT_START    0x20    // first buffer of a hop segment, fobos_rx_set_hop_schedule()
+#define FOBOS_META_SEGMENT_END      0x40    // last buffer of a hop segment (not flagged with framing)
+#define FOBOS_PRIORITY_NORMAL       0   // default scheduling
+#define FOBOS_PRIORITY_HIGH         1   // above the normal threads
+#define FOBOS_PRIORITY_REALTIME     2   // real time scheduling, may require privileges
+#define FOBOS_ARENA_HUGE_THP        0x01    // transparent huge pages (linux)
+#define FOBOS_ARENA_HUGE_TLB        0x02    // reserved huge pages (linux) or large pages (windows), falls back to normal pages
+#define FOBOS_ARENA_MLOCK           0x04    // lock the buffers in memory, may require privileges
+#define FOBOS_ARENA_PREFAULT        0x08    // touch every page when the buffers are allocated
+//==============================================================================
 struct fobos_dev_t;
+struct fobos_session_t;
 typedef void(*fobos_rx_cb_t)(float *buf, uint32_t buf_length, void *ctx);
+typedef void(*fobos_rx_fmt_cb_t)(void *buf, uint32_t buf_length, int format, void *ctx);
+struct fobos_rx_stats_t
+{
+    uint64_t buffers;               // buffers passed to the callback
+    uint64_t queue_overflows;       // buffers dropped because the processing queue was full
+    uint32_t queue_depth;           // processing queue depth, 0 - no processing thread
+    uint32_t queue_max_fill;        // processing queue high watermark
+    uint64_t ring_dropped;          // complex samples dropped by the ring overflow policy
+    uint64_t gaps;                  // gaps detected from the completion timing
+    uint64_t lost_samples;          // complex samples lost in short transfers and gaps (estimated)
+    uint32_t buf_count;             // transfers in flight
+    uint32_t buf_length;            // complex samples per transfer
+    uint32_t max_jitter_us;         // completion lateness high watermark, us
+    uint64_t leases;                // raw buffers leased to the application
+    uint64_t lease_returns;         // leases returned by fobos_rx_release_lease()
+    uint64_t lease_denied;          // buffers dropped because every spare buffer was leased
+    uint32_t leases_held_max;       // leases held at once high watermark
+    uint64_t frames;                // frames passed to the callback, fobos_rx_set_framing()
+    uint64_t frame_carried;         // complex samples moved to the frame store start
+    uint64_t recoveries;            // streams resumed after a device loss, fobos_rx_set_recovery()
+    uint64_t recovery_lost_samples; // complex samples missed while recovering (estimated)
+    uint64_t config_changes;        // frequency, gain, sample rate and clock changes applied
+    uint64_t hops;                  // retunes of the hop schedule, fobos_rx_set_hop_schedule()
+    uint64_t hop_dwell_requested;   // complex samples requested by the dwells of the finished segments
+    uint64_t hop_dwell_achieved;    // complex samples captured in the finished segments
+    uint64_t hop_dead_samples;      // complex samples dropped while retuning and settling
+    uint64_t hop_retune_ns;         // time spent retuning, ns
+    uint64_t hop_retune_max_ns;     // longest retune, ns
+    uint64_t hop_errors;            // retunes that failed, their segments were skipped
+};
+struct fobos_rx_meta_t
+{
+    uint64_t sample_index;          // index of the first sample since the stream start, lost samples included
+    uint64_t timestamp_ns;          // host monotonic time of the transfer completion (CLOCK_MONOTONIC), ns
+    uint64_t lost_samples;          // samples lost right before this buffer, estimated for gaps
+    double frequency;               // rx frequency, Hz
+    double samplerate;              // sample rate, Hz
+    uint32_t lna_gain;
+    uint32_t vga_gain;
+    uint32_t flags;                 // FOBOS_META_*
+    uint32_t config_id;             // configuration changes applied before this buffer
+    uint32_t hop_index;             // schedule entry of the hop segment
+    uint64_t segment_start;         // sample index of the hop segment start
+};
+struct fobos_pollfd_t
+{
+    int fd;
+    short events;                   // POLLIN, POLLOUT
+};
+typedef void(*fobos_pollfd_added_cb_t)(int fd, short events, void *ctx);
+typedef void(*fobos_pollfd_removed_cb_t)(int fd, void *ctx);
+typedef void(*fobos_rx_meta_cb_t)(void *buf, uint32_t buf_length, int format, const struct fobos_rx_meta_t * meta, void *ctx);
+struct fobos_rx_lease_t
+{
+    const uint16_t * raw;           // raw device words: pairs of 14 bit offset binary samples in the low bits
+    uint32_t length;                // complex samples count
+    uint32_t q_first;               // 0 - i, q pairs, 1 - q, i pairs
+    struct fobos_rx_meta_t meta;
+};
+typedef void(*fobos_rx_lease_cb_t)(const struct fobos_rx_lease_t * lease, void *ctx);
+struct fobos_rx_tune_plan_t
+{
+    double frequency;               // requested, Hz
+    double actual;                  // actual rx frequency, Hz
+    uint32_t max2830_clock;         // reference clocks the plan was made for, Hz
+    uint32_t rffc507x_clock;
+    uint32_t band;
+    uint32_t swap_iq;
+    uint32_t rffc507x_enabled;
+    uint16_t gpo_value;             // preselector and if filter bits of the gpo
+    uint16_t gpo_mask;
+    uint16_t max2830_regs[3];       // registers 5, 3, 4
+    uint16_t rffc507x_regs[7];      // pll fields of the registers 0x00, 0x0C .. 0x11
+    uint16_t rffc507x_masks[7];
+};
 //==============================================================================
 // obtain the software info
 API_EXPORT int CALL_CONV fobos_rx_get_api_info(char * lib_version, char * drv_version);
@@ -59,8 +187,21 @@ API_EXPORT int CALL_CONV fobos_rx_open(struct fobos_dev_t ** out_dev, uint32_t i
 API_EXPORT int CALL_CONV fobos_rx_close(struct fobos_dev_t * dev);
 // close and reset device
 API_EXPORT int CALL_CONV fobos_rx_reset(struct fobos_dev_t * dev);
+// create a session: one libusb context and one event thread for all the devices opened in it
+API_EXPORT int CALL_CONV fobos_session_create(struct fobos_session_t ** out_session);
+// open the specified device in the session, fobos_rx_start_async() streams it in the session event thread, close it by fobos_rx_close()
+API_EXPORT int CALL_CONV fobos_session_open(struct fobos_session_t * session, struct fobos_dev_t ** out_dev, uint32_t index);
+// stop the session event thread, close the devices left open and release the session
+API_EXPORT int CALL_CONV fobos_session_destroy(struct fobos_session_t * session);
+// start the iq rx streaming of several devices of the session with the start commands issued back to back,
+// ctx[i] (ctx may be NULL) is passed to the callback of devs[i], stop every device by fobos_rx_stop_async()
+API_EXPORT int CALL_CONV fobos_session_start_async(struct fobos_session_t * session, struct fobos_dev_t ** devs, unsigned int count, fobos_rx_fmt_cb_t cb, void ** ctx, uint32_t buf_count, uint32_t buf_length, int format);
 // get the board info
 API_EXPORT int CALL_CONV fobos_rx_get_board_info(struct fobos_dev_t * dev, char * hw_revision, char * fw_version, char * manufacturer, char * product, char * serial);
+// the frequency, direct sampling, gains, sample rate, clock source, user gpo and dc mode may be changed from any thread while streaming,
+// the change is applied by the streaming thread between buffers, from a stream callback it is applied after the callback returns,
+// while the device is recovering it is applied once the device is back, in both cases the setter returns FOBOS_ERR_PENDING
+// without waiting for it and *actual is not written
 // set rx frequency, Hz
 API_EXPORT int CALL_CONV fobos_rx_set_frequency(struct fobos_dev_t * dev, double value, double * actual);
 // set rx direct sampling mode:  0 - disabled (default),  1 - enabled
@@ -73,23 +214,124 @@ API_EXPORT int CALL_CONV fobos_rx_set_vga_gain(struct fobos_dev_t * dev, unsigne
 API_EXPORT int CALL_CONV fobos_rx_get_samplerates(struct fobos_dev_t * dev, double * values, unsigned int * count);
 // set sample rate nearest to specified
 API_EXPORT int CALL_CONV fobos_rx_set_samplerate(struct fobos_dev_t * dev, double value, double * actual);
+// start a configuration transaction: the frequency, direct sampling, gain, sample rate (and bandwidth) and clock source
+// setters that follow compute the register values and return the actual values, nothing is written to the device yet
+API_EXPORT int CALL_CONV fobos_rx_begin_config(struct fobos_dev_t * dev);
+// end the configuration transaction: write each register that differs from the device state once
+API_EXPORT int CALL_CONV fobos_rx_commit_config(struct fobos_dev_t * dev);
+// compute the tuning plans of count frequencies, Hz, fails on the first unsupported frequency
+API_EXPORT int CALL_CONV fobos_rx_make_plans(struct fobos_dev_t * dev, const double * frequencies, unsigned int count, struct fobos_rx_tune_plan_t * plans);
+// tune by a plan of fobos_rx_make_plans(), only the registers that differ from the device state are written, may be called while streaming
+API_EXPORT int CALL_CONV fobos_rx_apply_plan(struct fobos_dev_t * dev, const struct fobos_rx_tune_plan_t * plan, double * actual);
+// serialize count plans in a portable form, buf may be NULL, size: in - buf capacity, out - bytes required
+API_EXPORT int CALL_CONV fobos_rx_save_plans(const struct fobos_rx_tune_plan_t * plans, unsigned int count, void * buf, unsigned int * size);
+// restore the plans saved by fobos_rx_save_plans(), plans may be NULL, count: in - plans capacity, out - plans stored,
+// plans writing more than the band switch bits and the lo pll fields or not matching their band are rejected, nothing is
+// written then, a plan is tuned only when it matches what fobos_rx_make_plans() makes of its frequency for the device
+API_EXPORT int CALL_CONV fobos_rx_load_plans(const void * buf, unsigned int size, struct fobos_rx_tune_plan_t * plans, unsigned int * count);
 // statr the iq rx streaming
 API_EXPORT int CALL_CONV fobos_rx_read_async(struct fobos_dev_t * dev, fobos_rx_cb_t cb, void *ctx, uint32_t buf_count, uint32_t buf_length);
+// start the iq rx streaming in the specified sample format FOBOS_FORMAT_CF32, FOBOS_FORMAT_CS16, FOBOS_FORMAT_CS8
+API_EXPORT int CALL_CONV fobos_rx_read_async_fmt(struct fobos_dev_t * dev, fobos_rx_fmt_cb_t cb, void *ctx, uint32_t buf_count, uint32_t buf_length, int format);
+// start the iq rx streaming in the specified sample format with the metadata of every buffer
+API_EXPORT int CALL_CONV fobos_rx_read_async_meta(struct fobos_dev_t * dev, fobos_rx_meta_cb_t cb, void *ctx, uint32_t buf_count, uint32_t buf_length, int format);
 // stop the iq rx streaming
 API_EXPORT int CALL_CONV fobos_rx_cancel_async(struct fobos_dev_t * dev);
+// start the iq rx streaming in an event thread owned by the library, returns when the transfers are submitted
+API_EXPORT int CALL_CONV fobos_rx_start_async(struct fobos_dev_t * dev, fobos_rx_fmt_cb_t cb, void *ctx, uint32_t buf_count, uint32_t buf_length, int format);
+// start the iq rx streaming without an event loop, the application polls fobos_rx_get_pollfds() and calls fobos_rx_handle_events()
+API_EXPORT int CALL_CONV fobos_rx_start_async_polled(struct fobos_dev_t * dev, fobos_rx_fmt_cb_t cb, void *ctx, uint32_t buf_count, uint32_t buf_length, int format);
+// prepare the iq rx streaming once: buffers, transfers and threads are set up, the stream starts paused
+API_EXPORT int CALL_CONV fobos_rx_prepare_async(struct fobos_dev_t * dev, fobos_rx_fmt_cb_t cb, void *ctx, uint32_t buf_count, uint32_t buf_length, int format);
+// start the data flow of the prepared stream and submit its transfers, the sample index restarts from 0
+API_EXPORT int CALL_CONV fobos_rx_resume_async(struct fobos_dev_t * dev);
+// stop the data flow of the prepared stream, returns when the transfers are reaped, the buffers are kept,
+// FOBOS_ERR_TIMEOUT - transfers not reaped in 2 s, the stream is not paused and can only be stopped
+API_EXPORT int CALL_CONV fobos_rx_pause_async(struct fobos_dev_t * dev);
+// stop the streaming started by fobos_rx_start_async(), fobos_rx_start_async_polled() or fobos_rx_prepare_async(), returns when the streaming has ended
+API_EXPORT int CALL_CONV fobos_rx_stop_async(struct fobos_dev_t * dev);
+// obtain the file descriptors to poll, fds may be NULL, count: in - fds capacity, out - descriptors count (may exceed the capacity)
+API_EXPORT int CALL_CONV fobos_rx_get_pollfds(struct fobos_dev_t * dev, struct fobos_pollfd_t * fds, unsigned int * count);
+// get notified when file descriptors are added or removed, NULL - no notifications
+API_EXPORT int CALL_CONV fobos_rx_set_pollfd_notifiers(struct fobos_dev_t * dev, fobos_pollfd_added_cb_t added, fobos_pollfd_removed_cb_t removed, void *ctx);
+// the longest time to poll before fobos_rx_handle_events() has to be called, timeout_ms = -1 - no limit
+API_EXPORT int CALL_CONV fobos_rx_get_next_timeout(struct fobos_dev_t * dev, int * timeout_ms);
+// process the pending usb events and run the callbacks, wait up to timeout_ms for events (0 - do not wait)
+API_EXPORT int CALL_CONV fobos_rx_handle_events(struct fobos_dev_t * dev, int timeout_ms);
+// start the iq rx streaming into an internal ring of ring_length complex samples, policy FOBOS_RING_DROP_OLDEST, FOBOS_RING_DROP_NEWEST
+API_EXPORT int CALL_CONV fobos_rx_ring_start(struct fobos_dev_t * dev, uint32_t ring_length, uint32_t buf_length, int format, int policy);
+// obtain a span of up to max_length samples (0 - any) from the ring without copying, valid until the next read, timeout_ms < 0 - infinite
+API_EXPORT int CALL_CONV fobos_rx_ring_read(struct fobos_dev_t * dev, void ** samples, uint32_t * length, uint32_t max_length, int timeout_ms);
+// stop the ring streaming
+API_EXPORT int CALL_CONV fobos_rx_ring_stop(struct fobos_dev_t * dev);
+// obtain the metadata of the last buffer passed to the callback, read by fobos_rx_read_sync() or the last span of fobos_rx_ring_read()
+API_EXPORT int CALL_CONV fobos_rx_get_meta(struct fobos_dev_t * dev, struct fobos_rx_meta_t * meta);
+// obtain the host monotonic time the data flow of the last stream was started, ns
+API_EXPORT int CALL_CONV fobos_rx_get_start_time(struct fobos_dev_t * dev, uint64_t * start_ns);
+// estimate the sample offset between two streams by cross-correlation of length complex samples of each:
+// b[n] matches a[n + offset], |offset| <= max_lag <= length / 2, peak - correlation normalized by the energies of the whole blocks 0..1 (may be NULL)
+API_EXPORT int CALL_CONV fobos_rx_estimate_offset(const void * a, const void * b, uint32_t length, int format, int max_lag, int * offset, float * peak);
 // set user general purpose output bits (0x00 .. 0xFF)
 API_EXPORT int CALL_CONV fobos_rx_set_user_gpo(struct fobos_dev_t * dev, uint8_t value);
 // clock source: 0 - internal (default), 1- extrnal
 API_EXPORT int CALL_CONV fobos_rx_set_clk_source(struct fobos_dev_t * dev, int value);
+// dc offset removal mode: FOBOS_DC_IIR (default), FOBOS_DC_BLOCK, may be changed while streaming
+API_EXPORT int CALL_CONV fobos_rx_set_dc_mode(struct fobos_dev_t * dev, int mode);
+// sample conversion threads count for the next stream: 0, 1 - convert in the streaming thread (default), 2..16 - worker pool
+API_EXPORT int CALL_CONV fobos_rx_set_convert_threads(struct fobos_dev_t * dev, unsigned int count);
+// process samples and call the callback in a dedicated thread for the next stream: 0 - in the libusb event thread (default), 1..64 - processing queue depth
+API_EXPORT int CALL_CONV fobos_rx_set_processing_queue(struct fobos_dev_t * dev, unsigned int depth);
+// iq amplitude calibration: mode FOBOS_CAL_*, run every interval buffers (default 1) and not more often than every interval_ms (0 - no limit)
+API_EXPORT int CALL_CONV fobos_rx_set_calibration(struct fobos_dev_t * dev, int mode, unsigned int interval, unsigned int interval_ms);
+// zero-copy leases for the next async streams: cb gets the raw transfer buffers with the stream ctx instead of the converted
+// samples, a lease is held until fobos_rx_release_lease() while one of spare_count (1..64) spare buffers is submitted, cb NULL - disabled (default)
+API_EXPORT int CALL_CONV fobos_rx_set_lease_mode(struct fobos_dev_t * dev, fobos_rx_lease_cb_t cb, unsigned int spare_count);
+// return a lease from any thread, the stop waits up to 2 s for the leases out, the buffers of the ones not returned by then are leaked
+API_EXPORT int CALL_CONV fobos_rx_release_lease(struct fobos_dev_t * dev, const struct fobos_rx_lease_t * lease);
+// callback framing for the next async streams: frames of frame_length complex samples (0 - one callback per transfer, default,
+// up to 16777216) starting every hop samples (0 - frame_length, less - overlapped, more - samples skipped between the frames),
+// meta sample_index is of the frame start, not used by the ring and lease modes
+API_EXPORT int CALL_CONV fobos_rx_set_framing(struct fobos_dev_t * dev, unsigned int frame_length, unsigned int hop);
+// frequency hopping for the next async streams: the stream cycles through count plans of fobos_rx_make_plans(), holding
+// plans[i] for at least dwells[i] complex samples, the retune is done between buffers and the settle complex samples
+// that follow it are dropped, the buffers carry the frequency, hop_index and segment_start of their segment and are
+// flagged FOBOS_META_SEGMENT_START, FOBOS_META_SEGMENT_END, count 0 - disabled (default), not used by the ring and lease modes,
+// the schedule stalls while a fobos_rx_begin_config() transaction is open, the segment that reached its dwell stays closed
+// and its samples are dropped until fobos_rx_commit_config()
+API_EXPORT int CALL_CONV fobos_rx_set_hop_schedule(struct fobos_dev_t * dev, const struct fobos_rx_tune_plan_t * plans, const uint32_t * dwells, unsigned int count, uint32_t settle);
+// async stream recovery: a stream ended by a device loss or repeated transfer errors looks the device up by its serial number,
+// replays the clock source, frequency, sample rate, gains and direct sampling and resumes into the same callback, the first
+// buffer is flagged FOBOS_META_GAP | FOBOS_META_RECOVERED with the missed samples, timeout_ms 0 - retry until stopped,
+// not available for the session devices, the polled mode and the prepared streams
+API_EXPORT int CALL_CONV fobos_rx_set_recovery(struct fobos_dev_t * dev, int enabled, unsigned int timeout_ms);
+// synchronous mode transfers kept in flight for the next fobos_rx_start_sync(): 0 - one blocking transfer per read, 1..64 (default 4)
+API_EXPORT int CALL_CONV fobos_rx_set_sync_queue(struct fobos_dev_t * dev, unsigned int depth);
+// automatic transfer count and length for the async streaming from the sample rate and the usb speed,
+// adapted between runs: target latency, ms (0 - disabled, default), overrides buf_count and buf_length
+API_EXPORT int CALL_CONV fobos_rx_set_auto_buffers(struct fobos_dev_t * dev, double latency_ms);
+// event thread scheduling for the next fobos_rx_start_async() or fobos_rx_ring_start(): cpu index (-1 - any), priority FOBOS_PRIORITY_*
+API_EXPORT int CALL_CONV fobos_rx_set_event_thread(struct fobos_dev_t * dev, int cpu, int priority);
+// streaming buffer arena options for the next stream, FOBOS_ARENA_* (default 0), the buffers are kept until close or an options change
+API_EXPORT int CALL_CONV fobos_rx_set_buffer_arena(struct fobos_dev_t * dev, unsigned int flags);
+// obtain the rx streaming statistics
+API_EXPORT int CALL_CONV fobos_rx_get_stats(struct fobos_dev_t * dev, struct fobos_rx_stats_t * stats);
 // explicitly set the max2830 frequency, Hz (23500000000 .. 2550000000)
 API_EXPORT int CALL_CONV fobos_max2830_set_frequency(struct fobos_dev_t * dev, double value, double * actual);
 // explicitly set rffc507x frequency, Hz (25000000 .. 5400000000)
 API_EXPORT int CALL_CONV fobos_rffc507x_set_lo_frequency_hz(struct fobos_dev_t * dev, uint64_t lo_freq, uint64_t * tune_freq_hz);
 // start synchronous rx mode
 API_EXPORT int CALL_CONV fobos_rx_start_sync(struct fobos_dev_t * dev, uint32_t buf_length);
+// start synchronous rx mode in the specified sample format FOBOS_FORMAT_CF32, FOBOS_FORMAT_CS16, FOBOS_FORMAT_CS8
+API_EXPORT int CALL_CONV fobos_rx_start_sync_fmt(struct fobos_dev_t * dev, uint32_t buf_length, int format);
 // read samples in synchronous rx mode
 API_EXPORT int CALL_CONV fobos_rx_read_sync(struct fobos_dev_t * dev, float * buf, uint32_t * actual_buf_length);
-// stop synchronous rx mode
+// read samples in synchronous rx mode in the format given to fobos_rx_start_sync_fmt()
+API_EXPORT int CALL_CONV fobos_rx_read_sync_fmt(struct fobos_dev_t * dev, void * buf, uint32_t * actual_buf_length);
+// read up to buf_length samples in synchronous rx mode waiting not longer than timeout_ms (< 0 - infinite), FOBOS_ERR_TIMEOUT when no samples
+API_EXPORT int CALL_CONV fobos_rx_read_sync_timeout(struct fobos_dev_t * dev, void * buf, uint32_t * actual_buf_length, int timeout_ms);
+// fill buf with length samples of any count over several transfers, actual_length is less than length on timeout or error
+API_EXPORT int CALL_CONV fobos_rx_read_sync_len(struct fobos_dev_t * dev, void * buf, uint32_t length, uint32_t * actual_length, int timeout_ms);
+// stop synchronous rx mode, FOBOS_ERR_LIBUSB when some transfers could not be reaped (their buffers are leaked)
 API_EXPORT int CALL_CONV fobos_rx_stop_sync(struct fobos_dev_t * dev);
 // read firmware from the device
 API_EXPORT int CALL_CONV fobos_rx_read_firmware(struct fobos_dev_t* dev, const char * file_name, int verbose);
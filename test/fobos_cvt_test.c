@@ -0,0 +1,267 @@
+//==============================================================================
+//  Fobos SDR API library sample conversion test
+//  Every SIMD kernel the cpu supports is run against the scalar reference
+//  on the same buffers, carrying the DC state from buffer to buffer, and has
+//  to match it within FOBOS_CVT_TOLERANCE. The worker pool is run against
+//  the single threaded kernel the same way. The block DC kernel has to remove
+//  the offset of the benchmark signal as well as the IIR filter does.
+//  LGPL-2.1+
+//  2026.10.16
+//==============================================================================
+#include "../fobos/fobos.c"
+//==============================================================================
+#define TEST_BUFFERS 8
+static const size_t test_lengths[TEST_BUFFERS] = { 4096, 1, 7, 1000, 16384, 13, 2048, 333 };
+//==============================================================================
+static uint32_t test_rand(uint32_t * seed)
+{
+    *seed = *seed * 1664525u + 1013904223u;
+    return *seed >> 8;
+}
+//==============================================================================
+// 14 bit offset binary codes: dc offset, a tone and noise, garbage in the high bits
+static void test_fill(int16_t * src, size_t count, uint32_t * seed)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        double t = (double)i * 0.0123;
+        int re = 8192 + 300 + (int)(4000.0 * cos(t)) + (int)(test_rand(seed) % 200) - 100;
+        int im = 8192 - 200 + (int)(4000.0 * sin(t)) + (int)(test_rand(seed) % 200) - 100;
+        src[2 * i] = (int16_t)((re & 0x3FFF) | (test_rand(seed) & 0xC000));
+        src[2 * i + 1] = (int16_t)((im & 0x3FFF) | (test_rand(seed) & 0xC000));
+    }
+}
+//==============================================================================
+static double test_sample(const void * buf, int format, size_t i)
+{
+    switch (format)
+    {
+    case FOBOS_FORMAT_CS16:
+        return ((const int16_t *)buf)[i];
+    case FOBOS_FORMAT_CS8:
+        return ((const int8_t *)buf)[i];
+    default:
+        return ((const float *)buf)[i];
+    }
+}
+//==============================================================================
+// returns the number of failures
+static int test_table(const char * name, const fobos_cvt_row_t * table)
+{
+    int failures = 0;
+    size_t max_length = 0;
+    for (int b = 0; b < TEST_BUFFERS; b++)
+    {
+        max_length = (test_lengths[b] > max_length) ? test_lengths[b] : max_length;
+    }
+    int16_t * src = (int16_t *)malloc(max_length * 2 * sizeof(int16_t));
+    float * ref = (float *)malloc(max_length * 2 * sizeof(float));
+    float * out = (float *)malloc(max_length * 2 * sizeof(float));
+    for (int swap_iq = 0; swap_iq < 2; swap_iq++)
+    {
+        for (int format = FOBOS_FORMAT_CF32; format <= FOBOS_FORMAT_CS8; format++)
+        {
+            // the integer formats may round to the other side of a step
+            double tolerance = FOBOS_CVT_TOLERANCE * fobos_format_full_scale[format];
+            if (format != FOBOS_FORMAT_CF32)
+            {
+                tolerance += 1.0;
+            }
+            fobos_cvt_state_t st_ref;
+            st_ref.k = 0.0004f;
+            st_ref.dc_re = 8000.0f;
+            st_ref.dc_im = 8300.0f;
+            st_ref.scale_re = fobos_format_full_scale[format] / 32768.0f;
+            st_ref.scale_im = fobos_format_full_scale[format] / 32768.0f * 1.01f;
+            fobos_cvt_state_t st = st_ref;
+            uint32_t seed = 12345;
+            double max_error = 0.0;
+            for (int b = 0; b < TEST_BUFFERS; b++)
+            {
+                size_t count = test_lengths[b];
+                test_fill(src, count, &seed);
+                fobos_cvt_table_scalar[swap_iq][format](&st_ref, src, ref, count);
+                table[swap_iq][format](&st, src, out, count);
+                for (size_t i = 0; i < 2 * count; i++)
+                {
+                    double error = fabs(test_sample(out, format, i) - test_sample(ref, format, i));
+                    max_error = (error > max_error) ? error : max_error;
+                }
+            }
+            double dc_error = fabs(st.dc_re - st_ref.dc_re) + fabs(st.dc_im - st_ref.dc_im);
+            int ok = (max_error <= tolerance) && (dc_error < 1.0);
+            printf("%-7s swap_iq %d format %d: max error %g (tolerance %g), dc state error %g %s\n",
+                name, swap_iq, format, max_error, tolerance, dc_error, ok ? "ok" : "FAILED");
+            failures += !ok;
+        }
+    }
+    free(src);
+    free(ref);
+    free(out);
+    return failures;
+}
+//==============================================================================
+// returns the number of failures
+static int test_pool(uint32_t threads_count)
+{
+    int failures = 0;
+    fobos_cvt_init();
+    struct fobos_cvt_pool_t * pool = fobos_cvt_pool_create(threads_count);
+    if (!pool)
+    {
+        printf("pool    no threads, skipped\n");
+        return 0;
+    }
+    // whole and partial last sub-blocks, a buffer too short to split
+    static const size_t lengths[] = { 65536, 50000, 1000, 16384 + 333 };
+    size_t max_length = 65536;
+    int16_t * src = (int16_t *)malloc(max_length * 2 * sizeof(int16_t));
+    float * ref = (float *)malloc(max_length * 2 * sizeof(float));
+    float * out = (float *)malloc(max_length * 2 * sizeof(float));
+    for (int dc_mode = FOBOS_DC_IIR; dc_mode <= FOBOS_DC_BLOCK; dc_mode++)
+    {
+        for (int format = FOBOS_FORMAT_CF32; format <= FOBOS_FORMAT_CS8; format++)
+        {
+            // the slices are corrected down to FOBOS_CVT_POOL_EPS codes
+            double tolerance = (FOBOS_CVT_TOLERANCE + 2.0 * FOBOS_CVT_POOL_EPS / 32768.0) * fobos_format_full_scale[format];
+            if (format != FOBOS_FORMAT_CF32)
+            {
+                tolerance += 1.0;
+            }
+            fobos_cvt_fn_t cvt = fobos_cvt_select(dc_mode, 1, format);
+            fobos_cvt_fn_t cvt_f32 = fobos_cvt_select(dc_mode, 1, FOBOS_FORMAT_CF32);
+            fobos_cvt_state_t st_ref;
+            st_ref.k = 0.0004f;
+            st_ref.dc_re = 7000.0f;
+            st_ref.dc_im = 9300.0f;
+            st_ref.scale_re = fobos_format_full_scale[format] / 32768.0f;
+            st_ref.scale_im = fobos_format_full_scale[format] / 32768.0f * 1.01f;
+            fobos_cvt_state_t st = st_ref;
+            uint32_t seed = 777;
+            double max_error = 0.0;
+            for (size_t b = 0; b < sizeof(lengths) / sizeof(lengths[0]); b++)
+            {
+                size_t count = lengths[b];
+                test_fill(src, count, &seed);
+                cvt(&st_ref, src, ref, count);
+                fobos_cvt_pool_run(pool, cvt, cvt_f32, dc_mode, format, &st, src, out, count);
+                for (size_t i = 0; i < 2 * count; i++)
+                {
+                    double error = fabs(test_sample(out, format, i) - test_sample(ref, format, i));
+                    max_error = (error > max_error) ? error : max_error;
+                }
+            }
+            double dc_error = fabs(st.dc_re - st_ref.dc_re) + fabs(st.dc_im - st_ref.dc_im);
+            int ok = (max_error <= tolerance) && (dc_error < 0.1);
+            printf("pool    dc_mode %d format %d: max error %g (tolerance %g), dc state error %g %s\n",
+                dc_mode, format, max_error, tolerance, dc_error, ok ? "ok" : "FAILED");
+            failures += !ok;
+        }
+    }
+    free(src);
+    free(ref);
+    free(out);
+    fobos_cvt_pool_destroy(pool);
+    return failures;
+}
+//==============================================================================
+// the signal of fobos_dc_bench: a dc offset, a tone and a little noise
+#define TEST_DC_RE          700
+#define TEST_DC_IM          -400
+#define TEST_DC_LENGTH      16384
+#define TEST_DC_BUFFERS     16
+#define TEST_DC_RESIDUAL    1.0     // codes
+static void test_fill_dc(int16_t * src, size_t count)
+{
+    uint32_t seed = 1;
+    for (size_t i = 0; i < count; i++)
+    {
+        double t = (double)i * 0.0371;
+        seed = seed * 1664525u + 1013904223u;
+        int noise = (int)((seed >> 8) % 64) - 32;
+        int re = 8192 + TEST_DC_RE + (int)(3000.0 * cos(t)) + noise;
+        int im = 8192 + TEST_DC_IM + (int)(3000.0 * sin(t)) - noise;
+        src[2 * i] = (int16_t)(re & 0x3FFF);
+        src[2 * i + 1] = (int16_t)(im & 0x3FFF);
+    }
+}
+//==============================================================================
+// the dc left in the last of TEST_DC_BUFFERS buffers, codes
+static void test_residual(fobos_cvt_fn_t cvt, const int16_t * src, float * out, double * re, double * im)
+{
+    fobos_cvt_state_t st;
+    st.k = 0.0004f;
+    st.dc_re = 8192.0f;
+    st.dc_im = 8192.0f;
+    st.scale_re = 1.0f / 32768.0f;
+    st.scale_im = 1.0f / 32768.0f;
+    for (int b = 0; b < TEST_DC_BUFFERS; b++)
+    {
+        cvt(&st, src, out, TEST_DC_LENGTH);
+    }
+    double sum_re = 0.0;
+    double sum_im = 0.0;
+    for (size_t i = 0; i < TEST_DC_LENGTH; i++)
+    {
+        sum_re += out[2 * i];
+        sum_im += out[2 * i + 1];
+    }
+    *re = sum_re / TEST_DC_LENGTH * 32768.0;
+    *im = sum_im / TEST_DC_LENGTH * 32768.0;
+}
+//==============================================================================
+// returns the number of failures
+static int test_block(void)
+{
+    int failures = 0;
+    int16_t * src = (int16_t *)malloc(TEST_DC_LENGTH * 2 * sizeof(int16_t));
+    float * out = (float *)malloc(TEST_DC_LENGTH * 2 * sizeof(float));
+    test_fill_dc(src, TEST_DC_LENGTH);
+    for (int swap_iq = 0; swap_iq < 2; swap_iq++)
+    {
+        double iir_re, iir_im, re, im;
+        test_residual(fobos_cvt_table_scalar[swap_iq][FOBOS_FORMAT_CF32], src, out, &iir_re, &iir_im);
+        test_residual(fobos_cvt_table_block[swap_iq][FOBOS_FORMAT_CF32], src, out, &re, &im);
+        double residual = fabs(re) + fabs(im);
+        double iir_error = fabs(re - iir_re) + fabs(im - iir_im);
+        int ok = (residual <= TEST_DC_RESIDUAL) && (iir_error <= TEST_DC_RESIDUAL);
+        printf("block   swap_iq %d: residual dc %g codes, %g codes from iir (limit %g) %s\n",
+            swap_iq, residual, iir_error, TEST_DC_RESIDUAL, ok ? "ok" : "FAILED");
+        failures += !ok;
+    }
+    free(src);
+    free(out);
+    return failures;
+}
+//==============================================================================
+int main(int argc, char** argv)
+{
+    int failures = 0;
+    int simd = fobos_cpu_simd_level();
+    printf("simd level %d\n", simd);
+#ifdef FOBOS_X86
+    if (simd >= FOBOS_SIMD_SSE2)
+    {
+        failures += test_table("sse2", fobos_cvt_table_sse2);
+    }
+    if (simd >= FOBOS_SIMD_AVX2)
+    {
+        failures += test_table("avx2", fobos_cvt_table_avx2);
+    }
+    if (simd >= FOBOS_SIMD_AVX512)
+    {
+        failures += test_table("avx512", fobos_cvt_table_avx512);
+    }
+#endif // FOBOS_X86
+#ifdef FOBOS_NEON
+    if (simd == FOBOS_SIMD_NEON)
+    {
+        failures += test_table("neon", fobos_cvt_table_neon);
+    }
+#endif // FOBOS_NEON
+    failures += test_block();
+    failures += test_pool(4);
+    printf("%d failures\n", failures);
+    return (failures == 0) ? 0 : 1;
+}
+//==============================================================================
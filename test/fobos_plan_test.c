@@ -0,0 +1,244 @@
+//==============================================================================
+//  Fobos SDR API library tuning plan and hop segment test
+//  A plan of every band is saved and loaded back and has to pass the
+//  recomputing fobos_rx_plan_check(), damaged headers and records have to be
+//  rejected without writing the output. The hop segments are cut out of a
+//  synthetic sample index sequence by fobos_rx_hop_stamp() and
+//  fobos_rx_hop_slice() and checked against the schedule. No device needed.
+//  LGPL-2.1+
+//  2026.10.16
+//==============================================================================
+#include "../fobos/fobos.c"
+//==============================================================================
+#define TEST_BANDS          ((uint32_t)(sizeof(fobos_rx_bands) / sizeof(fobos_rx_bands[0])))
+#define TEST_BUF_LENGTH     8192
+#define TEST_BUFFERS        400
+#define TEST_SETTLE         10000
+#define TEST_HOPS           3
+// the record fields damaged by the test
+#define TEST_OFS_BAND       24
+#define TEST_OFS_SWAP_IQ    28
+#define TEST_OFS_LO_ENABLED 32
+#define TEST_OFS_GPO_VALUE  36
+#define TEST_OFS_GPO_MASK   38
+#define TEST_OFS_MAX2830    40
+#define TEST_OFS_RFFC507X   46
+//==============================================================================
+static struct fobos_dev_t test_dev;
+//==============================================================================
+static int test_report(const char * name, int ok)
+{
+    printf("%-36s %s\n", name, ok ? "ok" : "FAILED");
+    return !ok;
+}
+//==============================================================================
+// one plan in the middle of every band
+static int test_make_plans(struct fobos_rx_tune_plan_t * plans)
+{
+    int ok = 1;
+    for (uint32_t i = 0; i < TEST_BANDS; i++)
+    {
+        double mhz = 0.5 * (fobos_rx_bands[i].freq_mhz_min + fobos_rx_bands[i].freq_mhz_max) + 0.123456;
+        ok &= (fobos_rx_plan_compute(&test_dev, mhz * 1E6, &plans[i]) == FOBOS_ERR_OK) && (plans[i].band == i);
+        ok &= (fobos_rx_plan_check(&test_dev, &plans[i]) == FOBOS_ERR_OK);
+    }
+    return test_report("make and check the plans", ok);
+}
+//==============================================================================
+static int test_round_trip(const struct fobos_rx_tune_plan_t * plans, uint8_t * buf, unsigned int * size)
+{
+    int failures = 0;
+    unsigned int required = 0;
+    int ok = (fobos_rx_save_plans(plans, TEST_BANDS, NULL, &required) == FOBOS_ERR_OK);
+    ok &= (required == FOBOS_PLAN_HEADER_SIZE + TEST_BANDS * FOBOS_PLAN_RECORD_SIZE) && (required <= *size);
+    *size = required - 1;
+    ok &= (fobos_rx_save_plans(plans, TEST_BANDS, buf, size) == FOBOS_ERR_NO_MEM) && (*size == required);
+    ok &= (fobos_rx_save_plans(plans, TEST_BANDS, buf, size) == FOBOS_ERR_OK);
+    failures += test_report("save", ok);
+
+    struct fobos_rx_tune_plan_t loaded[TEST_BANDS];
+    unsigned int count = 0;
+    ok = (fobos_rx_load_plans(buf, *size, NULL, &count) == FOBOS_ERR_OK) && (count == TEST_BANDS);
+    count = TEST_BANDS - 1;
+    ok &= (fobos_rx_load_plans(buf, *size, loaded, &count) == FOBOS_ERR_NO_MEM) && (count == TEST_BANDS);
+    ok &= (fobos_rx_load_plans(buf, *size, loaded, &count) == FOBOS_ERR_OK) && (count == TEST_BANDS);
+    for (uint32_t i = 0; ok && (i < TEST_BANDS); i++)
+    {
+        ok &= (loaded[i].frequency == plans[i].frequency) && (fobos_rx_plan_check(&test_dev, &loaded[i]) == FOBOS_ERR_OK);
+    }
+    failures += test_report("load", ok);
+    return failures;
+}
+//==============================================================================
+// the load has to fail and leave the plans and the count as they were
+static int test_rejected(const char * name, const uint8_t * buf, unsigned int size)
+{
+    struct fobos_rx_tune_plan_t loaded[TEST_BANDS];
+    struct fobos_rx_tune_plan_t untouched[TEST_BANDS];
+    memset(loaded, 0xA5, sizeof(loaded));
+    memset(untouched, 0xA5, sizeof(untouched));
+    unsigned int count = TEST_BANDS;
+    int result = fobos_rx_load_plans(buf, size, loaded, &count);
+    int ok = (result == FOBOS_ERR_UNSUPPORTED) && (count == TEST_BANDS) && (memcmp(loaded, untouched, sizeof(loaded)) == 0);
+    return test_report(name, ok);
+}
+//==============================================================================
+static int test_damaged(const uint8_t * saved, unsigned int size)
+{
+    int failures = 0;
+    uint8_t * buf = (uint8_t *)malloc(size);
+    // the second record is damaged, the first one would load
+    uint8_t * record = buf + FOBOS_PLAN_HEADER_SIZE + FOBOS_PLAN_RECORD_SIZE;
+#define TEST_DAMAGE(name, damage) \
+    memcpy(buf, saved, size); \
+    damage; \
+    failures += test_rejected(name, buf, size);
+    TEST_DAMAGE("bad magic", buf[0] ^= 0x01)
+    TEST_DAMAGE("bad version", fobos_put_u32(buf + 4, FOBOS_PLAN_VERSION + 1))
+    TEST_DAMAGE("too many records", fobos_put_u32(buf + 8, TEST_BANDS + 1))
+    TEST_DAMAGE("bad record size", fobos_put_u32(buf + 12, FOBOS_PLAN_RECORD_SIZE + 2))
+    TEST_DAMAGE("band out of range", fobos_put_u32(record + TEST_OFS_BAND, TEST_BANDS))
+    TEST_DAMAGE("iq swap of another band", record[TEST_OFS_SWAP_IQ] ^= 0x01)
+    TEST_DAMAGE("lo enable of another band", record[TEST_OFS_LO_ENABLED] ^= 0x01)
+    TEST_DAMAGE("band switch of another band", record[TEST_OFS_GPO_VALUE] ^= (1 << FOBOS_DEV_PRESEL_V1))
+    TEST_DAMAGE("gpo mask beyond the band switch", fobos_put_u16(record + TEST_OFS_GPO_MASK, 0xFFFF))
+    TEST_DAMAGE("max2830 reference divider", fobos_put_u16(record + TEST_OFS_MAX2830, 0x00A8))
+    TEST_DAMAGE("max2830 divider over 14 bits", record[TEST_OFS_MAX2830 + 3] |= 0x40)
+    TEST_DAMAGE("rffc507x mask beyond the pll", fobos_put_u16(record + TEST_OFS_RFFC507X + 2, 0xFFFF))
+#undef TEST_DAMAGE
+    memcpy(buf, saved, size);
+    failures += test_rejected("truncated", buf, size - 1);
+    failures += test_rejected("short header", buf, FOBOS_PLAN_HEADER_SIZE - 1);
+
+    // well formed but not what the device makes of the frequency
+    struct fobos_rx_tune_plan_t loaded[TEST_BANDS];
+    unsigned int count = TEST_BANDS;
+    uint16_t p1n = 0;
+    fobos_get_u16(record + TEST_OFS_RFFC507X + 4, &p1n);
+    fobos_put_u16(record + TEST_OFS_RFFC507X + 4, p1n ^ (1 << 7));
+    int ok = (fobos_rx_load_plans(buf, size, loaded, &count) == FOBOS_ERR_OK) &&
+             (fobos_rx_plan_check(&test_dev, &loaded[0]) == FOBOS_ERR_OK) &&
+             (fobos_rx_plan_check(&test_dev, &loaded[1]) == FOBOS_ERR_UNSUPPORTED);
+    loaded[0].max2830_clock++;
+    ok &= (fobos_rx_plan_check(&test_dev, &loaded[0]) == FOBOS_ERR_UNSUPPORTED);
+    loaded[0].max2830_clock--;
+    loaded[0].actual += 1.0;
+    ok &= (fobos_rx_plan_check(&test_dev, &loaded[0]) == FOBOS_ERR_UNSUPPORTED);
+    failures += test_report("foreign plans not tuned", ok);
+    free(buf);
+    return failures;
+}
+//==============================================================================
+// the stream of fobos_rx_hop_stamp() and fobos_rx_hop_slice(), the retune is
+// done right after the buffer closing a segment, as the streaming thread does
+// between the event handling passes when it takes no time
+static int test_hops(const struct fobos_rx_tune_plan_t * plans)
+{
+    struct fobos_dev_t * dev = &test_dev;
+    struct fobos_rx_tune_plan_t hop_plans[TEST_HOPS] = { plans[0], plans[2], plans[TEST_BANDS - 1] };
+    uint32_t dwells[TEST_HOPS] = { 20000, 5000, 30001 };
+    static unsigned char data[TEST_BUF_LENGTH * 4];
+    memset(&dev->rx_stats, 0, sizeof(dev->rx_stats));
+    dev->hop_plans = hop_plans;
+    dev->hop_dwells = dwells;
+    dev->hop_count = TEST_HOPS;
+    dev->hop_settle = TEST_SETTLE;
+    dev->hop_pos = 0;
+    dev->hop_start = dev->hop_settle;
+    dev->hop_captured = 0;
+    dev->hop_closed = 0;
+    dev->hop_flags = 0;
+    dev->hop_lost = 0;
+    int ok = 1;
+    int segments = 0;
+    uint64_t next = 0;
+    uint64_t captured = 0;
+    uint64_t delivered = 0;
+    uint64_t requested = 0;
+    uint64_t achieved = 0;
+    for (int n = 0; n < TEST_BUFFERS; n++)
+    {
+        uint32_t pos = dev->hop_pos;
+        uint64_t start = dev->hop_start;
+        struct fobos_rx_buf_t buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.data = data;
+        buf.meta.sample_index = (uint64_t)n * TEST_BUF_LENGTH;
+        if (n == 0)
+        {
+            // dropped entirely before the first segment, reported by the next delivered buffer
+            buf.meta.flags = FOBOS_META_GAP;
+            buf.meta.lost_samples = 5;
+        }
+        fobos_rx_hop_stamp(dev, &buf, TEST_BUF_LENGTH);
+        struct fobos_rx_buf_t part;
+        int length = TEST_BUF_LENGTH * 4;
+        if (fobos_rx_hop_slice(dev, &buf, &part, &length))
+        {
+            uint32_t count = length / 4;
+            struct fobos_rx_meta_t * meta = &part.meta;
+            ok &= (part.data == data + (TEST_BUF_LENGTH - count) * 4);
+            ok &= (meta->hop_index == pos) && (meta->segment_start == start) && (meta->frequency == hop_plans[pos].actual);
+            ok &= (part.cvt.swap_iq == fobos_rx_cvt_swap(dev, hop_plans[pos].swap_iq));
+            if (meta->flags & FOBOS_META_SEGMENT_START)
+            {
+                ok &= (meta->sample_index == start) && (captured == 0);
+            }
+            else
+            {
+                ok &= (meta->sample_index == next) && (captured > 0);
+            }
+            if (segments == 0)
+            {
+                ok &= ((meta->flags & FOBOS_META_GAP) != 0) == (captured == 0);
+                ok &= (meta->lost_samples == ((captured == 0) ? 5u : 0u));
+            }
+            next = meta->sample_index + count;
+            captured += count;
+            delivered += count;
+            if (meta->flags & FOBOS_META_SEGMENT_END)
+            {
+                // the segment ends on the buffer that reaches the dwell
+                ok &= (captured >= dwells[pos]) && (captured < dwells[pos] + TEST_BUF_LENGTH);
+                requested += dwells[pos];
+                achieved += captured;
+                captured = 0;
+                segments++;
+            }
+        }
+        if (dev->hop_closed)
+        {
+            ok &= (captured == 0);
+            dev->hop_pos = (dev->hop_pos + 1 < dev->hop_count) ? dev->hop_pos + 1 : 0;
+            dev->hop_start = (uint64_t)(n + 1) * TEST_BUF_LENGTH + TEST_BUF_LENGTH + dev->hop_settle;
+            dev->hop_captured = 0;
+            dev->hop_closed = 0;
+        }
+    }
+    ok &= (segments > 2 * TEST_HOPS);
+    ok &= (dev->rx_stats.hop_dwell_requested == requested) && (dev->rx_stats.hop_dwell_achieved == achieved);
+    ok &= (dev->rx_stats.hop_dead_samples + delivered == (uint64_t)TEST_BUFFERS * TEST_BUF_LENGTH);
+    printf("%d segments, %llu samples delivered, %llu dropped\n", segments,
+        (unsigned long long)delivered, (unsigned long long)dev->rx_stats.hop_dead_samples);
+    dev->hop_plans = NULL;
+    dev->hop_dwells = NULL;
+    dev->hop_count = 0;
+    return test_report("hop segments", ok);
+}
+//==============================================================================
+int main(int argc, char** argv)
+{
+    int failures = 0;
+    test_dev.max2830_clock = 40000000.0;
+    test_dev.rffc507x_clock = 40000000ULL;
+    struct fobos_rx_tune_plan_t plans[TEST_BANDS];
+    static uint8_t saved[FOBOS_PLAN_HEADER_SIZE + TEST_BANDS * FOBOS_PLAN_RECORD_SIZE];
+    unsigned int size = sizeof(saved);
+    failures += test_make_plans(plans);
+    failures += test_round_trip(plans, saved, &size);
+    failures += test_damaged(saved, size);
+    failures += test_hops(plans);
+    printf("%d failures\n", failures);
+    return (failures == 0) ? 0 : 1;
+}
+//==============================================================================
@@ -0,0 +1,76 @@
+//==============================================================================
+//  Fobos SDR API library stream stop latency test
+//  Streams the first device with FOBOS_MAX_BUF_COUNT transfers in flight and
+//  measures how long fobos_rx_stop_async() and fobos_rx_close() take to end
+//  the streaming, each has to return within STOP_TEST_MAX_MS. Without a
+//  device the test is skipped (exit code 77).
+//  LGPL-2.1+
+//  2026.10.16
+//==============================================================================
+#include "../fobos/fobos.c"
+//==============================================================================
+#define STOP_TEST_MAX_MS    100.0
+#define STOP_TEST_STREAM_MS 200
+#define STOP_TEST_RUNS      3
+#define STOP_TEST_SKIP      77
+//==============================================================================
+static fobos_mutex_t test_lock;
+static fobos_cond_t test_cond;
+static fobos_atomic_t test_buffers = 0;
+//==============================================================================
+static void test_wait_ms(uint32_t ms)
+{
+    fobos_mutex_lock(&test_lock);
+    fobos_cond_timedwait(&test_cond, &test_lock, ms);
+    fobos_mutex_unlock(&test_lock);
+}
+//==============================================================================
+static void test_cb(void * buf, uint32_t buf_length, int format, void * ctx)
+{
+    fobos_atomic_add(&test_buffers, 1);
+}
+//==============================================================================
+static int test_check(const char * name, int result, uint64_t t0)
+{
+    double ms = (double)(fobos_time_ns() - t0) * 1e-6;
+    int ok = (result == FOBOS_ERR_OK) && (ms <= STOP_TEST_MAX_MS);
+    printf("%-6s result %d in %.2f ms (max %.0f), %u buffers %s\n", name, result, ms, STOP_TEST_MAX_MS, (uint32_t)fobos_atomic_load(&test_buffers), ok ? "ok" : "FAILED");
+    return !ok;
+}
+//==============================================================================
+int main(int argc, char** argv)
+{
+    struct fobos_dev_t * dev = NULL;
+    if (fobos_rx_open(&dev, 0) != FOBOS_ERR_OK)
+    {
+        printf("no device, skipped\n");
+        return STOP_TEST_SKIP;
+    }
+    fobos_mutex_init(&test_lock);
+    fobos_cond_init(&test_cond);
+    int failures = 0;
+    for (int i = 0; i < STOP_TEST_RUNS; i++)
+    {
+        int result = fobos_rx_start_async(dev, test_cb, NULL, FOBOS_MAX_BUF_COUNT, 8192, FOBOS_FORMAT_CS16);
+        if (result != FOBOS_ERR_OK)
+        {
+            printf("start  result %d FAILED\n", result);
+            failures++;
+            break;
+        }
+        test_wait_ms(STOP_TEST_STREAM_MS);
+        uint64_t t0 = fobos_time_ns();
+        failures += test_check("stop", fobos_rx_stop_async(dev), t0);
+    }
+    // the close ends the streaming itself
+    int result = fobos_rx_start_async(dev, test_cb, NULL, FOBOS_MAX_BUF_COUNT, 8192, FOBOS_FORMAT_CS16);
+    test_wait_ms(STOP_TEST_STREAM_MS);
+    uint64_t t0 = fobos_time_ns();
+    result = (result == FOBOS_ERR_OK) ? fobos_rx_close(dev) : result;
+    failures += test_check("close", result, t0);
+    fobos_cond_destroy(&test_cond);
+    fobos_mutex_destroy(&test_lock);
+    printf("%d failures\n", failures);
+    return (failures == 0) ? 0 : 1;
+}
+//==============================================================================